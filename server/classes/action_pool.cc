@@ -73,7 +73,8 @@ ActionPool::ActionPool(unsigned int pool_size,
       action_libs(),
       game_objects(game_obj)
 {
-    database->get_server_skills(this->actions);
+    if (database != NULL)
+        database->get_server_skills(this->actions);
     this->load_actions();
 }
 
@@ -120,15 +121,6 @@ void ActionPool::execute_action(base_user *user, action_request& req)
 {
     actions_iterator i = this->actions.find(req.action_id);
     Control::skills_iterator j = user->actions.find(req.action_id);
-    GameObject::objects_iterator k =
-        this->game_objects.find(req.dest_object_id);
-    glm::dvec3 dest((double)req.x_pos_dest / (double)ACTREQ_POS_SCALE,
-                    (double)req.y_pos_dest / (double)ACTREQ_POS_SCALE,
-                    (double)req.z_pos_dest / (double)ACTREQ_POS_SCALE);
-    GameObject *target = NULL;
-
-    if (k != this->game_objects.end())
-        target = k->second;
 
     /* TODO:  if the user doesn't have the skill, but it is valid, we
      * should add it at level 0 so they can start accumulating
@@ -152,10 +144,37 @@ void ActionPool::execute_action(base_user *user, action_request& req)
         req.power_level = std::min<uint8_t>(req.power_level, i->second.upper);
         req.power_level = std::min<uint8_t>(req.power_level, j->second.level);
 
-        user->send_ack(TYPE_ACTREQ,
-                       (uint8_t)(*(i->second.action))(user->slave,
-                                                      req.power_level,
-                                                      target,
-                                                      dest));
+        int result;
+
+        if (recorder != NULL)
+        {
+            std::scoped_lock lock(recorder->order_lock);
+
+            recorder->action(req);
+            result = this->perform(user->slave, req);
+        }
+        else
+            result = this->perform(user->slave, req);
+        user->send_ack(TYPE_ACTREQ, (uint8_t)result);
     }
 }
+
+/* Whatever's asked for has already been checked and settled, so we
+ * just do it.  The replay comes straight in here too.
+ */
+int ActionPool::perform(GameObject *actor, action_request& req)
+{
+    actions_iterator i = this->actions.find(req.action_id);
+    GameObject::objects_iterator k =
+        this->game_objects.find(req.dest_object_id);
+    glm::dvec3 dest((double)req.x_pos_dest / (double)ACTREQ_POS_SCALE,
+                    (double)req.y_pos_dest / (double)ACTREQ_POS_SCALE,
+                    (double)req.z_pos_dest / (double)ACTREQ_POS_SCALE);
+    GameObject *target = NULL;
+
+    if (i == this->actions.end() || i->second.action == NULL)
+        return -1;
+    if (k != this->game_objects.end())
+        target = k->second;
+    return (*(i->second.action))(actor, req.power_level, target, dest);
+}
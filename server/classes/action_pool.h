@@ -59,6 +59,7 @@ class ActionPool : public ThreadPool<packet_list>
     static void action_pool_worker(void *);
 
     void execute_action(base_user *, action_request&);
+    int perform(GameObject *, action_request&);
 };
 
 #endif /* __INC_ACTION_POOL_H__ */
@@ -42,7 +42,7 @@ int action_move(GameObject *source,
 {
     if (glm::length(direction) == 0)
     {
-        source->set_movement(glm::dvec3(0.0, 0.0, 0.0));
+        source->set_movement(glm::dvec3(0.0, 0.0, 0.0), source->driven());
         return 0;
     }
 
@@ -52,7 +52,8 @@ int action_move(GameObject *source,
 
     source->set_movement(move
                          * (double)intensity / 100.0
-                         * AVERAGE_WALKING_SPEED);
+                         * AVERAGE_WALKING_SPEED,
+                         true);
     motion->push(source);
     return intensity;
 }
@@ -63,7 +64,7 @@ int action_stop(GameObject *source,
                 glm::dvec3& direction)
 {
     source->set_movement(glm::dvec3(0.0, 0.0, 0.0));
-    source->set_rotation(glm::dquat(1.0, 0.0, 0.0, 0.0));
+    source->set_rotation(glm::dvec3(0.0, 0.0, 0.0));
     return 1;
 }
 
@@ -72,28 +73,24 @@ int action_rotate(GameObject *source,
                   GameObject *target,
                   glm::dvec3& axis)
 {
+    glm::dvec3 spin = source->get_rotation();
+
+    if (glm::length(axis) == 0)
+        return (intensity == 0 ? 1 : 0);
+
+    glm::dvec3 rot = glm::normalize(axis);
+
+    /* Stop turning about the axis, but keep any other turn */
     if (intensity == 0)
     {
-        glm::dquat rot = source->get_rotation();
-        glm::dvec3 euler = glm::eulerAngles(rot);
-
-        if (axis.x != 0.0)
-            euler.x = 0.0;
-        else if (axis.y != 0.0)
-            euler.y = 0.0;
-        else if (axis.z != 0.0)
-            euler.z = 0.0;
-        source->set_rotation(glm::mix(rot, glm::dquat(euler), 1.0));
+        source->set_rotation(spin - rot * glm::dot(spin, rot),
+                             source->driven());
         return 1;
     }
 
-    glm::dvec3 rot = glm::normalize(axis);
-
     double inten = std::min(intensity, 100) / 100.0 * AVERAGE_ROTATION_SPEED;
 
-    source->set_rotation(glm::mix(source->get_rotation(),
-                                  glm::angleAxis(inten, rot),
-                                  inten));
+    source->set_rotation(spin + (rot * inten - spin) * inten, true);
     motion->push(source);
     return (int)inten;
 }
@@ -0,0 +1,56 @@
+/* register.cc
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * This file contains the un/registration functions for our console
+ * commands.
+ *
+ * Things to do
+ *
+ */
+
+#include "register.h"
+
+#define ENTRIES(x)  (int)(sizeof(x) / sizeof(x[0]))
+
+extern "C"
+{
+    void console_register(console_func_map_t& funcs)
+    {
+        int i;
+
+        for (i = 0; i < ENTRIES(commands); ++i)
+            funcs[commands[i].command_name] = commands[i].command_routine;
+    }
+
+    void console_unregister(console_func_map_t& funcs)
+    {
+        int i;
+
+        for (i = 0; i < ENTRIES(commands); ++i)
+        {
+            auto found = funcs.find(commands[i].command_name);
+
+            if (found != funcs.end()
+                && found->second == commands[i].command_routine)
+                funcs.erase(found);
+        }
+    }
+}
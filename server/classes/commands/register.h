@@ -0,0 +1,51 @@
+/* register.h                                              -*- C++ -*-
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * This file contains the un/registration function prototypes and the table
+ * of console commands that we support.
+ *
+ * Things to do
+ *
+ */
+
+#ifndef __INC_COMMANDS_REGISTER_H__
+#define __INC_COMMANDS_REGISTER_H__
+
+#include <string>
+
+#include "../console.h"
+
+/* Prototypes for each console command */
+std::string console_motion(std::string&);
+std::string console_sectors(std::string&);
+
+struct console_commands_list_tag
+{
+    const char *command_name;
+    console_func_t command_routine;
+}
+commands[] =
+{
+    { "motion",  console_motion  },
+    { "sectors", console_sectors }
+};
+
+#endif /* __INC_COMMANDS_REGISTER_H__ */
@@ -0,0 +1,39 @@
+/* sectors.cc
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * This file contains the console command which reports how the zone's
+ * sectors are shaped, so the octree parameters can be tuned on a
+ * running server, and how many objects in each are awake or asleep.
+ *
+ * Things to do
+ *
+ */
+
+#include <string>
+
+#include "../../server.h"
+
+std::string console_sectors(std::string& args)
+{
+    if (zone == NULL)
+        return "no zone";
+    return zone->sector_report();
+}
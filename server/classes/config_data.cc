@@ -25,6 +25,7 @@
  * Current configuration options include:
  *   AccessThreads <num>    number of access threads to start
  *   ActionThreads <num>    number of action threads to start
+ *   Broadphase <type>      collision broadphase - octree or sap
  *   Console <port type>    port specification for a console listener
  *   DBDatabase <dbname>    the name of the database to use
  *   DBHost <host>          database server hostname
@@ -32,13 +33,26 @@
  *   DBPort <port>          database server port
  *   DBType <type>          which database to use - mysql, pgsql, etc.
  *   DBUser <username>      the database username
+ *   Gravity <num>          gravitational constant, or 0 for no gravity
+ *   GravityTheta <num>     Barnes-Hut opening angle for gravity
  *   KeyFile <fname>        the file that contains the server crypto key
  *   LogFacility <string>   the facility that the program will use for syslog
  *   LogPrefix <string>     the prefix that the program will use in syslog
  *   MotionThreads <num>    number of motion threads to start
+ *   OctreeAdaptive         let each sector's octree pick its own depths
+ *   OctreeLeafObjects <n>  objects in an octree leaf before it splits
+ *   OctreeLooseness <num>  loose octree factor (> 1.0), or 0 for point octrees
+ *   OctreeMaxDepth <num>   deepest an octree may go
+ *   OctreeMinDepth <num>   depth to which an octree always splits
  *   PidFile <fname>        the pid/lock file to use
  *   Port <port type>       port specification for a server listener
+ *   RecordFile <fname>     record everything that happens, in tick mode
  *   SendThreads <num>      number of send threads to start
+ *   SleepAfter <num>       seconds something must be slow before it sleeps
+ *   SleepSpeed <num>       speed (m/s) below which something may sleep
+ *   SleepSpin <num>        spin (radians/s) below which something may sleep
+ *   SpatialIndex <type>    how sectors are indexed - octree or linear
+ *   TickRate <num>         motion ticks per second, or 0 to run freely
  *   ServerGID <group>      the server will run as group id <group>
  *   ServerRoot <path>      the server's root directory
  *   ServerUID <user>       the server will run as user id <user>
@@ -58,6 +72,11 @@
  *   (dgram|stream):<optional addr>:<port>
  *   unix:<path>
  *
+ * Command-line options are as follows:
+ *   -d                     don't become a daemon
+ *   -f <fname>             read the given config file
+ *   -r <fname>             replay the given recording, then exit
+ *
  * Comments can basically be anything that we don't explicitly
  * recognize.  Everything that doesn't fit these parameters is
  * ignored.
@@ -107,17 +126,30 @@ const int config_data::LOG_FACILITY   = LOG_DAEMON;
 const int config_data::NUM_THREADS    = 8;
 const int config_data::ZONE_SIZE      = 1000;
 const int config_data::ZONE_STEPS     = 2;
+const double config_data::OCTREE_LOOSENESS = 0.0;
+const int config_data::OCTREE_MIN_DEPTH = 5;
+const int config_data::OCTREE_MAX_DEPTH = 10;
+const int config_data::OCTREE_LEAF_OBJECTS = 3;
+const int config_data::TICK_RATE = 30;
+const double config_data::GRAVITY = 0.0;
+const double config_data::GRAVITY_THETA = 0.5;
+const double config_data::SLEEP_SPEED = 0.01;
+const double config_data::SLEEP_SPIN = 0.01;
+const double config_data::SLEEP_AFTER = 1.0;
 const char config_data::SERVER_ROOT[] = SERVER_ROOT_DIR;
 const char config_data::LOG_PREFIX[]  = "r9";
 const char config_data::PID_FNAME[]   = SERVER_PID_FNAME;
 const char config_data::DB_TYPE[]     = "MySQL";
 const char config_data::DB_HOST[]     = "localhost";
 const char config_data::DB_NAME[]     = "r9";
+const char config_data::BROADPHASE[]  = "octree";
+const char config_data::SPATIAL_INDEX[] = "octree";
 
 typedef void (*config_elem_t)(const std::string&, const std::string&, void *);
 
 static void config_string_element(const std::string&, const std::string&, void *);
 static void config_integer_element(const std::string&, const std::string&, void *);
+static void config_double_element(const std::string&, const std::string&, void *);
 static void config_boolean_element(const std::string&, const std::string&, void *);
 static void config_user_element(const std::string&, const std::string&, void *);
 static void config_group_element(const std::string&, const std::string&, void *);
@@ -139,32 +171,46 @@ const struct config_handlers
 handlers[] =
 {
 #define off(x)  (void *)(&(config.x))
-    { "AccessThreads", off(access_threads), &config_integer_element  },
-    { "ActionThreads", off(action_threads), &config_integer_element  },
-    { "Console",       off(consoles),       &config_port_element     },
-    { "DBDatabase",    off(db_name),        &config_string_element   },
-    { "DBHost",        off(db_host),        &config_string_element   },
-    { "DBPassword",    off(db_pass),        &config_string_element   },
-    { "DBPort",        off(db_port),        &config_integer_element  },
-    { "DBType",        off(db_type),        &config_string_element   },
-    { "DBUser",        off(db_user),        &config_string_element   },
-    { "KeyFile",       off(key),            &config_key_element      },
-    { "LogFacility",   off(log_facility),   &config_logfac_element   },
-    { "LogPrefix",     off(log_prefix),     &config_string_element   },
-    { "MotionThreads", off(motion_threads), &config_integer_element  },
-    { "PidFile",       off(pid_fname),      &config_string_element   },
-    { "Port",          off(listen_ports),   &config_port_element     },
-    { "SendThreads",   off(send_threads),   &config_integer_element  },
-    { "ServerGID",     NULL,                &config_group_element    },
-    { "ServerRoot",    off(server_root),    &config_string_element   },
-    { "ServerUID",     NULL,                &config_user_element     },
-    { "SpawnPoint",    off(spawn),          &config_location_element },
-    { "UpdateThreads", off(update_threads), &config_integer_element  },
-    { "UseKeepAlive",  off(use_keepalive),  &config_boolean_element  },
-    { "UseLinger",     off(use_linger),     &config_integer_element  },
-    { "UseNonBlock",   off(use_nonblock),   &config_boolean_element  },
-    { "UseReuse",      off(use_reuse),      &config_boolean_element  },
-    { "ZoneSize",      off(size),           &config_location_element },
+    { "AccessThreads",     off(access_threads),      &config_integer_element  },
+    { "ActionThreads",     off(action_threads),      &config_integer_element  },
+    { "Broadphase",        off(broadphase),          &config_string_element   },
+    { "Console",           off(consoles),            &config_port_element     },
+    { "DBDatabase",        off(db_name),             &config_string_element   },
+    { "DBHost",            off(db_host),             &config_string_element   },
+    { "DBPassword",        off(db_pass),             &config_string_element   },
+    { "DBPort",            off(db_port),             &config_integer_element  },
+    { "DBType",            off(db_type),             &config_string_element   },
+    { "DBUser",            off(db_user),             &config_string_element   },
+    { "Gravity",           off(gravity),             &config_double_element   },
+    { "GravityTheta",      off(gravity_theta),       &config_double_element   },
+    { "KeyFile",           off(key),                 &config_key_element      },
+    { "LogFacility",       off(log_facility),        &config_logfac_element   },
+    { "LogPrefix",         off(log_prefix),          &config_string_element   },
+    { "MotionThreads",     off(motion_threads),      &config_integer_element  },
+    { "OctreeAdaptive",    off(octree_adaptive),     &config_boolean_element  },
+    { "OctreeLeafObjects", off(octree_leaf_objects), &config_integer_element  },
+    { "OctreeLooseness",   off(octree_looseness),    &config_double_element   },
+    { "OctreeMaxDepth",    off(octree_max_depth),    &config_integer_element  },
+    { "OctreeMinDepth",    off(octree_min_depth),    &config_integer_element  },
+    { "PidFile",           off(pid_fname),           &config_string_element   },
+    { "Port",              off(listen_ports),        &config_port_element     },
+    { "RecordFile",        off(record_fname),        &config_string_element   },
+    { "SendThreads",       off(send_threads),        &config_integer_element  },
+    { "ServerGID",         NULL,                     &config_group_element    },
+    { "ServerRoot",        off(server_root),         &config_string_element   },
+    { "ServerUID",         NULL,                     &config_user_element     },
+    { "SleepAfter",        off(sleep_after),         &config_double_element   },
+    { "SleepSpeed",        off(sleep_speed),         &config_double_element   },
+    { "SleepSpin",         off(sleep_spin),          &config_double_element   },
+    { "SpatialIndex",      off(spatial_index),       &config_string_element   },
+    { "SpawnPoint",        off(spawn),               &config_location_element },
+    { "TickRate",          off(tick_rate),           &config_integer_element  },
+    { "UpdateThreads",     off(update_threads),      &config_integer_element  },
+    { "UseKeepAlive",      off(use_keepalive),       &config_boolean_element  },
+    { "UseLinger",         off(use_linger),          &config_integer_element  },
+    { "UseNonBlock",       off(use_nonblock),        &config_boolean_element  },
+    { "UseReuse",          off(use_reuse),           &config_boolean_element  },
+    { "ZoneSize",          off(size),                &config_location_element },
 #undef off
 };
 
@@ -184,7 +230,10 @@ config_data::config_data()
       server_root(config_data::SERVER_ROOT),
       log_prefix(config_data::LOG_PREFIX), pid_fname(config_data::PID_FNAME),
       db_type(config_data::DB_TYPE), db_host(config_data::DB_HOST),
-      db_user(), db_pass(), db_name(config_data::DB_NAME)
+      db_user(), db_pass(), db_name(config_data::DB_NAME),
+      broadphase(config_data::BROADPHASE),
+      spatial_index(config_data::SPATIAL_INDEX),
+      record_fname(), replay_fname()
 {
     this->set_defaults();
 }
@@ -220,6 +269,12 @@ void config_data::set_defaults(void)
     this->motion_threads = config_data::NUM_THREADS;
     this->send_threads   = config_data::NUM_THREADS;
     this->update_threads = config_data::NUM_THREADS;
+    this->tick_rate      = config_data::TICK_RATE;
+    this->gravity        = config_data::GRAVITY;
+    this->gravity_theta  = config_data::GRAVITY_THETA;
+    this->sleep_speed    = config_data::SLEEP_SPEED;
+    this->sleep_spin     = config_data::SLEEP_SPIN;
+    this->sleep_after    = config_data::SLEEP_AFTER;
 
     this->size.dim[0]    = config_data::ZONE_SIZE;
     this->size.dim[1]    = config_data::ZONE_SIZE;
@@ -229,6 +284,16 @@ void config_data::set_defaults(void)
     this->size.steps[1]  = config_data::ZONE_STEPS;
     this->size.steps[2]  = config_data::ZONE_STEPS;
 
+    this->octree_looseness    = config_data::OCTREE_LOOSENESS;
+    this->octree_min_depth    = config_data::OCTREE_MIN_DEPTH;
+    this->octree_max_depth    = config_data::OCTREE_MAX_DEPTH;
+    this->octree_leaf_objects = config_data::OCTREE_LEAF_OBJECTS;
+    this->octree_adaptive     = false;
+    this->broadphase          = config_data::BROADPHASE;
+    this->spatial_index       = config_data::SPATIAL_INDEX;
+    this->record_fname        = "";
+    this->replay_fname        = "";
+
     this->key.priv_key = NULL;
     memset(this->key.pub_key, 0, sizeof(this->key.pub_key));
 }
@@ -296,6 +361,8 @@ void config_data::parse_command_line(int count, char **args)
             this->read_config_file(*(++j));
         else if ((*j) == "-d")
             this->daemonize = false;
+        else if ((*j) == "-r")
+            this->replay_fname = *(++j);
         else
             std::clog << "WARNING: Unknown option " << *j;
     }
@@ -368,6 +435,15 @@ static void config_integer_element(const std::string& key,
     *element = std::stoi(value);
 }
 
+static void config_double_element(const std::string& key,
+                                  const std::string& value,
+                                  void *ptr)
+{
+    double *element = (double *)ptr;
+
+    *element = std::stod(value);
+}
+
 static void config_boolean_element(const std::string& key,
                                    const std::string& value,
                                    void *ptr)
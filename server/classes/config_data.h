@@ -59,12 +59,24 @@ class config_data
     static const int NUM_THREADS;
     static const int ZONE_SIZE;
     static const int ZONE_STEPS;
+    static const double OCTREE_LOOSENESS;
+    static const int OCTREE_MIN_DEPTH;
+    static const int OCTREE_MAX_DEPTH;
+    static const int OCTREE_LEAF_OBJECTS;
+    static const int TICK_RATE;
+    static const double GRAVITY;
+    static const double GRAVITY_THETA;
+    static const double SLEEP_SPEED;
+    static const double SLEEP_SPIN;
+    static const double SLEEP_AFTER;
     static const char SERVER_ROOT[];
     static const char LOG_PREFIX[];
     static const char PID_FNAME[];
     static const char DB_TYPE[];
     static const char DB_HOST[];
     static const char DB_NAME[];
+    static const char BROADPHASE[];
+    static const char SPATIAL_INDEX[];
 
     std::vector<std::string> argv;
     std::vector<Addrinfo *> listen_ports, consoles;
@@ -72,10 +84,17 @@ class config_data
     int use_linger, log_facility;
     std::string server_root, log_prefix, pid_fname;
     int access_threads, action_threads, motion_threads, send_threads;
-    int update_threads;
+    int update_threads, tick_rate;
+    double gravity, gravity_theta;
+    double sleep_speed, sleep_spin, sleep_after;
     location size, spawn;
+    double octree_looseness;
+    int octree_min_depth, octree_max_depth, octree_leaf_objects;
+    bool octree_adaptive;
     std::string db_type, db_host, db_user, db_pass, db_name;
     int db_port;
+    std::string broadphase, spatial_index;
+    std::string record_fname, replay_fname;
 
     crypto_key key;
 
@@ -0,0 +1,187 @@
+/* contact_islands.cc
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * The implementation of the contact islands.  Building the islands
+ * is a plain union-find over the sorted contacts; an island comes
+ * into being at the first contact we see for it, so they come out in
+ * order of the lowest ID in each.
+ *
+ * Things to do
+ *
+ */
+
+#include <algorithm>
+
+#include "contact_islands.h"
+
+ContactIslands::ContactIslands()
+    : lock(), found(), islands(), island_index()
+{
+}
+
+ContactIslands::~ContactIslands()
+{
+    this->clear();
+}
+
+/* Either object can find the other, so each pair goes in with the
+ * lower ID first.
+ */
+void ContactIslands::add(GameObject *a, GameObject *b)
+{
+    if (a == b)
+        return;
+    if (b->get_object_id() < a->get_object_id())
+        std::swap(a, b);
+
+    std::scoped_lock lock(this->lock);
+    this->found.push_back(std::make_pair(a, b));
+}
+
+void ContactIslands::add(const contact_list_t& contacts)
+{
+    for (auto& c : contacts)
+        this->add(c.first, c.second);
+}
+
+/* Returns how many islands there are */
+size_t ContactIslands::build(void)
+{
+    std::scoped_lock lock(this->lock);
+    std::unordered_map<GameObject *, size_t> node;
+    std::vector<size_t> parent, which;
+    object_list_t objects;
+    auto by_ids = [](const contact& a, const contact& b) {
+        uint64_t a1 = a.first->get_object_id();
+        uint64_t b1 = b.first->get_object_id();
+
+        return (a1 < b1 || (a1 == b1 && a.second->get_object_id()
+                                        < b.second->get_object_id()));
+    };
+    auto node_of = [&](GameObject *go) {
+        auto n = node.insert(std::make_pair(go, objects.size()));
+
+        if (n.second)
+        {
+            objects.push_back(go);
+            parent.push_back(parent.size());
+        }
+        return n.first->second;
+    };
+    auto root = [&](size_t n) {
+        while (parent[n] != n)
+            n = parent[n] = parent[parent[n]];
+        return n;
+    };
+
+    this->islands.clear();
+    this->island_index.clear();
+
+    std::sort(this->found.begin(), this->found.end(), by_ids);
+    this->found.erase(std::unique(this->found.begin(), this->found.end()),
+                      this->found.end());
+    node.reserve(this->found.size() * 2);
+    this->island_index.reserve(this->found.size() * 2);
+
+    for (auto& c : this->found)
+    {
+        size_t a = root(node_of(c.first)), b = root(node_of(c.second));
+
+        if (a != b)
+            parent[std::max(a, b)] = std::min(a, b);
+    }
+
+    which.resize(objects.size(), objects.size());
+    for (auto& c : this->found)
+    {
+        size_t r = root(node[c.first]);
+
+        if (which[r] == objects.size())
+        {
+            which[r] = this->islands.size();
+            this->islands.push_back(island());
+        }
+        this->islands[which[r]].contacts.push_back(c);
+    }
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        size_t n = which[root(i)];
+
+        this->islands[n].members.push_back(objects[i]);
+        this->island_index[objects[i]] = n;
+    }
+    for (auto& i : this->islands)
+        std::sort(i.members.begin(), i.members.end(),
+                  [](GameObject *a, GameObject *b) {
+                      return a->get_object_id() < b->get_object_id();
+                  });
+    return this->islands.size();
+}
+
+void ContactIslands::clear(void)
+{
+    std::scoped_lock lock(this->lock);
+
+    this->found.clear();
+    this->islands.clear();
+    this->island_index.clear();
+}
+
+size_t ContactIslands::size(void)
+{
+    return this->islands.size();
+}
+
+size_t ContactIslands::contacts(void)
+{
+    return this->found.size();
+}
+
+ContactIslands::island& ContactIslands::operator[](size_t n)
+{
+    return this->islands[n];
+}
+
+/* Returns -1 for anything which isn't touching anything */
+int ContactIslands::island_of(GameObject *go)
+{
+    auto found = this->island_index.find(go);
+
+    if (found == this->island_index.end())
+        return -1;
+    return found->second;
+}
+
+/* Whichever of the pair is moving runs into the other.  Returns how
+ * many actually hit; the ones earlier in the island can move things
+ * out of the way of the later ones.
+ */
+size_t ContactIslands::solve(size_t n)
+{
+    size_t hits = 0;
+
+    for (auto& c : this->islands[n].contacts)
+        if (c.first->still_moving()
+            ? c.first->collide(c.second)
+            : c.second->collide(c.first))
+            ++hits;
+    return hits;
+}
@@ -0,0 +1,91 @@
+/* contact_islands.h                                       -*- C++ -*-
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * This file contains the declaration of the contact islands, which
+ * sort out a tick's worth of collisions.
+ *
+ * Over the course of a tick, every pair of objects which touch is
+ * added, from as many threads as like.  Once they're all in, we
+ * build the islands:  groups of objects which are connected to each
+ * other by touching, directly or through some others.  Nothing in
+ * one island touches anything in another, so each island can be
+ * resolved on its own, on whatever thread, and nothing another island
+ * does can change its answer.  The objects of different islands can
+ * still live in the same motion state chunk, so the threads do
+ * sometimes queue up briefly on a chunk's lock.
+ *
+ * Inside an island, the contacts are always resolved in the same
+ * order, by the IDs of the objects in them, and each pair only once,
+ * no matter which of the two found the other.  However the islands
+ * get spread out over the threads, the results are the same.
+ *
+ * Things to do
+ *
+ */
+
+#ifndef __INC_CONTACT_ISLANDS_H__
+#define __INC_CONTACT_ISLANDS_H__
+
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "game_obj.h"
+
+class ContactIslands
+{
+  public:
+    typedef std::vector<GameObject *> object_list_t;
+    typedef std::pair<GameObject *, GameObject *> contact;
+    typedef std::vector<contact> contact_list_t;
+
+    typedef struct island_tag
+    {
+        object_list_t members;
+        contact_list_t contacts;
+    }
+    island;
+
+  private:
+    std::mutex lock;
+    contact_list_t found;
+    std::vector<island> islands;
+    std::unordered_map<GameObject *, size_t> island_index;
+
+  public:
+    ContactIslands();
+    ~ContactIslands();
+
+    void add(GameObject *, GameObject *);
+    void add(const contact_list_t&);
+    size_t build(void);
+    void clear(void);
+
+    size_t size(void);
+    size_t contacts(void);
+    island& operator[](size_t);
+    int island_of(GameObject *);
+
+    size_t solve(size_t);
+};
+
+#endif /* __INC_CONTACT_ISLANDS_H__ */
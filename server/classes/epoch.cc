@@ -0,0 +1,134 @@
+/* epoch.cc
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * This file contains the implementation of the epoch-based
+ * reclamation scheme.
+ *
+ * Readers publish their epoch and then fence, and writers unlink
+ * things and then bump the epoch (which is also a full fence) before
+ * they look at what the readers have published.  So either a writer
+ * sees a reader's epoch, or the reader sees the writer's unlink, and
+ * never neither.
+ *
+ * Things to do
+ *
+ */
+
+#include <stddef.h>
+
+#include "epoch.h"
+
+const uint64_t Epoch::IDLE = UINT64_MAX;
+
+std::atomic<uint64_t> Epoch::global_epoch(1);
+std::atomic<Epoch::record *> Epoch::records(NULL);
+thread_local Epoch::thread_record Epoch::self;
+
+Epoch::thread_record::thread_record()
+{
+    this->rec = NULL;
+    this->depth = 0;
+}
+
+/* The thread is going away, so somebody else can have its record */
+Epoch::thread_record::~thread_record()
+{
+    if (this->rec != NULL)
+    {
+        this->rec->epoch.store(Epoch::IDLE, std::memory_order_release);
+        this->rec->in_use.store(false, std::memory_order_release);
+    }
+}
+
+/* Find a record nobody's using, or add a new one.  Records are never
+ * freed, so anyone walking the list can't trip over a stale one.
+ */
+Epoch::record *Epoch::acquire(void)
+{
+    Epoch::record *rec;
+    bool expected;
+
+    for (rec = Epoch::records.load(std::memory_order_acquire);
+         rec != NULL;
+         rec = rec->next)
+    {
+        expected = false;
+        if (!rec->in_use.load(std::memory_order_relaxed)
+            && rec->in_use.compare_exchange_strong(expected, true))
+            return rec;
+    }
+
+    rec = new Epoch::record;
+    rec->epoch.store(Epoch::IDLE, std::memory_order_relaxed);
+    rec->in_use.store(true, std::memory_order_relaxed);
+    rec->next = Epoch::records.load(std::memory_order_relaxed);
+    while (!Epoch::records.compare_exchange_weak(rec->next, rec))
+        ;
+    return rec;
+}
+
+Epoch::reader::reader()
+{
+    Epoch::thread_record& me = Epoch::self;
+
+    if (me.depth++ > 0)
+        return;
+    if (me.rec == NULL)
+        me.rec = Epoch::acquire();
+    me.rec->epoch.store(Epoch::global_epoch.load(std::memory_order_acquire),
+                        std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+Epoch::reader::~reader()
+{
+    Epoch::thread_record& me = Epoch::self;
+
+    if (--me.depth == 0)
+        me.rec->epoch.store(Epoch::IDLE, std::memory_order_release);
+}
+
+/* The stamp for something which has just been unlinked */
+uint64_t Epoch::now(void)
+{
+    return Epoch::global_epoch.load(std::memory_order_acquire);
+}
+
+/* Move the epoch along, and find the earliest one any reader is
+ * still in.  Anything stamped before that is safe to reclaim.
+ */
+uint64_t Epoch::oldest(void)
+{
+    uint64_t result = Epoch::global_epoch.fetch_add(1) + 1, e;
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (Epoch::record *rec = Epoch::records.load(std::memory_order_acquire);
+         rec != NULL;
+         rec = rec->next)
+        if ((e = rec->epoch.load(std::memory_order_acquire)) < result)
+            result = e;
+    return result;
+}
+
+bool Epoch::safe(uint64_t stamp, uint64_t oldest)
+{
+    return stamp < oldest;
+}
@@ -0,0 +1,93 @@
+/* epoch.h                                                 -*- C++ -*-
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * This file contains the declaration of the epoch-based reclamation
+ * scheme, which lets readers walk shared structures without taking
+ * any locks at all.
+ *
+ * A reader announces which epoch it started in, and withdraws when
+ * it's done.  Anything a writer unlinks from a shared structure is
+ * stamped with the epoch it was unlinked in, and can't be freed or
+ * reused until every reader which is still around started in a later
+ * epoch - by then, nobody can possibly still be looking at it.  The
+ * epoch only moves forward when a writer wants to reclaim things.
+ *
+ * Readers can nest; only the outermost one on each thread counts.
+ * Each thread gets a record the first time it reads, which is given
+ * back when the thread exits, and reused by the next thread which
+ * needs one.  Writers still need to keep out of each other's way by
+ * themselves.
+ *
+ * Things to do
+ *
+ */
+
+#ifndef __INC_EPOCH_H__
+#define __INC_EPOCH_H__
+
+#include <cstdint>
+#include <atomic>
+
+class Epoch
+{
+  public:
+    static const uint64_t IDLE;
+
+  private:
+    class record
+    {
+      public:
+        std::atomic<uint64_t> epoch;
+        std::atomic<bool> in_use;
+        record *next;
+    };
+
+    class thread_record
+    {
+      public:
+        record *rec;
+        int depth;
+
+        thread_record();
+        ~thread_record();
+    };
+
+    static std::atomic<uint64_t> global_epoch;
+    static std::atomic<record *> records;
+    static thread_local thread_record self;
+
+    static record *acquire(void);
+
+  public:
+    /* Hold one of these for as long as we're reading */
+    class reader
+    {
+      public:
+        reader();
+        ~reader();
+    };
+
+    static uint64_t now(void);
+    static uint64_t oldest(void);
+    static bool safe(uint64_t, uint64_t);
+};
+
+#endif /* __INC_EPOCH_H__ */
@@ -29,6 +29,7 @@
  */
 
 #include <algorithm>
+#include <cmath>
 #include <sstream>
 #include <system_error>
 
@@ -39,7 +40,7 @@ std::mutex GameObject::max_mutex;
 uint64_t GameObject::max_id_value = 0LL;
 
 glm::dvec3 GameObject::no_movement(0.0, 0.0, 0.0);
-glm::dquat GameObject::no_rotation(1.0, 0.0, 0.0, 0.0);
+glm::dvec3 GameObject::no_rotation(0.0, 0.0, 0.0);
 
 uint64_t GameObject::reset_max_id(void)
 {
@@ -52,9 +53,9 @@ uint64_t GameObject::reset_max_id(void)
 }
 
 GameObject::GameObject(Geometry *g, Control *c, uint64_t newid)
-    : position(), movement(), look(0.0, 1.0, 0.0),
-      orient(1.0, 0.0, 0.0, 0.0), rotation(1.0, 0.0, 0.0, 0.0), movement_lock()
+    : look(0.0, 1.0, 0.0), in_motion(false)
 {
+    this->motion = MotionState::allocate(this, this->slot);
     if (g == NULL)
         g = new Geometry();
     this->default_master = this->master = c;
@@ -74,11 +75,12 @@ GameObject::GameObject(Geometry *g, Control *c, uint64_t newid)
     }
 
     this->id_value = newid;
-    gettimeofday(&this->last_updated, NULL);
+    this->last_updated = SimClock::now();
 }
 
 GameObject::~GameObject()
 {
+    MotionState::release(this->motion, this->slot);
     if (this->geometry != this->default_geometry && this->geometry != NULL)
         delete this->geometry;
     if (this->default_geometry != NULL)
@@ -122,10 +124,11 @@ void GameObject::disconnect(Control *con)
 
 void GameObject::activate(void)
 {
-    std::unique_lock lock(this->movement_lock);
+    MotionState::writer guard(this->motion);
     this->natures.erase(GameObject::nature::invisible);
     this->natures.erase(GameObject::nature::non_interactive);
     this->active = true;
+    this->motion->update(this->slot, this->active);
 }
 
 void GameObject::deactivate(void)
@@ -135,168 +138,334 @@ void GameObject::deactivate(void)
      * movement and rotation, and make it stop interacting with the
      * rest of the universe.
      */
-    std::unique_lock lock(this->movement_lock);
-    this->movement = GameObject::no_movement;
-    this->rotation = GameObject::no_rotation;
+    MotionState::writer guard(this->motion);
+    this->motion->set_movement(this->slot, GameObject::no_movement);
+    this->motion->set_rotation(this->slot, GameObject::no_rotation);
     this->natures.insert(GameObject::nature::invisible);
     this->natures.insert(GameObject::nature::non_interactive);
     this->active = false;
+    this->motion->update(this->slot, this->active);
 }
 
 double GameObject::distance_from(const glm::dvec3& pt)
 {
-    std::shared_lock lock(this->movement_lock);
-    return glm::distance(pt, this->position);
+    return glm::distance(pt, this->get_position());
 }
 
 glm::dvec3 GameObject::get_position(void)
 {
-    std::shared_lock lock(this->movement_lock);
-    glm::dvec3 res = this->position;
+    glm::dvec3 res;
+
+    this->motion->read([&] { res = this->motion->get_position(this->slot); });
     return res;
 }
 
 glm::dvec3 GameObject::set_position(const glm::dvec3& p)
 {
-    std::unique_lock lock(this->movement_lock);
-    this->position = p;
-    gettimeofday(&this->last_updated, NULL);
+    MotionState::writer guard(this->motion);
+    this->motion->set_position(this->slot, p);
+    this->motion->set_last_position(this->slot, p);
+    this->last_updated = SimClock::now();
     return p;
 }
 
+/* Where we were at the start of our last move, and where we are now.
+ * Anything which puts us somewhere, or sends us off in a new
+ * direction, starts a new path.
+ */
+void GameObject::get_path(glm::dvec3& from, glm::dvec3& to)
+{
+    this->motion->read(
+        [&] {
+            from = this->motion->get_last_position(this->slot);
+            to = this->motion->get_position(this->slot);
+        }
+    );
+}
+
 glm::dvec3 GameObject::get_look(void)
 {
-    std::shared_lock lock(this->movement_lock);
-    glm::dvec3 res = this->look;
+    glm::dvec3 res;
+
+    this->motion->read([&] { res = this->look; });
     return res;
 }
 
 glm::dvec3 GameObject::set_look(const glm::dvec3& l)
 {
-    std::unique_lock lock(this->movement_lock);
+    MotionState::writer guard(this->motion);
     this->look = l;
-    gettimeofday(&this->last_updated, NULL);
+    this->last_updated = SimClock::now();
     return l;
 }
 
 glm::dvec3 GameObject::get_movement(void)
 {
-    std::shared_lock lock(this->movement_lock);
-    glm::dvec3 res = this->movement;
+    glm::dvec3 res;
+
+    this->motion->read([&] { res = this->motion->get_movement(this->slot); });
     return res;
 }
 
-glm::dvec3 GameObject::set_movement(const glm::dvec3& m)
+/* An action passes driven, so we don't put its mover to sleep; any
+ * other movement, like a collision's, is just physics.
+ */
+glm::dvec3 GameObject::set_movement(const glm::dvec3& m, bool driven)
 {
-    std::unique_lock lock(this->movement_lock);
-    this->movement = m;
-    gettimeofday(&this->last_updated, NULL);
+    MotionState::writer guard(this->motion);
+    this->motion->set_movement(this->slot, m);
+    this->motion->set_driven(this->slot, driven);
+    this->motion->set_last_position(this->slot,
+                                    this->motion->get_position(this->slot));
+    this->motion->update(this->slot, this->active);
+    this->last_updated = SimClock::now();
     return m;
 }
 
+/* A nudge to the movement, like gravity's, which leaves the path and
+ * whatever's driving us alone.
+ */
+bool GameObject::accelerate(const glm::dvec3& dv)
+{
+    MotionState::writer guard(this->motion);
+    if (!this->motion->accelerate(this->slot, dv, this->active))
+        return false;
+    this->last_updated = SimClock::now();
+    return true;
+}
+
 glm::dquat GameObject::get_orientation(void)
 {
-    std::shared_lock lock(this->movement_lock);
-    glm::dquat res = this->orient;
+    glm::dquat res;
+
+    this->motion->read(
+        [&] { res = this->motion->get_orientation(this->slot); });
     return res;
 }
 
 glm::dquat GameObject::set_orientation(const glm::dquat& o)
 {
-    std::unique_lock lock(this->movement_lock);
-    this->orient = o;
-    gettimeofday(&this->last_updated, NULL);
+    MotionState::writer guard(this->motion);
+    this->motion->set_orientation(this->slot, o);
+    this->last_updated = SimClock::now();
     return o;
 }
 
-glm::dquat GameObject::get_rotation(void)
+/* Our rotation is a spin:  the axis we turn about, as long as the
+ * number of radians a second we turn.
+ */
+glm::dvec3 GameObject::get_rotation(void)
 {
-    std::shared_lock lock(this->movement_lock);
-    glm::dquat res = this->rotation;
+    glm::dvec3 res;
+
+    this->motion->read([&] { res = this->motion->get_rotation(this->slot); });
     return res;
 }
 
-glm::dquat GameObject::set_rotation(const glm::dquat& r)
+glm::dvec3 GameObject::set_rotation(const glm::dvec3& r, bool driven)
 {
-    std::unique_lock lock(this->movement_lock);
-    this->rotation = r;
-    gettimeofday(&this->last_updated, NULL);
+    MotionState::writer guard(this->motion);
+    this->motion->set_rotation(this->slot, r);
+    this->motion->set_driven(this->slot, driven);
+    this->motion->update(this->slot, this->active);
+    this->last_updated = SimClock::now();
     return r;
 }
 
+/* Move along by however long it's been since we last moved */
 void GameObject::move_and_rotate(void)
 {
     if (this->still_moving())
     {
-        struct timeval current;
-        double interval;
-        std::unique_lock lock(this->movement_lock);
-
-        gettimeofday(&current, NULL);
-        interval = (current.tv_sec + (current.tv_usec / 1000000.0))
-            - (this->last_updated.tv_sec
-               + (this->last_updated.tv_usec / 1000000.0));
-        if (this->rotation != GameObject::no_rotation)
-            this->orient = glm::dquat(glm::eulerAngles(this->rotation)
-                                      * interval)
-                * this->orient;
-        if (this->movement != GameObject::no_movement)
-            this->position += this->orient * this->movement * interval;
-        memcpy(&this->last_updated, &current, sizeof(struct timeval));
+        MotionState::writer guard(this->motion);
+        uint64_t current = SimClock::now();
+
+        this->advance(SimClock::seconds(current - this->last_updated),
+                      current);
     }
 }
 
+/* Move along by exactly the given interval, for a fixed timestep */
+void GameObject::move_and_rotate(double interval)
+{
+    if (this->still_moving())
+    {
+        MotionState::writer guard(this->motion);
+
+        this->advance(interval, SimClock::now());
+    }
+}
+
+/* The caller must be writing to our chunk */
+void GameObject::advance(double interval, uint64_t current)
+{
+    this->motion->advance(this->slot, interval);
+    this->last_updated = current;
+}
+
 bool GameObject::still_moving(void)
 {
-    std::shared_lock lock(this->movement_lock);
-    return (this->active == true
-            && (this->movement != GameObject::no_movement
-                || this->rotation != GameObject::no_rotation));
+    bool res;
+
+    this->motion->read([&] { res = this->motion->is_moving(this->slot); });
+    return res;
+}
+
+bool GameObject::driven(void)
+{
+    bool res;
+
+    this->motion->read([&] { res = this->motion->is_driven(this->slot); });
+    return res;
+}
+
+bool GameObject::asleep(void)
+{
+    bool res;
+
+    this->motion->read([&] { res = this->motion->is_asleep(this->slot); });
+    return res;
 }
 
-/* TODO:  This assumes velocities are fairly low, and could miss
- * collisions between objects which are moving with very high
- * velocity.  We should project back along a decent quantum (perhaps
- * scaled by the actual velocity?) to see if there was a collision
- * along the path at all.
+/* How long we've been too slow to matter */
+double GameObject::calm(void)
+{
+    double res;
+
+    this->motion->read([&] { res = this->motion->get_calm(this->slot); });
+    return res;
+}
+
+/* Put back whether we were asleep, and how long we'd been calm, as a
+ * snapshot saw them; setting the movement or rotation clears both,
+ * so this goes after them.
  */
-bool GameObject::collide(GameObject *target)
+void GameObject::set_rest(bool asleep, double calm)
+{
+    MotionState::writer guard(this->motion);
+    this->motion->set_rest(this->slot, asleep, calm);
+}
+
+/* Each of us moves in a straight line over the interval, so relative
+ * to the target we start at some offset and travel along a single
+ * path.  Returns how far along that path, from 0 to 1, we first come
+ * within reach of the target, or a negative number if we never do.
+ */
+static double first_contact(const glm::dvec3& start,
+                            const glm::dvec3& path,
+                            double reach)
+{
+    double a = glm::dot(path, path);
+    double b = glm::dot(start, path);
+    double c = glm::dot(start, start) - reach * reach;
+    double disc;
+
+    /* Already touching; if we're not closing in, it only counts if
+     * we're still touching at the end.
+     */
+    if (c <= 0.0)
+        return (b < 0.0 ? 0.0 : (c + 2.0 * b + a <= 0.0 ? 1.0 : -1.0));
+    /* Standing still, or moving apart */
+    if (a == 0.0 || b >= 0.0)
+        return -1.0;
+    disc = b * b - a * c;
+    if (disc < 0.0)
+        return -1.0;
+    c = (-b - sqrt(disc)) / a;
+    return (c <= 1.0 ? c : -1.0);
+}
+
+/* We sweep both spheres over the interval of our last move, so a fast
+ * mover can't skip right past something between ticks.  A target
+ * which isn't moving any more only gets checked where it sits.
+ * Returns how far along our move we first touch the target, or a
+ * negative number if we don't, along with both paths.
+ */
+double GameObject::contact(GameObject *target,
+                           glm::dvec3& from, glm::dvec3& to,
+                           glm::dvec3& target_from, glm::dvec3& target_pos)
 {
     if (target == this)
-        return false;
+        return -1.0;
+
+    target->get_path(target_from, target_pos);
+    if (!target->still_moving())
+        target_from = target_pos;
+    this->get_path(from, to);
+    return first_contact(from - target_from,
+                         (to - from) - (target_pos - target_from),
+                         this->geometry->radius + target->geometry->radius);
+}
+
+double GameObject::contact(GameObject *target)
+{
+    glm::dvec3 from, to, target_from, target_pos;
+
+    return this->contact(target, from, to, target_from, target_pos);
+}
 
-    const glm::dvec3& target_pos = target->get_position();
+/* When we hit something partway along, we back up to where we
+ * touched.
+ */
+bool GameObject::collide(GameObject *target)
+{
+    glm::dvec3 from, to, target_from, target_pos;
+    double when = this->contact(target, from, to, target_from, target_pos);
 
-    if (this->active == true
-        && this->distance_from(target_pos)
-        <= this->geometry->radius + target->geometry->radius)
+    if (this->active == true && when >= 0.0)
     {
         const glm::dvec3& target_move = target->get_movement();
-        std::unique_lock lock(this->movement_lock);
-        const glm::dvec3 relative_vel = this->movement - target_move;
-        const glm::dvec3 normal = glm::normalize(target_pos - this->position);
-        const glm::dvec3 tangent = glm::normalize(
-            relative_vel - target_pos - this->position
-        );
-        double vel_normal = glm::dot(relative_vel, normal);
-        double vel_tangent = glm::dot(relative_vel, tangent);
-
-        this->movement = -normal * this->geometry->restitution
-            + (vel_tangent / 2 * tangent * (1 - this->geometry->friction));
-        lock.unlock();
+        glm::dvec3 position, movement, normal, tangent;
+        double vel_tangent;
+
+        {
+            MotionState::writer guard(this->motion);
+
+            position = this->motion->get_position(this->slot);
+            if (when > 0.0 && when < 1.0)
+            {
+                position = from + (to - from) * when;
+                target_pos = target_from + (target_pos - target_from) * when;
+            }
+            const glm::dvec3 relative_vel
+                = this->motion->get_movement(this->slot) - target_move;
+            normal = glm::normalize(target_pos - position);
+            tangent = glm::normalize(relative_vel - target_pos - position);
+            vel_tangent = glm::dot(relative_vel, tangent);
+
+            movement = -normal * this->geometry->restitution
+                + (vel_tangent / 2 * tangent
+                   * (1 - this->geometry->friction));
+            this->motion->set_position(this->slot, position);
+            this->motion->set_last_position(this->slot, position);
+            this->motion->set_movement(this->slot, movement);
+            this->motion->update(this->slot, this->active);
+        }
         target->set_movement(
             normal * target->geometry->restitution
             + (-vel_tangent / 2 * tangent * (1 - target->geometry->friction))
         );
-        return this->movement != GameObject::no_movement;
+        return movement != GameObject::no_movement;
     }
     return false;
 }
 
+/* Everything in the packet comes from the same moment */
 void GameObject::generate_update_packet(packet& pkt)
 {
-    std::shared_lock lock(this->movement_lock);
-    if (this->active == false)
+    glm::dvec3 pos, look;
+    glm::dquat orient;
+    bool is_active;
+
+    this->motion->read(
+        [&] {
+            is_active = this->active;
+            pos = this->motion->get_position(this->slot);
+            orient = this->motion->get_orientation(this->slot);
+            look = this->look;
+        }
+    );
+    if (is_active == false)
     {
         pkt.del.type = TYPE_OBJDEL;
         pkt.del.version = R9_PROTO_VER;
@@ -304,9 +473,9 @@ void GameObject::generate_update_packet(packet& pkt)
     }
     else
     {
-        glm::dvec3 pos = this->position * POSUPD_POS_SCALE;
-        glm::dquat orient = this->orient * POSUPD_ORIENT_SCALE;
-        glm::dvec3 look = this->look * POSUPD_LOOK_SCALE;
+        pos *= POSUPD_POS_SCALE;
+        orient = orient * POSUPD_ORIENT_SCALE;
+        look *= POSUPD_LOOK_SCALE;
 
         pkt.pos.type = TYPE_POSUPD;
         pkt.pos.version = R9_PROTO_VER;
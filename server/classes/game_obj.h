@@ -29,9 +29,8 @@
 #ifndef __INC_GAME_OBJ_H__
 #define __INC_GAME_OBJ_H__
 
-#include <sys/time.h>
-
 #include <cstdint>
+#include <atomic>
 #include <string>
 #include <unordered_map>
 #if STD_UNORDERED_SET_WORKS
@@ -40,13 +39,14 @@
 #include <set>
 #endif /* STD_UNORDERED_SET_WORKS */
 #include <mutex>
-#include <shared_mutex>
 
 #include <glm/vec3.hpp>
 #include <glm/geometric.hpp>
 #include <glm/gtc/quaternion.hpp>
 
 #include "../../proto/proto.h"
+#include "motion_state.h"
+#include "sim_clock.h"
 
 class GameObject;
 
@@ -72,20 +72,28 @@ class GameObject
     static uint64_t max_id_value;
 
     static glm::dvec3 no_movement;
-    static glm::dquat no_rotation;
+    static glm::dvec3 no_rotation;
 
     /* const */ uint64_t id_value;
     Geometry *default_geometry;
     Control *default_master;
 
-    std::shared_mutex movement_lock;
+    /* Where we are, and how we're moving, live in our slot in the
+     * motion state.  The rest of these are written and read along
+     * with it, the same way.
+     */
+    MotionState::chunk *motion;
+    int slot;
 
-    struct timeval last_updated;
-    glm::dvec3 position, movement, look;
-    glm::dquat orient, rotation;
+    uint64_t last_updated;
+    glm::dvec3 look;
 
     bool active;
 
+    void advance(double, uint64_t);
+    double contact(GameObject *,
+                   glm::dvec3&, glm::dvec3&, glm::dvec3&, glm::dvec3&);
+
   public:
     std::unordered_map<std::string, attribute> attributes;
 #if STD_UNORDERED_SET_WORKS
@@ -96,12 +104,20 @@ class GameObject
     Geometry *geometry;
     Control *master;
 
+    /* Set while we're waiting in, or being worked on by, the motion
+     * pool, so we're never in there more than once.
+     */
+    std::atomic<bool> in_motion;
+
   public:
     static uint64_t reset_max_id(void);
 
     GameObject(Geometry *, Control *, uint64_t = 0LL);
+    GameObject(const GameObject&) = delete;
     ~GameObject();
 
+    GameObject& operator=(const GameObject&) = delete;
+
     GameObject *clone(void) const;
 
     uint64_t get_object_id(void) const;
@@ -116,18 +132,26 @@ class GameObject
 
     glm::dvec3 get_position(void);
     glm::dvec3 set_position(const glm::dvec3&);
+    void get_path(glm::dvec3&, glm::dvec3&);
     glm::dvec3 get_movement(void);
-    glm::dvec3 set_movement(const glm::dvec3&);
+    glm::dvec3 set_movement(const glm::dvec3&, bool = false);
+    bool accelerate(const glm::dvec3&);
     glm::dvec3 get_look(void);
     glm::dvec3 set_look(const glm::dvec3&);
     glm::dquat get_orientation(void);
     glm::dquat set_orientation(const glm::dquat&);
-    glm::dquat get_rotation(void);
-    glm::dquat set_rotation(const glm::dquat&);
+    glm::dvec3 get_rotation(void);
+    glm::dvec3 set_rotation(const glm::dvec3&, bool = false);
 
     void move_and_rotate(void);
+    void move_and_rotate(double);
     bool still_moving(void);
+    bool driven(void);
+    bool asleep(void);
+    double calm(void);
+    void set_rest(bool, double);
 
+    double contact(GameObject *);
     bool collide(GameObject *);
 
     void generate_update_packet(packet& pkt);
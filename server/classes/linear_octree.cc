@@ -0,0 +1,482 @@
+/* linear_octree.cc
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * The implementation of the linear octree.
+ *
+ * The x cell number's bits go in the highest position of each group
+ * of three, then y, then z, which makes the octant numbering at each
+ * level the same as the pointer octree's.
+ *
+ * An implied node is its first code, its depth, and its bounds.  Its
+ * objects are the part of the array between its first code and the
+ * first code of the next node over, so each level of a query splits
+ * its parent's part of the array eight ways with binary searches.  We
+ * stop splitting once a node has no more than LEAF_ENTRIES objects in
+ * it, and just look at them all.
+ *
+ * Things to do
+ *
+ */
+
+#include <algorithm>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include "linear_octree.h"
+
+const int LinearOctree::CODE_BITS = 21;
+const int LinearOctree::LEAF_ENTRIES = 8;
+
+/* Spread the low 21 bits of a number out to every third bit */
+static inline uint64_t spread_bits(uint64_t v)
+{
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffULL;
+    v = (v | v << 16) & 0x1f0000ff0000ffULL;
+    v = (v | v << 8)  & 0x100f00f00f00f00fULL;
+    v = (v | v << 4)  & 0x10c30c30c30c30c3ULL;
+    v = (v | v << 2)  & 0x1249249249249249ULL;
+    return v;
+}
+
+LinearOctree::LinearOctree(const glm::dvec3& min, const glm::dvec3& max)
+    : SpatialIndex(min, max), lock(), entries()
+{
+}
+
+LinearOctree::~LinearOctree()
+{
+    this->entries.clear();
+}
+
+/* Anything outside our bounds gets the code of the nearest cell */
+uint64_t LinearOctree::morton(const glm::dvec3& pos)
+{
+    double cells = (double)(1ULL << LinearOctree::CODE_BITS);
+    glm::dvec3 n = (pos - this->min_point)
+        / (this->max_point - this->min_point) * cells;
+    uint64_t c[3];
+
+    for (int i = 0; i < 3; ++i)
+        c[i] = n[i] < 0.0 ? 0 : (n[i] >= cells ? (uint64_t)cells - 1
+                                                : (uint64_t)n[i]);
+    return spread_bits(c[0]) << 2 | spread_bits(c[1]) << 1
+        | spread_bits(c[2]);
+}
+
+bool LinearOctree::in_bounds(const glm::dvec3& pos)
+{
+    return pos.x >= this->min_point.x && pos.x < this->max_point.x
+        && pos.y >= this->min_point.y && pos.y < this->max_point.y
+        && pos.z >= this->min_point.z && pos.z < this->max_point.z;
+}
+
+/* Where the object is in the array, if it was put in at pos.  The
+ * caller must hold our lock.
+ */
+LinearOctree::entry_list_t::iterator LinearOctree::find_entry(
+    GameObject *gobj, const glm::dvec3& pos)
+{
+    entry_t e = std::make_pair(this->morton(pos), gobj);
+    auto i = std::lower_bound(this->entries.begin(), this->entries.end(), e);
+
+    if (i != this->entries.end() && *i == e)
+        return i;
+    return this->entries.end();
+}
+
+void LinearOctree::build(const SpatialIndex::object_list_t& objs)
+{
+    std::unique_lock write_lock(this->lock);
+    size_t old_size = this->entries.size();
+
+    if (this->broadphase != NULL)
+        this->broadphase->build(objs);
+    for (auto i : objs)
+        this->grow_radius(i);
+
+    this->entries.reserve(old_size + objs.size());
+    for (auto i : objs)
+        this->entries.push_back(
+            std::make_pair(this->morton(i->get_position()), i));
+    std::sort(this->entries.begin() + old_size, this->entries.end());
+    std::inplace_merge(this->entries.begin(),
+                       this->entries.begin() + old_size,
+                       this->entries.end());
+    this->count += objs.size();
+}
+
+void LinearOctree::insert(GameObject *gobj)
+{
+    std::unique_lock write_lock(this->lock);
+    entry_t e = std::make_pair(this->morton(gobj->get_position()), gobj);
+
+    this->entries.insert(
+        std::upper_bound(this->entries.begin(), this->entries.end(), e), e);
+    ++this->count;
+    this->grow_radius(gobj);
+    if (this->broadphase != NULL)
+        this->broadphase->insert(gobj);
+}
+
+/* The position is where the object was when it was put in */
+bool LinearOctree::remove(GameObject *gobj, const glm::dvec3& pos)
+{
+    std::unique_lock write_lock(this->lock);
+    auto i = this->find_entry(gobj, pos);
+
+    if (i == this->entries.end())
+        return false;
+    this->entries.erase(i);
+    --this->count;
+    if (this->broadphase != NULL)
+        this->broadphase->remove(gobj, pos);
+    return true;
+}
+
+/* The object has already moved from old_pos to its current position.
+ * If it's left our bounds, or wasn't here to begin with, nothing
+ * changes and we return false.
+ */
+bool LinearOctree::move(GameObject *gobj, const glm::dvec3& old_pos)
+{
+    glm::dvec3 new_pos = gobj->get_position();
+
+    if (!this->in_bounds(new_pos))
+        return false;
+
+    {
+        std::unique_lock write_lock(this->lock);
+        auto i = this->find_entry(gobj, old_pos);
+        entry_t e = std::make_pair(this->morton(new_pos), gobj);
+
+        if (i == this->entries.end())
+            return false;
+
+        /* Slide everything between the old spot and the new one over
+         * by one, and drop the object into the gap.
+         */
+        if (e > *i)
+        {
+            auto j = std::lower_bound(i + 1, this->entries.end(), e);
+
+            std::move(i + 1, j, i);
+            *(j - 1) = e;
+        }
+        else if (e < *i)
+        {
+            auto j = std::lower_bound(this->entries.begin(), i, e);
+
+            std::move_backward(j, i, i + 1);
+            *j = e;
+        }
+    }
+
+    if (this->broadphase != NULL)
+        this->broadphase->move(gobj, old_pos);
+    return true;
+}
+
+SpatialIndex *LinearOctree::find(GameObject *gobj)
+{
+    std::shared_lock read_lock(this->lock);
+
+    if (this->find_entry(gobj, gobj->get_position()) != this->entries.end())
+        return this;
+    return NULL;
+}
+
+bool LinearOctree::visit(SpatialIndex::visitor_t visitor, void *arg)
+{
+    std::shared_lock read_lock(this->lock);
+
+    for (auto& i : this->entries)
+        if (!visitor(i.second, arg))
+            return false;
+    return true;
+}
+
+/* Visit every object in the implied nodes which the sphere touches,
+ * or with exact set, only the ones whose centers are inside it.  The
+ * caller must hold our lock.
+ */
+bool LinearOctree::search(const glm::dvec3& pt,
+                          double radius,
+                          uint64_t code,
+                          int level,
+                          const glm::dvec3& cmin,
+                          const glm::dvec3& csize,
+                          LinearOctree::entry_list_t::iterator first,
+                          LinearOctree::entry_list_t::iterator last,
+                          SpatialIndex::visitor_t visitor,
+                          void *arg,
+                          bool exact)
+{
+    glm::dvec3 half = csize * 0.5;
+    glm::dvec3 off = glm::abs(pt - (cmin + half));
+    glm::dvec3 near = glm::max(off - half, glm::dvec3(0.0, 0.0, 0.0));
+    glm::dvec3 far = off + half;
+    double r2 = radius * radius;
+
+    if (first == last || glm::dot(near, near) > r2)
+        return true;
+
+    if (glm::dot(far, far) <= r2
+        || last - first <= LinearOctree::LEAF_ENTRIES
+        || level == LinearOctree::CODE_BITS)
+    {
+        bool check = exact && glm::dot(far, far) > r2;
+
+        for ( ; first != last; ++first)
+        {
+            if (check)
+            {
+                glm::dvec3 d = first->second->get_position() - pt;
+
+                if (glm::dot(d, d) > r2)
+                    continue;
+            }
+            if (!visitor(first->second, arg))
+                return false;
+        }
+        return true;
+    }
+
+    uint64_t span = 1ULL << (3 * (LinearOctree::CODE_BITS - level - 1));
+
+    for (int i = 0; i < 8; ++i)
+    {
+        entry_t end = std::make_pair(code + (i + 1) * span,
+                                     (GameObject *)NULL);
+        auto next = (i == 7 ? last : std::lower_bound(first, last, end));
+        glm::dvec3 sub(cmin.x + (i & 4 ? half.x : 0.0),
+                       cmin.y + (i & 2 ? half.y : 0.0),
+                       cmin.z + (i & 1 ? half.z : 0.0));
+
+        if (!this->search(pt, radius, code + i * span, level + 1,
+                          sub, half, first, next, visitor, arg, exact))
+            return false;
+        first = next;
+    }
+    return true;
+}
+
+bool LinearOctree::visit_sphere(const glm::dvec3& pt,
+                                double radius,
+                                SpatialIndex::visitor_t visitor,
+                                void *arg)
+{
+    std::shared_lock read_lock(this->lock);
+
+    return this->search(pt, radius, 0, 0,
+                        this->min_point, this->max_point - this->min_point,
+                        this->entries.begin(), this->entries.end(),
+                        visitor, arg, false);
+}
+
+static bool add_to_list(GameObject *go, void *arg)
+{
+    ((SpatialIndex::object_list_t *)arg)->push_back(go);
+    return true;
+}
+
+/* Every object whose center is within radius of the point */
+void LinearOctree::range(const glm::dvec3& pt,
+                         double radius,
+                         SpatialIndex::object_list_t& result)
+{
+    std::shared_lock read_lock(this->lock);
+
+    this->search(pt, radius, 0, 0,
+                 this->min_point, this->max_point - this->min_point,
+                 this->entries.begin(), this->entries.end(),
+                 add_to_list, (void *)&result, true);
+}
+
+/* Add our nearest objects to the caller's heap, just like the
+ * octree does, visiting the nearest implied nodes first.  The caller
+ * must hold our lock.
+ */
+void LinearOctree::closest(const glm::dvec3& pt,
+                           size_t k,
+                           double limit,
+                           uint64_t code,
+                           int level,
+                           const glm::dvec3& cmin,
+                           const glm::dvec3& csize,
+                           LinearOctree::entry_list_t::iterator first,
+                           LinearOctree::entry_list_t::iterator last,
+                           SpatialIndex::neighbor_list_t& best)
+{
+    if (last - first <= LinearOctree::LEAF_ENTRIES
+        || level == LinearOctree::CODE_BITS)
+    {
+        for ( ; first != last; ++first)
+        {
+            glm::dvec3 d = first->second->get_position() - pt;
+            double dist2 = glm::dot(d, d);
+
+            if (dist2 <= limit)
+                SpatialIndex::keep_nearest(best, k, dist2, first->second);
+        }
+        return;
+    }
+
+    struct
+    {
+        double dist2;
+        int octant;
+        LinearOctree::entry_list_t::iterator first, last;
+    }
+    subs[8];
+    uint64_t span = 1ULL << (3 * (LinearOctree::CODE_BITS - level - 1));
+    glm::dvec3 half = csize * 0.5;
+    int i, n = 0;
+
+    for (i = 0; i < 8; ++i)
+    {
+        entry_t end = std::make_pair(code + (i + 1) * span,
+                                     (GameObject *)NULL);
+        auto next = (i == 7 ? last : std::lower_bound(first, last, end));
+
+        if (next != first)
+        {
+            glm::dvec3 sub(cmin.x + (i & 4 ? half.x : 0.0),
+                           cmin.y + (i & 2 ? half.y : 0.0),
+                           cmin.z + (i & 1 ? half.z : 0.0));
+            glm::dvec3 d = glm::max(glm::abs(pt - (sub + half * 0.5))
+                                    - half * 0.5,
+                                    glm::dvec3(0.0, 0.0, 0.0));
+
+            subs[n++] = { glm::dot(d, d), i, first, next };
+        }
+        first = next;
+    }
+    std::sort(subs, subs + n,
+              [](const auto& a, const auto& b) { return a.dist2 < b.dist2; });
+
+    for (i = 0; i < n; ++i)
+    {
+        int oct = subs[i].octant;
+
+        if (subs[i].dist2 > limit
+            || (best.size() == k && subs[i].dist2 >= best.front().first))
+            break;
+        this->closest(pt, k, limit, code + oct * span, level + 1,
+                      glm::dvec3(cmin.x + (oct & 4 ? half.x : 0.0),
+                                 cmin.y + (oct & 2 ? half.y : 0.0),
+                                 cmin.z + (oct & 1 ? half.z : 0.0)),
+                      half, subs[i].first, subs[i].last, best);
+    }
+}
+
+void LinearOctree::nearest(const glm::dvec3& pt,
+                           size_t k,
+                           double max_dist,
+                           SpatialIndex::neighbor_list_t& best)
+{
+    std::shared_lock read_lock(this->lock);
+
+    if (k == 0)
+        return;
+    this->closest(pt, k, max_dist * max_dist, 0, 0,
+                  this->min_point, this->max_point - this->min_point,
+                  this->entries.begin(), this->entries.end(), best);
+}
+
+/* Like the octree, we go through the implied nodes in the order the
+ * ray enters them, padded by the biggest radius we hold, and stop
+ * once the next one starts beyond the ray's latest hit.
+ */
+void LinearOctree::raycast(SpatialIndex::ray& r)
+{
+    std::shared_lock read_lock(this->lock);
+    double pad = this->max_radius, dist;
+
+    if (r.enters(this->min_point - pad, this->max_point + pad, dist))
+        this->cast(r, pad, 0, 0,
+                   this->min_point, this->max_point - this->min_point,
+                   this->entries.begin(), this->entries.end());
+}
+
+void LinearOctree::cast(SpatialIndex::ray& r,
+                        double pad,
+                        uint64_t code,
+                        int level,
+                        const glm::dvec3& cmin,
+                        const glm::dvec3& csize,
+                        LinearOctree::entry_list_t::iterator first,
+                        LinearOctree::entry_list_t::iterator last)
+{
+    if (last - first <= LinearOctree::LEAF_ENTRIES
+        || level == LinearOctree::CODE_BITS)
+    {
+        for ( ; first != last; ++first)
+            r.hits(first->second);
+        return;
+    }
+
+    struct
+    {
+        double dist;
+        int octant;
+        LinearOctree::entry_list_t::iterator first, last;
+    }
+    subs[8];
+    uint64_t span = 1ULL << (3 * (LinearOctree::CODE_BITS - level - 1));
+    glm::dvec3 half = csize * 0.5;
+    double dist;
+    int i, n = 0;
+
+    for (i = 0; i < 8; ++i)
+    {
+        entry_t end = std::make_pair(code + (i + 1) * span,
+                                     (GameObject *)NULL);
+        auto next = (i == 7 ? last : std::lower_bound(first, last, end));
+
+        if (next != first)
+        {
+            glm::dvec3 sub(cmin.x + (i & 4 ? half.x : 0.0),
+                           cmin.y + (i & 2 ? half.y : 0.0),
+                           cmin.z + (i & 1 ? half.z : 0.0));
+
+            if (r.enters(sub - pad, sub + half + pad, dist))
+                subs[n++] = { dist, i, first, next };
+        }
+        first = next;
+    }
+    std::sort(subs, subs + n,
+              [](const auto& a, const auto& b) { return a.dist < b.dist; });
+
+    for (i = 0; i < n; ++i)
+    {
+        int oct = subs[i].octant;
+
+        if (subs[i].dist > r.max_dist)
+            break;
+        this->cast(r, pad, code + oct * span, level + 1,
+                   glm::dvec3(cmin.x + (oct & 4 ? half.x : 0.0),
+                              cmin.y + (oct & 2 ? half.y : 0.0),
+                              cmin.z + (oct & 1 ? half.z : 0.0)),
+                   half, subs[i].first, subs[i].last);
+    }
+}
@@ -0,0 +1,107 @@
+/* linear_octree.h                                         -*- C++ -*-
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * This file contains the declaration of the linear octree, a spatial
+ * index which has no nodes at all.
+ *
+ * Each object's position is quantized to a grid of 2^21 cells along
+ * each axis, and the bits of the three cell numbers are interleaved
+ * into a Morton code.  Every octree node, at every depth, is then a
+ * contiguous range of codes, so a flat array of (code, object) pairs
+ * sorted by code *is* the whole tree.  Queries walk the implied nodes
+ * the same way the octree does, but they find each node's objects
+ * with a binary search in one array, rather than chasing pointers.
+ *
+ * A moved object usually lands right next to where it was in the
+ * array, so we just slide it over into its new spot instead of
+ * sorting anything.
+ *
+ * The whole array has one lock.  Moves within a sector are
+ * serialized, where the octree could do moves in different subtrees
+ * at the same time.
+ *
+ * Like a point octree, objects are placed by their centers; there's
+ * no loose mode.
+ *
+ * Things to do
+ *
+ */
+
+#ifndef __INC_LINEAR_OCTREE_H__
+#define __INC_LINEAR_OCTREE_H__
+
+#include <cstdint>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "spatial_index.h"
+
+class LinearOctree : public SpatialIndex
+{
+  public:
+    static const int CODE_BITS;
+    static const int LEAF_ENTRIES;
+
+    typedef std::pair<uint64_t, GameObject *> entry_t;
+    typedef std::vector<entry_t> entry_list_t;
+
+  private:
+    std::shared_mutex lock;
+    entry_list_t entries;
+
+    uint64_t morton(const glm::dvec3&);
+    bool in_bounds(const glm::dvec3&);
+    entry_list_t::iterator find_entry(GameObject *, const glm::dvec3&);
+
+    bool search(const glm::dvec3&, double, uint64_t, int,
+                const glm::dvec3&, const glm::dvec3&,
+                entry_list_t::iterator, entry_list_t::iterator,
+                SpatialIndex::visitor_t, void *, bool);
+    void closest(const glm::dvec3&, size_t, double, uint64_t, int,
+                 const glm::dvec3&, const glm::dvec3&,
+                 entry_list_t::iterator, entry_list_t::iterator,
+                 neighbor_list_t&);
+    void cast(ray&, double, uint64_t, int,
+              const glm::dvec3&, const glm::dvec3&,
+              entry_list_t::iterator, entry_list_t::iterator);
+
+  public:
+    LinearOctree(const glm::dvec3&, const glm::dvec3&);
+    ~LinearOctree();
+
+    void build(const object_list_t&) override;
+    void insert(GameObject *) override;
+    bool remove(GameObject *, const glm::dvec3&) override;
+    bool move(GameObject *, const glm::dvec3&) override;
+    SpatialIndex *find(GameObject *) override;
+
+    bool visit(visitor_t, void *) override;
+    bool visit_sphere(const glm::dvec3&, double, visitor_t, void *) override;
+    void range(const glm::dvec3&, double, object_list_t&) override;
+    void nearest(const glm::dvec3&, size_t, double,
+                 neighbor_list_t&) override;
+    void raycast(ray&) override;
+};
+
+#endif /* __INC_LINEAR_OCTREE_H__ */
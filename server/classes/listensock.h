@@ -30,6 +30,7 @@
 
 #include <map>
 #include <functional>
+#include <shared_mutex>
 
 #include <proto/proto.h>
 #include <proto/encrypt.h>
@@ -22,85 +22,621 @@
  * The implementation of the Motion pool.  Any objects that are in
  * motion get pushed onto our work queue, and we handle their motion.
  * If they're still in motion once we get done with them, we just push
- * them back on our own queue.  We also push moved objects onto the
- * update pool's work queue, so people can be notified of their
- * movements.
+ * them back on our own queue.  Each object's in_motion flag says
+ * whether it's already ours, so it's never queued twice.  We also
+ * push moved objects onto the update pool's work queue, so people can
+ * be notified of their movements.
+ *
+ * When an object moves out of its sector, we take it out of the old
+ * sector right away, but collect it with any others which have done
+ * the same, and hand the whole batch off to their new sectors
+ * together.  We never hold locks in more than one sector at a time.
+ *
+ * In tick mode, one extra thread keeps time.  At each tick, it moves
+ * everything in the motion state at once, and moves whatever's in a
+ * sector along in its sector's index.  Then it feeds the whole lot to
+ * the workers to check for collisions, waits for them to finish, and
+ * passes the whole batch of changed objects on to the update pool.
+ * Since everything has moved before anything is checked, nothing
+ * runs into where something else used to be.  Whatever's touching
+ * gets sorted out in a second round, one island per worker.  If a
+ * tick runs long enough to miss the next one, we don't try to catch
+ * up; the simulation just runs a little slower than the clock until
+ * things settle down.
  *
  * Things to do
  *
  */
 
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
 #include "motion_pool.h"
+#include "motion_state.h"
+#include "sim_clock.h"
 #include "../server.h"
 
-MotionPool::MotionPool(const char *pool_name, unsigned int pool_size)
-    : ThreadPool<GameObject *>(pool_name, pool_size)
+/* How many objects crossing sector boundaries we'll collect before
+ * we hand them off to their new sectors.
+ */
+const size_t MotionPool::HANDOFF_BATCH = 64;
+
+MotionPool::MotionPool(const char *pool_name,
+                       unsigned int pool_size,
+                       unsigned int rate)
+    : ThreadPool<GameObject *>(pool_name, pool_size),
+      moves(0), updates(0), ticks(0), overruns(0), duplicates(0),
+      contacts(0), islands(0), pulls(0), busy_usec(0),
+      started(std::chrono::steady_clock::now()), ticker(),
+      tick_lock(), tick_wake(), tick_done(), changed(), sweeps(),
+      touching(), next_job(0)
 {
+    this->tick_rate = rate;
+    this->timestep = (rate > 0 ? 1.0 / rate : 0.0);
+    this->gravity = 0.0;
+    this->opening_angle = 0.5;
+    this->paced = true;
+    this->outstanding = 0;
+    this->solving = false;
+    this->tick_exit = false;
+    this->job = NULL;
+    this->job_count = 0;
+    this->pulling = false;
 }
 
 MotionPool::~MotionPool()
 {
+    this->stop();
 }
 
 void MotionPool::start(void)
 {
     this->startup_arg = (void *)this;
+    this->started = std::chrono::steady_clock::now();
+    SimClock::set_rate(this->tick_rate);
     this->ThreadPool<GameObject *>::start(MotionPool::motion_pool_worker);
+    if (this->tick_rate > 0 && this->paced && !this->ticker.joinable())
+    {
+        this->tick_exit = false;
+        this->ticker = std::thread(&MotionPool::run_ticks, this);
+    }
+}
+
+/* The ticker might be waiting for the workers, so it has to go
+ * first.
+ */
+void MotionPool::stop(void)
+{
+    {
+        std::scoped_lock lock(this->tick_lock);
+        this->tick_exit = true;
+    }
+    this->tick_wake.notify_all();
+    this->tick_done.notify_all();
+    if (this->ticker.joinable())
+        this->ticker.join();
+    this->ThreadPool<GameObject *>::stop();
+}
+
+/* In tick mode, anything which is moving will be picked up by the
+ * next tick anyway.
+ */
+void MotionPool::push(GameObject *& req)
+{
+    if (this->tick_rate > 0)
+        return;
+    if (req->in_motion.exchange(true))
+    {
+        ++this->duplicates;
+        return;
+    }
+    this->ThreadPool<GameObject *>::push(req);
+}
+
+/* A worker's done with an object.  Anything which was pushed while
+ * we had it was dropped, so if it's moving now, it goes back on.
+ */
+void MotionPool::release(GameObject *req)
+{
+    req->in_motion = false;
+    if (req->still_moving())
+        this->push(req);
+}
+
+void MotionPool::run_ticks(void)
+{
+    auto period = std::chrono::duration_cast<
+        std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(this->timestep));
+    auto next = std::chrono::steady_clock::now();
+    std::unique_lock lock(this->tick_lock);
+
+    for (;;)
+    {
+        next += period;
+        if (this->tick_wake.wait_until(lock, next,
+                                       [&] { return this->tick_exit; }))
+            break;
+        lock.unlock();
+        this->tick();
+        lock.lock();
+
+        auto now = std::chrono::steady_clock::now();
+        if (now > next + period)
+        {
+            ++this->overruns;
+            next = now;
+        }
+    }
+}
+
+/* Move the clock along, pull everything toward everything else if
+ * there's any gravity, then move everything which is moving, once,
+ * and send out the updates.
+ * Objects which the motion state moves, but which aren't in any of
+ * our sectors, aren't ours to worry about.  Objects go to the
+ * workers, and to the update pool, in order of their IDs, so a tick
+ * always goes the same way.
+ */
+void MotionPool::tick(void)
+{
+    auto by_id = [](GameObject *a, GameObject *b) {
+        return a->get_object_id() < b->get_object_id();
+    };
+    auto start = std::chrono::steady_clock::now();
+    SpatialIndex::object_list_t batch, handoffs, singles;
+    std::unique_lock<std::mutex> hold_actions;
+
+    /* No recorded action can land partway through */
+    if (recorder != NULL)
+        hold_actions = std::unique_lock<std::mutex>(recorder->order_lock);
+    SimClock::tick();
+    if (recorder != NULL)
+        recorder->tick();
+    if (zone != NULL)
+    {
+        std::shared_lock hold_sectors(zone->sector_lock);
+
+        if (this->gravity != 0.0)
+            this->pulls += zone->gravitate(
+                this->gravity, this->opening_angle, this->timestep,
+                [this](size_t count, const std::function<void(size_t)>& f) {
+                    this->spread(count, f);
+                }
+            );
+        MotionState::integrate(
+            this->timestep,
+            [&](GameObject *go, const glm::dvec3& from) {
+                SpatialIndex *sector = zone->sector_at(from);
+
+                if (sector == NULL)
+                    return;
+                if (!sector->move(go, from))
+                {
+                    if (!sector->remove(go, from))
+                        return;
+                    handoffs.push_back(go);
+                }
+                batch.push_back(go);
+            }
+        );
+        zone->hand_off(handoffs);
+
+        /* Sweeping sectors get all their movers checked at once */
+        std::sort(batch.begin(), batch.end(), by_id);
+        this->sweeps.clear();
+        for (auto req : batch)
+        {
+            SpatialIndex *sector = zone->sector_at(req->get_position());
+
+            if (sector != NULL && sector->broadphase != NULL)
+                this->sweeps[sector].push_back(req);
+            else
+                singles.push_back(req);
+        }
+    }
+    this->moves += batch.size();
+
+    {
+        std::unique_lock lock(this->tick_lock);
+
+        /* First everything finds what it's touching... */
+        this->touching.clear();
+        this->solving = false;
+        this->outstanding = singles.size() + this->sweeps.size();
+        for (auto req : singles)
+            this->ThreadPool<GameObject *>::push(req);
+        for (auto& sweep : this->sweeps)
+            this->ThreadPool<GameObject *>::push(sweep.second.front());
+        this->tick_done.wait(
+            lock,
+            [&] { return this->outstanding == 0 || this->tick_exit; });
+
+        /* ...then each island gets resolved all by itself */
+        if (!this->tick_exit)
+        {
+            this->islands += this->touching.build();
+            this->contacts += this->touching.contacts();
+            this->solving = true;
+            this->outstanding = this->touching.size();
+            for (size_t i = 0; i < this->touching.size(); ++i)
+            {
+                GameObject *lead = this->touching[i].members.front();
+
+                this->ThreadPool<GameObject *>::push(lead);
+            }
+            this->tick_done.wait(
+                lock,
+                [&] { return this->outstanding == 0 || this->tick_exit; });
+        }
+        batch.clear();
+        batch.swap(this->changed);
+    }
+
+    std::sort(batch.begin(), batch.end(), by_id);
+    batch.erase(std::unique(batch.begin(), batch.end()), batch.end());
+    for (auto req : batch)
+        update_pool->push(req);
+    this->updates += batch.size();
+
+    ++this->ticks;
+    this->busy_usec += std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+/* Take whatever blocks nobody else has taken yet */
+void MotionPool::work_jobs(void)
+{
+    size_t n;
+
+    while ((n = this->next_job++) < this->job_count)
+        (*this->job)(n);
+}
+
+/* Each worker gets a turn at the jobs, and so do we, rather than just
+ * waiting.  The workers have to be told one at a time, and each one
+ * sticks around until the jobs are all taken, so we only wait for
+ * them to come back.  The caller must hold the sector lock, which the
+ * workers don't take.
+ */
+void MotionPool::spread(size_t count, const std::function<void(size_t)>& f)
+{
+    size_t helpers = std::min<size_t>(this->pool_size(), count);
+    GameObject *none = NULL;
+
+    {
+        std::scoped_lock lock(this->tick_lock);
+
+        this->job = &f;
+        this->job_count = count;
+        this->next_job = 0;
+        this->pulling = true;
+        this->outstanding = helpers;
+        for (size_t i = 0; i < helpers; ++i)
+            this->ThreadPool<GameObject *>::push(none);
+    }
+    this->work_jobs();
+
+    std::unique_lock lock(this->tick_lock);
+    this->tick_done.wait(lock, [&] { return this->outstanding == 0; });
+    this->pulling = false;
+    this->job = NULL;
 }
 
 void MotionPool::motion_pool_worker(void *arg)
 {
     MotionPool *mot = (MotionPool *)arg;
+    SpatialIndex::object_list_t handoffs;
     GameObject *req;
-    Octree *sector;
+    SpatialIndex *sector;
+    glm::dvec3 old_pos;
 
     for (;;)
     {
+        /* Don't sit on any handoffs while we wait for more work */
+        if (!handoffs.empty()
+            && (handoffs.size() >= MotionPool::HANDOFF_BATCH
+                || mot->queue_size() == 0))
+            mot->hand_off(handoffs);
+
         if (!mot->pop(&req))
             break;
 
-        if (req->still_moving())
+        /* Gravity's pulls; the ticker holds the sector lock for us */
+        if (mot->pulling)
+        {
+            mot->work_jobs();
+            mot->done(req, false);
+            continue;
+        }
+
+        /* The tick has already moved it; we only check collisions */
+        if (mot->timestep > 0.0)
+        {
+            std::shared_lock hold_sectors(zone->sector_lock);
+
+            if (mot->solving)
+                mot->resolve(req);
+            else
+            {
+                sector = zone->sector_at(req->get_position());
+
+                /* Only the first mover in a sweeping sector comes
+                 * through, on behalf of all of them.
+                 */
+                auto sweep = mot->sweeps.find(sector);
+                if (sweep != mot->sweeps.end())
+                    mot->find_pairs(sector, sweep->second);
+                else
+                {
+                    mot->find_contacts(sector, req);
+                    mot->done(req, true);
+                }
+            }
+        }
+        else if (req->still_moving())
         {
-            sector = zone->sector_contains(req->get_position());
-            if (sector == NULL || !req->still_moving())
+            std::shared_lock hold_sectors(zone->sector_lock);
+
+            old_pos = req->get_position();
+            sector = zone->sector_contains(old_pos);
+            if (sector == NULL)
+            {
+                /* Nowhere to move it, so don't bring it back */
+                req->in_motion = false;
+                mot->done(req, false);
                 continue;
-            sector->remove(req);
-            req->move_and_rotate();
-            sector = zone->sector_contains(req->get_position());
-            if (sector != NULL)
+            }
+            if (!req->still_moving())
             {
-                sector->insert(req);
-                if (mot->collide(sector, req) || req->still_moving())
-                    mot->push(req);
+                mot->release(req);
+                mot->done(req, false);
+                continue;
             }
-            else
-                /* Should instead figure out the neighbor that it
-                 * needs to go to and make a motion request there.
+            req->move_and_rotate();
+            ++mot->moves;
+            if (!sector->move(req, old_pos))
+            {
+                /* It's left the sector (or was never in it).  We're
+                 * done with the old sector's locks now, and the new
+                 * sector gets it along with the rest of the batch.
                  */
+                sector->remove(req, old_pos);
+                handoffs.push_back(req);
                 continue;
-            update_pool->push(req);
-
+            }
+            mot->finish(sector, req);
+        }
+        else
+        {
+            mot->release(req);
+            mot->done(req, false);
         }
     }
+
+    /* Anything we were holding on to still needs a home */
+    if (!handoffs.empty())
+        mot->hand_off(handoffs);
 }
 
-bool MotionPool::collide(Octree *sector, GameObject *obj)
+/* Put a batch of objects which have been removed from their old
+ * sectors into their new ones, then carry on with them.
+ */
+void MotionPool::hand_off(SpatialIndex::object_list_t& objs)
 {
-    Octree *subtree = sector->find(obj);
+    std::shared_lock hold_sectors(zone->sector_lock);
+
+    zone->hand_off(objs);
+    for (auto req : objs)
+        this->finish(zone->sector_at(req->get_position()), req);
+    objs.clear();
+}
 
-    if (subtree == NULL)
-        return false;
+/* The object has moved, and is in the sector where it belongs. */
+void MotionPool::finish(SpatialIndex *sector, GameObject *req)
+{
+    if (sector != NULL)
+        this->collide(sector, req);
+    this->release(req);
+    this->done(req, true);
+}
 
-    for (GameObject *target : subtree->get_objects())
+/* We're finished with an object for now.  Running freely, its update
+ * goes out right away; in tick mode, it waits for the rest of the
+ * tick.
+ */
+void MotionPool::done(GameObject *req, bool moved)
+{
+    if (this->tick_rate == 0)
     {
-        bool already_moving = target->still_moving();
-        if (obj->collide(target))
+        if (moved)
         {
-            if (!already_moving && target->still_moving())
-                this->push(target);
+            update_pool->push(req);
+            ++this->updates;
+        }
+        return;
+    }
+
+    std::scoped_lock lock(this->tick_lock);
+    if (moved)
+        this->changed.push_back(req);
+    if (this->outstanding > 0 && --this->outstanding == 0)
+        this->tick_done.notify_one();
+}
+
+/* How much moving we've done, and how fast, since we started */
+std::string MotionPool::report(void)
+{
+    std::chrono::duration<double> up
+        = std::chrono::steady_clock::now() - this->started;
+    double secs = std::max(up.count(), 1e-9);
+    std::ostringstream s;
+
+    if (this->tick_rate > 0)
+    {
+        s << "tick mode, " << this->tick_rate << " Hz: " << this->ticks
+          << " ticks, " << this->overruns << " overruns, "
+          << std::fixed << std::setprecision(1)
+          << this->busy_usec / (secs * 1e4) << "% busy" << std::endl
+          << this->contacts << " contacts in " << this->islands
+          << " islands" << std::endl;
+        if (this->gravity != 0.0)
+            s << std::defaultfloat << std::setprecision(6)
+              << "gravity " << this->gravity
+              << ", opening angle " << this->opening_angle << ": "
+              << this->pulls << " pulls" << std::endl;
+    }
+    else
+        s << "free running, " << this->queue_size() << " queued, "
+          << this->duplicates << " duplicate pushes dropped" << std::endl;
+    s << std::fixed << std::setprecision(1)
+      << this->moves << " moves, " << this->moves / secs << " per second"
+      << std::endl
+      << this->updates << " updates, " << this->updates / secs
+      << " per second" << std::endl;
+    return s.str();
+}
+
+/* The broadphase gives us the objects which might be touching this
+ * one, and we call the visitor on each of them.  Anything along the
+ * whole of the object's last move is a candidate, so fast movers
+ * don't skip through things between ticks.  The tree only knows
+ * where things' centers are, so the sphere we look in has to reach
+ * as far as the biggest of them could stick out.
+ */
+template <typename F>
+static void for_each_candidate(SpatialIndex *sector,
+                               GameObject *obj,
+                               F&& visit)
+{
+    glm::dvec3 from, to;
+
+    obj->get_path(from, to);
+    if (sector->broadphase != NULL)
+        sector->broadphase->for_each_candidate(obj, visit);
+    else
+        sector->for_each_in_sphere((from + to) * 0.5,
+                                   glm::distance(from, to) * 0.5
+                                   + obj->geometry->radius
+                                   + sector->max_radius,
+                                   visit);
+}
+
+/* If we hit something partway along, the object has backed up to
+ * where it touched, which might not even be in this sector.
+ */
+void MotionPool::relocate(SpatialIndex *sector,
+                          GameObject *obj,
+                          const glm::dvec3& was)
+{
+    if (sector != NULL
+        && obj->get_position() != was
+        && !sector->move(obj, was))
+    {
+        SpatialIndex::object_list_t back(1, obj);
+
+        sector->remove(obj, was);
+        zone->hand_off(back);
+    }
+}
+
+/* Running freely, we check the candidates for real until we hit
+ * something.
+ */
+bool MotionPool::collide(SpatialIndex *sector, GameObject *obj)
+{
+    bool collided = false;
+    glm::dvec3 from, to;
+
+    obj->get_path(from, to);
+    for_each_candidate(
+        sector, obj,
+        [&](GameObject *target) {
+            bool already_moving = target->still_moving();
+
+            if (obj->collide(target))
+            {
+                if (!already_moving && target->still_moving())
+                    this->push(target);
+                collided = true;
+                return false;
+            }
+            return true;
+        }
+    );
+    this->relocate(sector, obj, to);
+    return collided;
+}
 
+/* In tick mode, we only note down everything the object is touching,
+ * and leave them all alone for now.
+ */
+void MotionPool::find_contacts(SpatialIndex *sector, GameObject *obj)
+{
+    ContactIslands::contact_list_t found;
+
+    if (sector == NULL)
+        return;
+    for_each_candidate(
+        sector, obj,
+        [&](GameObject *target) {
+            if (obj->contact(target) >= 0.0)
+                found.push_back(std::make_pair(obj, target));
             return true;
         }
+    );
+    this->touching.add(found);
+}
+
+/* One sweep over a sector finds everything its movers are touching.
+ * They've all moved, so they all need updates.
+ */
+void MotionPool::find_pairs(SpatialIndex *sector,
+                            SpatialIndex::object_list_t& moved)
+{
+    ContactIslands::contact_list_t found;
+    SweepAndPrune::pair_list_t pairs;
+    GameObject *lead = moved.front();
+
+    sector->broadphase->swept_pairs(moved, pairs);
+    for (auto& p : pairs)
+        if (p.first->contact(p.second) >= 0.0)
+            found.push_back(p);
+    this->touching.add(found);
+
+    {
+        std::scoped_lock lock(this->tick_lock);
+
+        this->changed.insert(this->changed.end(), moved.begin(), moved.end());
+    }
+    this->done(lead, false);
+}
+
+/* We get the first object of an island, and resolve the whole thing.
+ * Everything in the island has had its movement changed, whether it
+ * moved this tick or not, so they all need updates.  Other islands'
+ * workers may be writing to the same chunks, so the setters can wait
+ * on each other, but never on anything we're waiting for.
+ */
+void MotionPool::resolve(GameObject *lead)
+{
+    ContactIslands::island& island
+        = this->touching[this->touching.island_of(lead)];
+    std::vector<glm::dvec3> was;
+
+    for (auto go : island.members)
+        was.push_back(go->get_position());
+    this->touching.solve(this->touching.island_of(lead));
+    for (size_t i = 0; i < island.members.size(); ++i)
+        this->relocate(zone->sector_at(was[i]),
+                       island.members[i], was[i]);
+
+    {
+        std::scoped_lock lock(this->tick_lock);
+
+        this->changed.insert(this->changed.end(),
+                             island.members.begin(), island.members.end());
     }
-    return false;
+    this->done(lead, false);
 }
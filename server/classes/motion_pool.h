@@ -22,26 +22,131 @@
  * This file contains the motion thread pool, a pretty thin wrapper
  * around the ThreadPool, to simplify the interface and allow
  * reasonable testing.
+ *
+ * The pool runs in one of two modes.  Running freely, a moving object
+ * goes right back onto the queue once it's been moved, and is moved
+ * again by however long it's been since the last time.  With a tick
+ * rate, nothing needs to be pushed at all; each tick moves everything
+ * which is moving exactly once, by a fixed timestep, all together out
+ * of the motion state, and then the workers sort out whatever ran
+ * into something.  Everything which changed goes to the update pool
+ * all together.
+ *
+ * Collisions in tick mode go in two rounds.  First the workers find
+ * everything that each moved object is touching, without changing
+ * anything.  Then the contacts get grouped into islands, and each
+ * island goes to a worker to be resolved all by itself.  No two
+ * islands share an object, but they can still share a motion state
+ * chunk, or an octree node, so two workers may briefly wait on the
+ * same chunk's lock while they each write their own objects.  That
+ * only ever costs time; since each island goes in the same order
+ * every time, so does the whole tick.
+ *
+ * A sector with a sweep-and-prune broadphase doesn't look for its
+ * contacts one object at a time; one worker sweeps the whole sector
+ * once, for every pair with something in it that moved.
+ *
+ * Running freely, an object is only ever in the queue once.  Pushing
+ * it again while it's waiting, or while a worker has it, is counted
+ * and dropped; when the worker's done with it, it goes back on the
+ * queue if it's still moving.  That way two workers can never move
+ * the same object at the same time.
+ *
+ * In tick mode, there can also be gravity.  Before anything moves,
+ * everything gets pulled on by everything else, for one timestep,
+ * with the given gravitational constant and opening angle.  A
+ * constant of zero means no gravity at all.  The pulls are worked out
+ * in blocks, by the same workers, with the ticker pitching in.
+ *
+ * A tick mode pool which isn't paced has no ticker of its own; the
+ * replay calls tick() itself, as fast as it can.
+ *
+ * Either way, we keep count of how much we've moved, how many updates
+ * we've sent, and how many pushes we've dropped, and in tick mode,
+ * how busy the ticks have kept us.
  */
 
 #ifndef __INC_MOTION_POOL_H__
 #define __INC_MOTION_POOL_H__
 
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
 #include "thread_pool.h"
+#include "contact_islands.h"
 #include "game_obj.h"
-#include "octree.h"
+#include "spatial_index.h"
 
 class MotionPool : public ThreadPool<GameObject *>
 {
   public:
-    MotionPool(const char *, unsigned int);
+    static const size_t HANDOFF_BATCH;
+
+    unsigned int tick_rate;
+    double timestep, gravity, opening_angle;
+
+    /* Unpaced, there's no ticker; whoever calls tick() decides how
+     * fast the ticks come.
+     */
+    bool paced;
+
+    /* Ticks which ran past the start of the next one count as
+     * overruns, and busy is the time spent inside ticks.
+     */
+    std::atomic<uint64_t> moves, updates, ticks, overruns, duplicates;
+    std::atomic<uint64_t> contacts, islands, pulls;
+    std::atomic<uint64_t> busy_usec;
+
+  private:
+    std::chrono::steady_clock::time_point started;
+
+    std::thread ticker;
+    std::mutex tick_lock;
+    std::condition_variable tick_wake, tick_done;
+    SpatialIndex::object_list_t changed;
+    std::map<SpatialIndex *, SpatialIndex::object_list_t> sweeps;
+    ContactIslands touching;
+    size_t outstanding;
+    bool solving, tick_exit;
+
+    /* Gravity's blocks of pulls, which the workers help with */
+    const std::function<void(size_t)> *job;
+    size_t job_count;
+    std::atomic<size_t> next_job;
+    bool pulling;
+
+    void hand_off(SpatialIndex::object_list_t&);
+    void relocate(SpatialIndex *, GameObject *, const glm::dvec3&);
+    void find_contacts(SpatialIndex *, GameObject *);
+    void find_pairs(SpatialIndex *, SpatialIndex::object_list_t&);
+    void resolve(GameObject *);
+    void finish(SpatialIndex *, GameObject *);
+    void release(GameObject *);
+    void done(GameObject *, bool);
+    void work_jobs(void);
+    void spread(size_t, const std::function<void(size_t)>&);
+    void run_ticks(void);
+
+  public:
+    MotionPool(const char *, unsigned int, unsigned int = 0);
     ~MotionPool();
 
     void start(void);
+    void stop(void);
+    void push(GameObject *&) override;
+    void tick(void);
+    std::string report(void);
 
     static void motion_pool_worker(void *);
 
-    bool collide(Octree *, GameObject *);
+    bool collide(SpatialIndex *, GameObject *);
 };
 
 #endif /* __INC_MOTION_POOL_H__ */
@@ -0,0 +1,543 @@
+/* motion_state.cc
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * The implementation of the motion state.
+ *
+ * Turning the movement vector by the orientation is spelled out by
+ * hand, in the same order of operations as glm does it, so the AVX2
+ * and scalar versions - and moving a single object - all come out
+ * the same, down to the last bit.  We don't ask for FMA, since fusing
+ * the multiplies and adds would change the rounding.
+ *
+ * Things to do
+ *
+ */
+
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MOTION_STATE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#include "motion_state.h"
+
+std::atomic<MotionState::chunk *> MotionState::chunks[MotionState::MAX_CHUNKS];
+std::atomic<size_t> MotionState::chunk_count(0);
+std::mutex MotionState::alloc_lock;
+std::vector<std::pair<MotionState::chunk *, int> > MotionState::free_slots;
+int MotionState::next_slot = 0;
+std::atomic<bool> MotionState::simd(MotionState::have_simd());
+
+/* Slower than a centimeter and a hundredth of a radian a second, for
+ * a whole second, and we're done.
+ */
+double MotionState::sleep_speed = 0.01;
+double MotionState::sleep_spin = 0.01;
+double MotionState::sleep_after = 1.0;
+
+MotionState::chunk::chunk()
+    : lock(), seq(0)
+{
+    this->movers = this->spinners = 0;
+    for (int i = 0; i < CHUNK_SLOTS; ++i)
+    {
+        this->moving[i] = 0;
+        this->spinning[i] = false;
+        this->clear(i, NULL);
+    }
+}
+
+void MotionState::chunk::begin_write(void)
+{
+    this->seq.store(this->seq.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void MotionState::chunk::end_write(void)
+{
+    this->seq.store(this->seq.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+}
+
+void MotionState::chunk::clear(int i, GameObject *go)
+{
+    this->px[i] = this->py[i] = this->pz[i] = 0.0;
+    this->lx[i] = this->ly[i] = this->lz[i] = 0.0;
+    this->mx[i] = this->my[i] = this->mz[i] = 0.0;
+    this->ow[i] = 1.0;
+    this->ox[i] = this->oy[i] = this->oz[i] = 0.0;
+    this->wx[i] = this->wy[i] = this->wz[i] = 0.0;
+    this->driven[i] = false;
+    this->asleep[i] = false;
+    this->update(i, false);
+    this->owner[i] = go;
+}
+
+/* Work out again whether an object is moving or rotating, once its
+ * movement, rotation, or activity has changed.
+ */
+void MotionState::chunk::update(int i, bool active)
+{
+    bool spins = active && (this->wx[i] != 0.0 || this->wy[i] != 0.0
+                            || this->wz[i] != 0.0);
+    bool moves = spins || (active && (this->mx[i] != 0.0
+                                      || this->my[i] != 0.0
+                                      || this->mz[i] != 0.0));
+
+    this->spinners += (int)spins - (int)this->spinning[i];
+    this->movers += (int)moves - (int)(this->moving[i] != 0);
+    this->spinning[i] = spins;
+    this->moving[i] = (moves ? ~0ULL : 0ULL);
+    this->asleep[i] = this->asleep[i] && !moves;
+    this->calm[i] = 0.0;
+}
+
+/* Add to the movement, without starting a new path or counting as a
+ * wake-up unless it's enough to matter.  Something asleep stays that
+ * way if the nudge is slower than the sleep speed, and something
+ * already moving keeps counting its calm, so a steady gentle pull
+ * can't keep everything awake forever.  Returns whether we changed
+ * anything.
+ */
+bool MotionState::chunk::accelerate(int i, const glm::dvec3& dv, bool active)
+{
+    double speed2 = dv.x * dv.x + dv.y * dv.y + dv.z * dv.z;
+
+    if (this->asleep[i]
+        && speed2 < MotionState::sleep_speed * MotionState::sleep_speed)
+        return false;
+    this->mx[i] += dv.x;
+    this->my[i] += dv.y;
+    this->mz[i] += dv.z;
+    if (this->moving[i] == 0 || (this->mx[i] == 0.0 && this->my[i] == 0.0
+                                 && this->mz[i] == 0.0))
+        this->update(i, active);
+    return true;
+}
+
+/* Count up how long a moving object has been too slow to matter, and
+ * put it to sleep once it's been long enough, unless an action is
+ * what's moving it.
+ */
+void MotionState::chunk::settle(int i, double interval)
+{
+    double speed2 = this->mx[i] * this->mx[i] + this->my[i] * this->my[i]
+        + this->mz[i] * this->mz[i];
+    double spin2 = this->wx[i] * this->wx[i] + this->wy[i] * this->wy[i]
+        + this->wz[i] * this->wz[i];
+
+    if (this->driven[i]
+        || speed2 > MotionState::sleep_speed * MotionState::sleep_speed
+        || spin2 > MotionState::sleep_spin * MotionState::sleep_spin)
+    {
+        this->calm[i] = 0.0;
+        return;
+    }
+    if ((this->calm[i] += interval) < MotionState::sleep_after)
+        return;
+    this->mx[i] = this->my[i] = this->mz[i] = 0.0;
+    this->wx[i] = this->wy[i] = this->wz[i] = 0.0;
+    this->update(i, true);
+    this->asleep[i] = true;
+}
+
+/* Below this squared half-angle, the series are good to the last
+ * few bits of a double.
+ */
+#define SERIES_LIMIT  0.01
+
+/* The exponential of the pure quaternion (0, h), which is the turn
+ * by twice the length of h, about h.
+ */
+static inline void exp_map(double hx, double hy, double hz,
+                           double& w, double& x, double& y, double& z)
+{
+    double t2 = hx * hx + hy * hy + hz * hz, s;
+
+    if (t2 < SERIES_LIMIT)
+    {
+        w = 1.0 - t2 / 2.0 * (1.0 - t2 / 12.0
+                              * (1.0 - t2 / 30.0 * (1.0 - t2 / 56.0)));
+        s = 1.0 - t2 / 6.0 * (1.0 - t2 / 20.0
+                              * (1.0 - t2 / 42.0 * (1.0 - t2 / 72.0)));
+    }
+    else
+    {
+        double t = sqrt(t2);
+
+        w = cos(t);
+        s = sin(t) / t;
+    }
+    x = hx * s;
+    y = hy * s;
+    z = hz * s;
+}
+
+/* Turn the orientation by the spin over the interval.  One step of
+ * Newton's method keeps it at unit length, without a square root.
+ */
+static inline void turn(MotionState::chunk *c, int i, double interval)
+{
+    double h = interval / 2.0, dw, dx, dy, dz, w, x, y, z, n;
+
+    exp_map(c->wx[i] * h, c->wy[i] * h, c->wz[i] * h, dw, dx, dy, dz);
+    w = dw * c->ow[i] - dx * c->ox[i] - dy * c->oy[i] - dz * c->oz[i];
+    x = dw * c->ox[i] + dx * c->ow[i] + dy * c->oz[i] - dz * c->oy[i];
+    y = dw * c->oy[i] + dy * c->ow[i] + dz * c->ox[i] - dx * c->oz[i];
+    z = dw * c->oz[i] + dz * c->ow[i] + dx * c->oy[i] - dy * c->ox[i];
+    n = (3.0 - (w * w + x * x + y * y + z * z)) / 2.0;
+    c->ow[i] = w * n;
+    c->ox[i] = x * n;
+    c->oy[i] = y * n;
+    c->oz[i] = z * n;
+}
+
+/* Move along the movement vector, turned by the orientation */
+static inline void move(MotionState::chunk *c, int i, double interval)
+{
+    double uvx = c->oy[i] * c->mz[i] - c->oz[i] * c->my[i];
+    double uvy = c->oz[i] * c->mx[i] - c->ox[i] * c->mz[i];
+    double uvz = c->ox[i] * c->my[i] - c->oy[i] * c->mx[i];
+    double uuvx = c->oy[i] * uvz - c->oz[i] * uvy;
+    double uuvy = c->oz[i] * uvx - c->ox[i] * uvz;
+    double uuvz = c->ox[i] * uvy - c->oy[i] * uvx;
+
+    c->px[i] += (c->mx[i] + ((uvx * c->ow[i]) + uuvx) * 2.0) * interval;
+    c->py[i] += (c->my[i] + ((uvy * c->ow[i]) + uuvy) * 2.0) * interval;
+    c->pz[i] += (c->mz[i] + ((uvz * c->ow[i]) + uuvz) * 2.0) * interval;
+}
+
+/* Move a single object, the same way a whole chunk is moved */
+void MotionState::chunk::advance(int i, double interval)
+{
+    this->lx[i] = this->px[i];
+    this->ly[i] = this->py[i];
+    this->lz[i] = this->pz[i];
+    if (this->spinning[i])
+        turn(this, i, interval);
+    if (this->moving[i])
+    {
+        move(this, i, interval);
+        this->settle(i, interval);
+    }
+}
+
+glm::dvec3 MotionState::chunk::get_position(int i) const
+{
+    return glm::dvec3(this->px[i], this->py[i], this->pz[i]);
+}
+
+void MotionState::chunk::set_position(int i, const glm::dvec3& p)
+{
+    this->px[i] = p.x;
+    this->py[i] = p.y;
+    this->pz[i] = p.z;
+}
+
+glm::dvec3 MotionState::chunk::get_last_position(int i) const
+{
+    return glm::dvec3(this->lx[i], this->ly[i], this->lz[i]);
+}
+
+void MotionState::chunk::set_last_position(int i, const glm::dvec3& p)
+{
+    this->lx[i] = p.x;
+    this->ly[i] = p.y;
+    this->lz[i] = p.z;
+}
+
+glm::dvec3 MotionState::chunk::get_movement(int i) const
+{
+    return glm::dvec3(this->mx[i], this->my[i], this->mz[i]);
+}
+
+void MotionState::chunk::set_movement(int i, const glm::dvec3& m)
+{
+    this->mx[i] = m.x;
+    this->my[i] = m.y;
+    this->mz[i] = m.z;
+}
+
+glm::dquat MotionState::chunk::get_orientation(int i) const
+{
+    return glm::dquat(this->ow[i], this->ox[i], this->oy[i], this->oz[i]);
+}
+
+void MotionState::chunk::set_orientation(int i, const glm::dquat& o)
+{
+    this->ow[i] = o.w;
+    this->ox[i] = o.x;
+    this->oy[i] = o.y;
+    this->oz[i] = o.z;
+}
+
+glm::dvec3 MotionState::chunk::get_rotation(int i) const
+{
+    return glm::dvec3(this->wx[i], this->wy[i], this->wz[i]);
+}
+
+void MotionState::chunk::set_rotation(int i, const glm::dvec3& r)
+{
+    this->wx[i] = r.x;
+    this->wy[i] = r.y;
+    this->wz[i] = r.z;
+}
+
+void MotionState::chunk::set_driven(int i, bool d)
+{
+    this->driven[i] = d;
+}
+
+bool MotionState::chunk::is_driven(int i) const
+{
+    return this->driven[i];
+}
+
+bool MotionState::chunk::is_asleep(int i) const
+{
+    return this->asleep[i];
+}
+
+double MotionState::chunk::get_calm(int i) const
+{
+    return this->calm[i];
+}
+
+/* Only for putting back what a snapshot saw; after update() has run */
+void MotionState::chunk::set_rest(int i, bool a, double c)
+{
+    this->asleep[i] = a;
+    this->calm[i] = c;
+}
+
+bool MotionState::chunk::is_moving(int i) const
+{
+    return this->moving[i] != 0;
+}
+
+MotionState::writer::writer(MotionState::chunk *ch)
+    : lock(ch->lock)
+{
+    this->c = ch;
+    this->c->begin_write();
+}
+
+MotionState::writer::~writer()
+{
+    this->c->end_write();
+}
+
+/* Slots which have been given back get used again first */
+MotionState::chunk *MotionState::allocate(GameObject *go, int& slot)
+{
+    chunk *c;
+
+    {
+        std::scoped_lock lock(MotionState::alloc_lock);
+
+        if (!MotionState::free_slots.empty())
+        {
+            c = MotionState::free_slots.back().first;
+            slot = MotionState::free_slots.back().second;
+            MotionState::free_slots.pop_back();
+        }
+        else
+        {
+            size_t count = MotionState::chunk_count.load(
+                std::memory_order_relaxed);
+
+            if (count == 0 || MotionState::next_slot == CHUNK_SLOTS)
+            {
+                if (count == MAX_CHUNKS)
+                    throw std::runtime_error("too many game objects");
+                MotionState::chunks[count].store(new chunk,
+                                                 std::memory_order_release);
+                MotionState::chunk_count.store(++count,
+                                               std::memory_order_release);
+                MotionState::next_slot = 0;
+            }
+            c = MotionState::chunks[count - 1].load(
+                std::memory_order_relaxed);
+            slot = MotionState::next_slot++;
+        }
+    }
+
+    MotionState::writer guard(c);
+    c->clear(slot, go);
+    return c;
+}
+
+void MotionState::release(MotionState::chunk *c, int slot)
+{
+    {
+        MotionState::writer guard(c);
+        c->clear(slot, NULL);
+    }
+    std::scoped_lock lock(MotionState::alloc_lock);
+    MotionState::free_slots.push_back(std::make_pair(c, slot));
+}
+
+bool MotionState::have_simd(void)
+{
+#ifdef MOTION_STATE_AVX2
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif /* MOTION_STATE_AVX2 */
+}
+
+/* The slowest speed and spin, in radians, per second, which keep an
+ * object awake, and how many seconds it can spend slower than that.
+ * With thresholds of zero, nothing ever goes to sleep.
+ */
+void MotionState::set_sleep(double speed, double spin, double after)
+{
+    MotionState::sleep_speed = speed;
+    MotionState::sleep_spin = spin;
+    MotionState::sleep_after = after;
+}
+
+/* How far a spin turns things over the interval */
+glm::dquat MotionState::turn_by(const glm::dvec3& spin, double interval)
+{
+    glm::dquat q;
+
+    exp_map(spin.x * interval / 2.0, spin.y * interval / 2.0,
+            spin.z * interval / 2.0, q.w, q.x, q.y, q.z);
+    return q;
+}
+
+/* Mostly so the two ways can be compared; we can't turn on what the
+ * processor doesn't have.
+ */
+bool MotionState::use_simd(bool want)
+{
+    MotionState::simd = want && MotionState::have_simd();
+    return MotionState::simd;
+}
+
+void MotionState::spin(MotionState::chunk *c, double interval)
+{
+    for (int i = 0; i < CHUNK_SLOTS; ++i)
+        if (c->spinning[i])
+            turn(c, i, interval);
+}
+
+void MotionState::step_scalar(MotionState::chunk *c, double interval)
+{
+    for (int i = 0; i < CHUNK_SLOTS; ++i)
+    {
+        c->lx[i] = c->px[i];
+        c->ly[i] = c->py[i];
+        c->lz[i] = c->pz[i];
+        if (c->moving[i])
+            move(c, i, interval);
+    }
+}
+
+#ifdef MOTION_STATE_AVX2
+/* Four objects at a time; anything which isn't moving is masked down
+ * to a step of zero.
+ */
+__attribute__((target("avx2")))
+void MotionState::step_avx2(MotionState::chunk *c, double interval)
+{
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256d dt = _mm256_set1_pd(interval);
+
+    for (int i = 0; i < CHUNK_SLOTS; i += 4)
+    {
+        __m256d px = _mm256_load_pd(c->px + i);
+        __m256d py = _mm256_load_pd(c->py + i);
+        __m256d pz = _mm256_load_pd(c->pz + i);
+        __m256d mx = _mm256_load_pd(c->mx + i);
+        __m256d my = _mm256_load_pd(c->my + i);
+        __m256d mz = _mm256_load_pd(c->mz + i);
+        __m256d ow = _mm256_load_pd(c->ow + i);
+        __m256d ox = _mm256_load_pd(c->ox + i);
+        __m256d oy = _mm256_load_pd(c->oy + i);
+        __m256d oz = _mm256_load_pd(c->oz + i);
+        __m256d mask = _mm256_load_pd((const double *)(c->moving + i));
+        __m256d uvx, uvy, uvz, uuvx, uuvy, uuvz, vx, vy, vz;
+
+        _mm256_store_pd(c->lx + i, px);
+        _mm256_store_pd(c->ly + i, py);
+        _mm256_store_pd(c->lz + i, pz);
+
+        uvx = _mm256_sub_pd(_mm256_mul_pd(oy, mz), _mm256_mul_pd(oz, my));
+        uvy = _mm256_sub_pd(_mm256_mul_pd(oz, mx), _mm256_mul_pd(ox, mz));
+        uvz = _mm256_sub_pd(_mm256_mul_pd(ox, my), _mm256_mul_pd(oy, mx));
+        uuvx = _mm256_sub_pd(_mm256_mul_pd(oy, uvz), _mm256_mul_pd(oz, uvy));
+        uuvy = _mm256_sub_pd(_mm256_mul_pd(oz, uvx), _mm256_mul_pd(ox, uvz));
+        uuvz = _mm256_sub_pd(_mm256_mul_pd(ox, uvy), _mm256_mul_pd(oy, uvx));
+        vx = _mm256_add_pd(mx, _mm256_mul_pd(
+                               _mm256_add_pd(_mm256_mul_pd(uvx, ow), uuvx),
+                               two));
+        vy = _mm256_add_pd(my, _mm256_mul_pd(
+                               _mm256_add_pd(_mm256_mul_pd(uvy, ow), uuvy),
+                               two));
+        vz = _mm256_add_pd(mz, _mm256_mul_pd(
+                               _mm256_add_pd(_mm256_mul_pd(uvz, ow), uuvz),
+                               two));
+        vx = _mm256_and_pd(_mm256_mul_pd(vx, dt), mask);
+        vy = _mm256_and_pd(_mm256_mul_pd(vy, dt), mask);
+        vz = _mm256_and_pd(_mm256_mul_pd(vz, dt), mask);
+
+        _mm256_store_pd(c->px + i, _mm256_add_pd(px, vx));
+        _mm256_store_pd(c->py + i, _mm256_add_pd(py, vy));
+        _mm256_store_pd(c->pz + i, _mm256_add_pd(pz, vz));
+    }
+}
+#endif /* MOTION_STATE_AVX2 */
+
+/* Integrate one chunk, and say which objects moved, and from where */
+size_t MotionState::step(MotionState::chunk *c,
+                         double interval,
+                         MotionState::moved_t *out)
+{
+    std::unique_lock lock(c->lock);
+    size_t n = 0;
+
+    if (c->movers == 0)
+        return 0;
+    c->begin_write();
+    for (int i = 0; i < CHUNK_SLOTS; ++i)
+        if (c->moving[i])
+            out[n++] = std::make_pair(c->owner[i], c->get_position(i));
+
+    if (c->spinners > 0)
+        MotionState::spin(c, interval);
+#ifdef MOTION_STATE_AVX2
+    if (MotionState::simd.load(std::memory_order_relaxed))
+        MotionState::step_avx2(c, interval);
+    else
+#endif /* MOTION_STATE_AVX2 */
+        MotionState::step_scalar(c, interval);
+    for (int i = 0; i < CHUNK_SLOTS; ++i)
+        if (c->moving[i])
+            c->settle(i, interval);
+    c->end_write();
+    return n;
+}
@@ -0,0 +1,231 @@
+/* motion_state.h                                          -*- C++ -*-
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * This file contains the declaration of the motion state, which
+ * holds where every game object is, where it's going, and how it's
+ * turned, all together in one place.
+ *
+ * Objects are given a slot in a chunk, and each chunk keeps each
+ * piece of its objects' state in its own array, so moving a whole
+ * chunk of objects at once is a straight walk down a handful of
+ * arrays, a few objects at a time.  Chunks are never moved or freed,
+ * so an object can hang on to its chunk for as long as it lives.
+ *
+ * Each chunk has one lock, which writers hold, and a sequence number
+ * which they bump once before they change anything and once after.
+ * Readers never take the lock, or write anything at all; they read
+ * the sequence number, read what they want, and read the sequence
+ * number again, and if a writer got in while they were reading, they
+ * just go around again.  An odd number means a writer is busy.
+ *
+ * The chunk also knows which of its objects are moving, and how many,
+ * so integrating can skip right past chunks where nothing is.
+ * Positions are moved four at a time with AVX2, if the processor has
+ * it, and one at a time otherwise; either way gives exactly the same
+ * answer.  Anything which is rotating has its orientation turned
+ * first, one at a time.
+ *
+ * Rotation is kept as a spin:  a vector along the axis of rotation,
+ * as long as the number of radians per second it turns.  Each step
+ * turns the orientation by the exponential of half the spin times
+ * the interval, which for the small turns of a single tick is a
+ * short series with no trig at all, and then nudges the orientation
+ * back to unit length, so it never drifts.
+ *
+ * Something which has been moving or turning slower than the sleep
+ * thresholds for long enough is put to sleep:  its movement and
+ * rotation are dropped, so it stops being moved at all, and stops
+ * sending out updates.  Anything which gives it a movement or
+ * rotation again, like something running into it, wakes it up.
+ * Something which is being driven by an action, like a player
+ * creeping along, is never put to sleep; the thresholds come from
+ * the SleepSpeed, SleepSpin, and SleepAfter config options.
+ *
+ * Things to do
+ *
+ */
+
+#ifndef __INC_MOTION_STATE_H__
+#define __INC_MOTION_STATE_H__
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+class GameObject;
+
+class MotionState
+{
+  public:
+    static const int CHUNK_SLOTS = 256;
+    static const size_t MAX_CHUNKS = 65536;
+
+    typedef std::pair<GameObject *, glm::dvec3> moved_t;
+
+    class chunk
+    {
+      public:
+        std::mutex lock;
+        std::atomic<uint64_t> seq;
+
+        /* Position, where the last move started, movement, the
+         * orientation quaternion, and the spin.
+         */
+        alignas(32) double px[CHUNK_SLOTS], py[CHUNK_SLOTS], pz[CHUNK_SLOTS];
+        alignas(32) double lx[CHUNK_SLOTS], ly[CHUNK_SLOTS], lz[CHUNK_SLOTS];
+        alignas(32) double mx[CHUNK_SLOTS], my[CHUNK_SLOTS], mz[CHUNK_SLOTS];
+        alignas(32) double ow[CHUNK_SLOTS], ox[CHUNK_SLOTS];
+        alignas(32) double oy[CHUNK_SLOTS], oz[CHUNK_SLOTS];
+        alignas(32) double wx[CHUNK_SLOTS], wy[CHUNK_SLOTS], wz[CHUNK_SLOTS];
+
+        /* All ones for a moving object, so it can mask off the rest */
+        alignas(32) uint64_t moving[CHUNK_SLOTS];
+        bool spinning[CHUNK_SLOTS];
+
+        /* Whether an action set the movement, so it's never put to
+         * sleep, however slowly it's going.
+         */
+        bool driven[CHUNK_SLOTS];
+
+        /* Whether we put it to sleep, until something wakes it */
+        bool asleep[CHUNK_SLOTS];
+        double calm[CHUNK_SLOTS];
+        GameObject *owner[CHUNK_SLOTS];
+        int movers, spinners;
+
+        chunk();
+
+        template <typename F>
+        void read(F&& f) const
+            {
+                uint64_t before;
+
+                for (;;)
+                {
+                    before = this->seq.load(std::memory_order_acquire);
+                    if ((before & 1) == 0)
+                    {
+                        f();
+                        std::atomic_thread_fence(std::memory_order_acquire);
+                        if (this->seq.load(std::memory_order_relaxed)
+                            == before)
+                            return;
+                    }
+                    std::this_thread::yield();
+                }
+            };
+
+        /* The caller must hold our lock for all of these; the getters
+         * can also be used inside a read.
+         */
+        void begin_write(void);
+        void end_write(void);
+        void clear(int, GameObject *);
+        void update(int, bool);
+        void settle(int, double);
+        bool accelerate(int, const glm::dvec3&, bool);
+        void advance(int, double);
+
+        glm::dvec3 get_position(int) const;
+        void set_position(int, const glm::dvec3&);
+        glm::dvec3 get_last_position(int) const;
+        void set_last_position(int, const glm::dvec3&);
+        glm::dvec3 get_movement(int) const;
+        void set_movement(int, const glm::dvec3&);
+        glm::dquat get_orientation(int) const;
+        void set_orientation(int, const glm::dquat&);
+        glm::dvec3 get_rotation(int) const;
+        void set_rotation(int, const glm::dvec3&);
+        void set_driven(int, bool);
+        bool is_driven(int) const;
+        bool is_asleep(int) const;
+        double get_calm(int) const;
+        void set_rest(int, bool, double);
+        bool is_moving(int) const;
+    };
+
+    /* Hold one of these for as long as we're changing a chunk */
+    class writer
+    {
+      private:
+        chunk *c;
+        std::unique_lock<std::mutex> lock;
+
+      public:
+        writer(chunk *);
+        ~writer();
+    };
+
+  private:
+    static std::atomic<chunk *> chunks[MAX_CHUNKS];
+    static std::atomic<size_t> chunk_count;
+    static std::mutex alloc_lock;
+    static std::vector<std::pair<chunk *, int> > free_slots;
+    static int next_slot;
+    static std::atomic<bool> simd;
+
+    static double sleep_speed, sleep_spin, sleep_after;
+
+    static void spin(chunk *, double);
+    static void step_scalar(chunk *, double);
+    static void step_avx2(chunk *, double);
+    static size_t step(chunk *, double, moved_t *);
+
+  public:
+    static chunk *allocate(GameObject *, int&);
+    static void release(chunk *, int);
+
+    static bool have_simd(void);
+    static bool use_simd(bool);
+    static void set_sleep(double, double, double);
+    static glm::dquat turn_by(const glm::dvec3&, double);
+
+    /* Move everything that's moving by the interval.  Once each
+     * chunk is done, and unlocked, the callback gets each object
+     * which moved, along with where it moved from.
+     */
+    template <typename F>
+    static size_t integrate(double interval, F&& moved)
+        {
+            moved_t out[CHUNK_SLOTS];
+            size_t count = MotionState::chunk_count.load(
+                std::memory_order_acquire), total = 0, n;
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                n = MotionState::step(MotionState::chunks[i].load(
+                                          std::memory_order_acquire),
+                                      interval, out);
+                for (size_t j = 0; j < n; ++j)
+                    moved(out[j].first, out[j].second);
+                total += n;
+            }
+            return total;
+        };
+};
+
+#endif /* __INC_MOTION_STATE_H__ */
@@ -22,12 +22,23 @@
  * The implementation of octree functions.
  *
  * Since this is a multi-level data structure, and each subtree can
- * function as a distinct tree on its own, we will keep track of all
- * the objects contained in each subtree, in every node in the
- * subtree.  That way, any node in the tree can be queried as to what
- * it contains, without having to start at the head, or traverse to
- * each leaf.  This may cause some consternation when moving an object
- * around in the tree, so we may need to revisit this at some point.
+ * function as a distinct tree on its own, any node in the tree can
+ * be queried as to what it contains.  We used to keep a set of every
+ * object in a subtree at every level, which made those queries cheap,
+ * but cost a set insert per level on every insert, and a lot of
+ * memory.  Now each object is only kept in the node where it stops,
+ * and interior nodes just count what they've got underneath, so a
+ * subtree query has to walk down to the leaves.
+ *
+ * A build only creates the nodes which something actually goes into.
+ * We used to fill out every node down to the minimum depth, which
+ * cost tens of thousands of nodes for each tree, whether there was
+ * anything in it or not.
+ *
+ * Since we don't know which node an object is in without looking,
+ * removals and moves follow the path that the object's position would
+ * take down the tree.  The residents of any one node are few enough
+ * that a linear search through them is cheaper than anything fancier.
  *
  * If we run into problems allocating new r/w locks in subtrees, the
  * tree will be truncated at a depth less than our max.  This is
@@ -36,28 +47,49 @@
  * excess object pairs into account.  We'll at least get logs, so we
  * can know when the truncation is happening.
  *
+ * Only writers lock anything.  A move walks down from the root under
+ * read locks, as long as the old and new positions fall into the same
+ * octant.  The first node where they diverge (or where there is no
+ * further subtree) is the lowest common ancestor, and it is the only
+ * node we write-lock up front.  From there, we insert the object
+ * along its new path and remove it along its old one; nothing above
+ * that node changes.
+ *
+ * Nodes and resident arrays come from, and go back to, the tree's
+ * node pool, by way of limbo.  A recycled array keeps its storage, so
+ * changing a leaf usually doesn't need to allocate anything at all.
+ * The pool has its own lock, since inserts and removals in different
+ * parts of the tree can be going on at the same time.
+ *
  * Things to do
- *   - Consider how we would do a move operation.  As things stand
- *     right now, we need to do an remove/insert pair, which may
- *     involve a bunch of possibly unnecessary memory deallocation and
- *     allocation.  There are a lot of specific cases to consider, and
- *     my first attempt was not good.
  *
  */
 
-#include <string.h>
 #include <errno.h>
 
+#include <algorithm>
 #include <string>
 #include <mutex>
 #include <system_error>
 
+#include <glm/common.hpp>
+
 #include "octree.h"
 #include "log.h"
 
 const int Octree::MAX_LEAF_OBJECTS = 3;
+const int Octree::MERGE_LEAF_OBJECTS = 1;
+const int Octree::MAX_SPARE_NODES = 1024;
 const int Octree::MIN_DEPTH = 5;
 const int Octree::MAX_DEPTH = 10;
+const int Octree::DEPTH_LIMIT = 20;
+
+#ifdef OCTREE_LOCK_COUNT
+thread_local uint64_t Octree::lock_count = 0;
+#define COUNT_LOCK()  ++Octree::lock_count
+#else
+#define COUNT_LOCK()
+#endif
 
 /* Orientation of octants:
 
@@ -116,108 +148,515 @@ glm::dvec3 Octree::octant_max(int oct)
     return mx;
 }
 
+/* Whether an object's bounding sphere fits into one of our octants.
+ * Without any looseness, everything fits everywhere.
+ */
+bool Octree::fits(GameObject *gobj)
+{
+    glm::dvec3 half = (this->max_point - this->min_point) * 0.25;
+
+    if (this->looseness <= 1.0)
+        return true;
+    return gobj->geometry->radius
+        <= (this->looseness - 1.0) * std::min({half.x, half.y, half.z});
+}
+
+/* Squared distance from a point to our (possibly loose) bounds;
+ * zero if the point is inside.
+ */
+double Octree::distance2(const glm::dvec3& pt)
+{
+    glm::dvec3 half = (this->max_point - this->min_point)
+        * 0.5 * std::max(this->looseness, 1.0);
+    glm::dvec3 d = glm::abs(pt - this->center_point) - half;
+
+    d = glm::max(d, glm::dvec3(0.0, 0.0, 0.0));
+    return glm::dot(d, d);
+}
+
+/* Whether a sphere touches our (possibly loose) bounds. */
+bool Octree::touches(const glm::dvec3& pt, double radius)
+{
+    return this->distance2(pt) <= radius * radius;
+}
+
+/* Whether our (possibly loose) bounds are entirely inside a sphere */
+bool Octree::within(const glm::dvec3& pt, double radius)
+{
+    glm::dvec3 half = (this->max_point - this->min_point)
+        * 0.5 * std::max(this->looseness, 1.0);
+    glm::dvec3 d = glm::abs(pt - this->center_point) + half;
+
+    return glm::dot(d, d) <= radius * radius;
+}
+
+/* Whether a ray passes through our (possibly loose) bounds, padded
+ * by the given amount, and how far along it gets before it does.
+ */
+bool Octree::crossed_by(const SpatialIndex::ray& r, double pad, double& dist)
+{
+    glm::dvec3 half = (this->max_point - this->min_point)
+        * 0.5 * std::max(this->looseness, 1.0) + pad;
+
+    return r.enters(this->center_point - half, this->center_point + half,
+                    dist);
+}
+
+bool Octree::is_resident(GameObject *gobj)
+{
+    Octree::object_list_t *list
+        = this->residents.load(std::memory_order_acquire);
+
+    return std::find(list->begin(), list->end(), gobj) != list->end();
+}
+
+/* A writable copy of our residents.  The caller must hold our write
+ * lock, and hand the copy to set_residents when it's done with it.
+ */
+Octree::object_list_t *Octree::copy_residents(void)
+{
+    Octree::object_list_t *list = this->pool->get_list();
+    Octree::object_list_t *current
+        = this->residents.load(std::memory_order_relaxed);
+
+    list->assign(current->begin(), current->end());
+    return list;
+}
+
+/* Publish a new resident array.  Readers might still be looking at
+ * the old one, so it has to wait in limbo before it's reused.
+ */
+void Octree::set_residents(Octree::object_list_t *list)
+{
+    this->pool->retire(this->residents.exchange(list,
+                                                std::memory_order_acq_rel));
+}
+
+bool Octree::add_resident(GameObject *gobj)
+{
+    Octree::object_list_t *list = this->copy_residents();
+
+    list->push_back(gobj);
+    this->set_residents(list);
+    return true;
+}
+
+bool Octree::remove_resident(GameObject *gobj)
+{
+    Octree::object_list_t *current
+        = this->residents.load(std::memory_order_relaxed);
+    Octree::object_list_t *list;
+    auto found = std::find(current->begin(), current->end(), gobj);
+
+    if (found == current->end())
+        return false;
+    list = this->pool->get_list();
+    list->reserve(current->size() - 1);
+    list->insert(list->end(), current->begin(), found);
+    list->insert(list->end(), found + 1, current->end());
+    this->set_residents(list);
+    return true;
+}
+
+Octree::node_pool::node_pool()
+    : lock(), spare(), spare_lists(), limbo(), limbo_lists(),
+      created(0), reused(0), released(0),
+      last_time(std::chrono::steady_clock::now())
+{
+    this->last_total = 0;
+}
+
+/* The tree is going away, so nobody can be reading it any more */
+Octree::node_pool::~node_pool()
+{
+    for (auto i : this->spare)
+        delete i;
+    this->spare.clear();
+    for (auto& i : this->limbo)
+        delete i.second;
+    this->limbo.clear();
+    for (auto i : this->spare_lists)
+        delete i;
+    this->spare_lists.clear();
+    for (auto& i : this->limbo_lists)
+        delete i.second;
+    this->limbo_lists.clear();
+}
+
+/* Move everything which no reader can still be looking at out of
+ * limbo, so it can be reused.  Things went into limbo in the order
+ * they were stamped, so we can stop at the first one which isn't safe
+ * yet.  The caller must hold our lock.
+ */
+void Octree::node_pool::reclaim(void)
+{
+    uint64_t oldest = Epoch::oldest();
+
+    while (!this->limbo.empty()
+           && Epoch::safe(this->limbo.front().first, oldest))
+    {
+        if (this->spare.size() < (size_t)Octree::MAX_SPARE_NODES)
+            this->spare.push_back(this->limbo.front().second);
+        else
+            delete this->limbo.front().second;
+        this->limbo.pop_front();
+    }
+    while (!this->limbo_lists.empty()
+           && Epoch::safe(this->limbo_lists.front().first, oldest))
+    {
+        if (this->spare_lists.size() < (size_t)Octree::MAX_SPARE_NODES)
+            this->spare_lists.push_back(this->limbo_lists.front().second);
+        else
+            delete this->limbo_lists.front().second;
+        this->limbo_lists.pop_front();
+    }
+}
+
+/* A spare node, or NULL if there aren't any */
+Octree *Octree::node_pool::get_node(void)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    Octree *node = NULL;
+
+    if (this->spare.empty() && !this->limbo.empty())
+        this->reclaim();
+    if (!this->spare.empty())
+    {
+        node = this->spare.back();
+        this->spare.pop_back();
+    }
+    return node;
+}
+
+/* An empty resident array */
+Octree::object_list_t *Octree::node_pool::get_list(void)
+{
+    std::unique_lock<std::mutex> guard(this->lock);
+    Octree::object_list_t *list;
+
+    if (this->spare_lists.empty() && !this->limbo_lists.empty())
+        this->reclaim();
+    if (this->spare_lists.empty())
+    {
+        guard.unlock();
+        return new Octree::object_list_t;
+    }
+    list = this->spare_lists.back();
+    this->spare_lists.pop_back();
+    guard.unlock();
+    list->clear();
+    return list;
+}
+
+void Octree::node_pool::retire(Octree *node)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+
+    this->limbo.push_back(std::make_pair(Epoch::now(), node));
+}
+
+void Octree::node_pool::retire(Octree::object_list_t *list)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+
+    this->limbo_lists.push_back(std::make_pair(Epoch::now(), list));
+}
+
+/* Nodes handed out per second, since the last time we were asked */
+double Octree::node_pool::allocation_rate(void)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    std::chrono::steady_clock::time_point now
+        = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - this->last_time;
+    uint64_t total = this->created + this->reused;
+    double rate = 0.0;
+
+    if (elapsed.count() > 0.0)
+        rate = (total - this->last_total) / elapsed.count();
+    this->last_total = total;
+    this->last_time = now;
+    return rate;
+}
+
+Octree::tree_shape::tree_shape()
+    : min_depth(Octree::MIN_DEPTH), max_depth(Octree::MAX_DEPTH),
+      max_leaf_objects(Octree::MAX_LEAF_OBJECTS),
+      min_limit(Octree::MIN_DEPTH), max_limit(Octree::MAX_DEPTH),
+      adaptive(false), queries(0), nodes_visited(0), objects_examined(0)
+{
+}
+
 Octree::Octree(Octree *parent,
                glm::dvec3& min,
                glm::dvec3& max,
-               uint8_t index)
-    : min_point(min), center_point((max - min) * 0.5 + min), max_point(max),
-      objects(), lock()
+               uint8_t index,
+               double loose)
+    : SpatialIndex(min, max), lock(), residents(new Octree::object_list_t)
+{
+    this->looseness = loose;
+    this->pool = NULL;
+    this->shape = NULL;
+    this->init(parent, min, max, index);
+    if (this->parent == NULL)
+    {
+        this->pool = new Octree::node_pool();
+        this->shape = new Octree::tree_shape();
+    }
+}
+
+Octree::~Octree()
+{
+    int i;
+
+    for (i = 0; i < 8; ++i)
+        if (this->octants[i] != NULL)
+            delete this->octants[i].load();
+
+    if (this->parent != NULL
+        && this->parent->octants[this->parent_index] == this)
+        this->parent->octants[this->parent_index] = NULL;
+
+    /* Allowing the vector destructor to clear itself out will delete
+     * all the things in the vector... not what we want.
+     */
+    this->residents.load()->clear();
+    delete this->residents.load();
+
+    /* Only the root owns the pool and shape; spare nodes don't have
+     * either one.
+     */
+    if (this->parent == NULL && this->pool != NULL)
+        delete this->pool;
+    if (this->parent == NULL && this->shape != NULL)
+        delete this->shape;
+}
+
+/* Set up a new or recycled node.  Children get their looseness, pool
+ * and shape from their parent.  A recycled node has been out of limbo
+ * long enough that nobody's looking at it, so we can clear it out in
+ * place.
+ */
+void Octree::init(Octree *parent,
+                  const glm::dvec3& min,
+                  const glm::dvec3& max,
+                  uint8_t index)
 {
+    this->min_point = min;
+    this->max_point = max;
+    this->center_point = (max - min) * 0.5 + min;
     this->parent = parent;
-    memset(this->octants, 0, sizeof(Octree *) * 8);
+    for (int i = 0; i < 8; ++i)
+        this->octants[i].store(NULL, std::memory_order_relaxed);
     this->parent_index = index;
+    this->count = 0;
+    this->mass = 0.0;
+    this->center_of_mass = this->center_point;
+    this->residents.load(std::memory_order_relaxed)->clear();
     if (this->parent != NULL)
+    {
         this->depth = this->parent->depth + 1;
+        this->looseness = this->parent->looseness;
+        this->pool = this->parent->pool;
+        this->shape = this->parent->shape;
+    }
     else
         this->depth = 0;
 }
 
-Octree::~Octree()
+/* Get a node for one of our octants, from the pool if there's one
+ * available.  The caller must hold our write lock, and fill the node
+ * in before putting it into our octants, where readers can see it.
+ */
+Octree *Octree::new_node(int oct)
+{
+    glm::dvec3 mn = this->octant_min(oct);
+    glm::dvec3 mx = this->octant_max(oct);
+    Octree *node = this->pool->get_node();
+
+    if (node != NULL)
+    {
+        node->init(this, mn, mx, oct);
+        ++this->pool->reused;
+    }
+    else
+    {
+        node = new Octree(this, mn, mx, oct);
+        ++this->pool->created;
+    }
+    return node;
+}
+
+/* Give this node and its subtree back to the pool.  Whatever objects
+ * were in here must already have been taken care of.  Readers might
+ * still be wandering around in here, so we only unlink things, and
+ * leave everything else as it is until the node's reused.
+ */
+void Octree::release(void)
 {
+    Octree::node_pool *p = this->pool;
+    Octree *sub;
     int i;
 
     for (i = 0; i < 8; ++i)
-        if (this->octants[i] != NULL)
-            delete this->octants[i];
+        if ((sub = this->octants[i].load(std::memory_order_relaxed)) != NULL)
+            sub->release();
 
     if (this->parent != NULL
         && this->parent->octants[this->parent_index] == this)
-        this->parent->octants[this->parent_index] = NULL;
-
-    /* Allowing the map destructor to clear itself out will delete all
-     * the things in the map... not what we want.
-     */
-    this->objects.clear();
+        this->parent->octants[this->parent_index].store(
+            NULL, std::memory_order_release);
+    this->parent = NULL;
+    this->pool = NULL;
+    this->shape = NULL;
+    this->count = 0;
+    ++p->released;
+    p->retire(this);
 }
 
-bool Octree::empty(void)
+/* Fold our subtree back into ourselves, making us a leaf.  The caller
+ * must hold our write lock.  Everything shows up here before the
+ * subtree goes away, so readers never miss anything.
+ */
+void Octree::merge(void)
 {
-    return this->objects.empty();
+    Octree::object_list_t *list = NULL;
+    Octree *sub;
+    int i;
+
+    for (i = 0; i < 8; ++i)
+        if ((sub = this->octants[i].load(std::memory_order_relaxed)) != NULL)
+        {
+            if (list == NULL)
+                list = this->copy_residents();
+            sub->gather(*list);
+        }
+    if (list == NULL)
+        return;
+    this->set_residents(list);
+    for (i = 0; i < 8; ++i)
+        if ((sub = this->octants[i].load(std::memory_order_relaxed)) != NULL)
+            sub->release();
 }
 
 void Octree::build(const std::list<GameObject *>& objs)
 {
-    Octree::object_set_t go_set;
-
-    go_set.insert(objs.begin(), objs.end());
-    this->build(go_set);
+    this->build(Octree::object_list_t(objs.begin(), objs.end()));
 }
 
 void Octree::build(const Octree::object_set_t& objs)
 {
-    Octree::object_set_t obj_list[8];
+    this->build(Octree::object_list_t(objs.begin(), objs.end()));
+}
+
+/* Nobody else may be changing this subtree while it's built, but
+ * readers can look at it while we go.  New subtrees are filled in
+ * before they're put in place.
+ */
+void Octree::build(const Octree::object_list_t& objs)
+{
+    Octree::object_list_t obj_list[8], *here = NULL;
+    Octree *sub;
     int j;
 
-    this->objects.insert(objs.begin(), objs.end());
+    if (this->broadphase != NULL)
+        this->broadphase->build(objs);
+    if (this->parent == NULL)
+        for (auto i : objs)
+            this->grow_radius(i);
+    this->count += objs.size();
 
-    if (this->depth < Octree::MAX_DEPTH
-        && (this->depth < Octree::MIN_DEPTH
-            || objs.size() > Octree::MAX_LEAF_OBJECTS))
+    if (this->depth < this->shape->max_depth
+        && (this->depth < this->shape->min_depth
+            || objs.size() > (size_t)this->shape->max_leaf_objects))
     {
-        for (auto i = objs.begin(); i != objs.end(); ++i)
-            obj_list[this->which_octant((*i)->get_position())].insert(*i);
+        for (auto i : objs)
+            if (this->fits(i))
+                obj_list[this->which_octant(i->get_position())].push_back(i);
+            else
+            {
+                if (here == NULL)
+                    here = this->copy_residents();
+                here->push_back(i);
+            }
 
         for (j = 0; j < 8; ++j)
         {
-            if (!obj_list[j].empty() || this->depth < Octree::MIN_DEPTH)
+            if (obj_list[j].empty())
+                continue;
+            if ((sub = this->octants[j].load(std::memory_order_relaxed))
+                != NULL)
+            {
+                sub->build(obj_list[j]);
+                continue;
+            }
+            try
+            {
+                sub = this->new_node(j);
+            }
+            catch (std::system_error& e)
             {
-                glm::dvec3 mn = this->octant_min(j);
-                glm::dvec3 mx = this->octant_max(j);
-                try
-                {
-                    this->octants[j] = new Octree(this, mn, mx, j);
-                }
-                catch (std::system_error& e)
-                {
-                    std::clog << syslogErr
-                              << "couldn't create octree subtree at depth "
-                              << this->depth + 1 << ": " << e.code().message()
-                              << " (" << e.code().value() << ")" << std::endl;
-                    continue;
-                }
-                this->octants[j]->build(obj_list[j]);
+                std::clog << syslogErr
+                          << "couldn't create octree subtree at depth "
+                          << this->depth + 1 << ": " << e.code().message()
+                          << " (" << e.code().value() << ")" << std::endl;
+                if (here == NULL)
+                    here = this->copy_residents();
+                here->insert(here->end(),
+                             obj_list[j].begin(), obj_list[j].end());
+                continue;
             }
+            sub->build(obj_list[j]);
+            this->octants[j].store(sub, std::memory_order_release);
         }
     }
+    else if (!objs.empty())
+    {
+        here = this->copy_residents();
+        here->insert(here->end(), objs.begin(), objs.end());
+    }
+    if (here != NULL)
+        this->set_residents(here);
 }
 
 void Octree::insert(GameObject *gobj)
+{
+    this->grow_radius(gobj);
+    this->insert(gobj, gobj->get_position());
+    if (this->broadphase != NULL)
+        this->broadphase->insert(gobj);
+}
+
+void Octree::insert(GameObject *gobj, const glm::dvec3& pos)
 {
     std::unique_lock write_lock(this->lock);
-    this->objects.insert(gobj);
-    if (this->depth < Octree::MAX_DEPTH
-        && this->objects.size() > Octree::MAX_LEAF_OBJECTS)
-    {
-        int octant = this->which_octant(gobj->get_position());
+    COUNT_LOCK();
+    ++this->count;
+    this->insert_below(gobj, pos);
+}
 
-        if (this->octants[octant] == NULL)
+/* The caller must hold our write lock, and our count must already
+ * include the object.  The object will either go down into the
+ * subtree for its octant, or stay here as a resident.
+ */
+void Octree::insert_below(GameObject *gobj, const glm::dvec3& pos)
+{
+    int octant = this->which_octant(pos);
+    Octree *sub = this->octants[octant].load(std::memory_order_relaxed);
+
+    if (this->depth < this->shape->max_depth
+        && this->fits(gobj)
+        && (sub != NULL
+            || this->depth < this->shape->min_depth
+            || this->count > (size_t)this->shape->max_leaf_objects))
+    {
+        if (sub == NULL)
         {
-            glm::dvec3 mn = this->octant_min(octant);
-            glm::dvec3 mx = this->octant_max(octant);
+            Octree::object_list_t objs, *current, *keep;
 
             try
             {
-                this->octants[octant] = new Octree(this, mn, mx, octant);
+                sub = this->new_node(octant);
             }
             catch (std::system_error& e)
             {
@@ -225,55 +664,574 @@ void Octree::insert(GameObject *gobj)
                           << "couldn't create octree subtree at depth "
                           << this->depth + 1 << ": " << e.code().message()
                           << " (" << e.code().value() << ")" << std::endl;
+                this->add_resident(gobj);
                 return;
             }
-            this->octants[octant]->build(this->objects);
+
+            /* Anything we were holding which belongs in the new
+             * octant goes down with the new object.  The new subtree
+             * is in place before they leave here.
+             */
+            objs.push_back(gobj);
+            current = this->residents.load(std::memory_order_relaxed);
+            for (auto i : *current)
+                if (i != gobj
+                    && this->fits(i)
+                    && this->which_octant(i->get_position()) == octant)
+                    objs.push_back(i);
+            sub->build(objs);
+            this->octants[octant].store(sub, std::memory_order_release);
+            if (objs.size() > 1)
+            {
+                keep = this->pool->get_list();
+                for (auto i : *current)
+                    if (std::find(objs.begin(), objs.end(), i) == objs.end())
+                        keep->push_back(i);
+                this->set_residents(keep);
+            }
         }
-        this->octants[octant]->insert(gobj);
+        else
+            sub->insert(gobj, pos);
+        return;
     }
+    this->add_resident(gobj);
+}
+
+bool Octree::remove(GameObject *gobj)
+{
+    return this->remove(gobj, gobj->get_position());
+}
+
+/* The position is where the object was when it was inserted, which
+ * is how we find the path it took down the tree.
+ */
+bool Octree::remove(GameObject *gobj, const glm::dvec3& pos)
+{
+    std::unique_lock write_lock(this->lock);
+    COUNT_LOCK();
+    Octree *sub = this->octants[this->which_octant(pos)].load(
+        std::memory_order_relaxed);
+
+    if (!this->remove_resident(gobj)
+        && (sub == NULL || !sub->remove(gobj, pos)))
+        return false;
+    --this->count;
+    if (this->broadphase != NULL)
+        this->broadphase->remove(gobj, pos);
+
+    if (this->count <= Octree::MERGE_LEAF_OBJECTS
+        && this->depth >= this->shape->min_depth)
+        this->merge();
+    return true;
+}
+
+/* Relocate an object which has already moved from old_pos to its
+ * current position.  If the new position is not within this tree, or
+ * the object isn't in it, nothing changes and we return false, so the
+ * caller can hand the object off somewhere else.
+ */
+bool Octree::move(GameObject *gobj, const glm::dvec3& old_pos)
+{
+    glm::dvec3 new_pos = gobj->get_position();
+
+    if (!this->in_octant(new_pos) || !this->move(gobj, old_pos, new_pos))
+        return false;
+    if (this->broadphase != NULL)
+        this->broadphase->move(gobj, old_pos);
+    return true;
 }
 
-void Octree::remove(GameObject *gobj)
+bool Octree::move(GameObject *gobj,
+                  const glm::dvec3& old_pos,
+                  const glm::dvec3& new_pos)
 {
+    int old_oct = this->which_octant(old_pos);
+    int new_oct = this->which_octant(new_pos);
+    Octree *sub;
+
+    if (old_oct == new_oct)
+    {
+        std::shared_lock read_lock(this->lock);
+        COUNT_LOCK();
+        sub = this->octants[old_oct].load(std::memory_order_relaxed);
+
+        /* Both positions are in the same place, as far as this node
+         * is concerned; either the object stops here, or the subtree
+         * gets to deal with it.
+         */
+        if (this->is_resident(gobj))
+            return true;
+        if (sub != NULL && sub->move(gobj, old_pos, new_pos))
+            return true;
+    }
+
+    /* This is the lowest common ancestor. */
     std::unique_lock write_lock(this->lock);
-    if (this->objects.find(gobj) != this->objects.end())
+    COUNT_LOCK();
+    sub = this->octants[old_oct].load(std::memory_order_relaxed);
+
+    /* Put it into its new place before taking it out of its old one,
+     * so a reader never misses it, though it might see it twice.  If
+     * it stays one of ours, it's briefly on our list twice.
+     */
+    if (this->is_resident(gobj))
     {
-        int octant = this->which_octant(gobj->get_position());
+        this->insert_below(gobj, new_pos);
+        this->remove_resident(gobj);
+        return true;
+    }
+    if (old_oct == new_oct || sub == NULL || !sub->holds(gobj, old_pos))
+        return false;
+
+    this->insert_below(gobj, new_pos);
+    sub->remove(gobj, old_pos);
+    return true;
+}
+
+/* Whether the object is somewhere along the path to a position.  Our
+ * caller holds a write lock above us, so nothing can change under
+ * us while we look.
+ */
+bool Octree::holds(GameObject *gobj, const glm::dvec3& pos)
+{
+    Octree *sub;
+
+    if (this->is_resident(gobj))
+        return true;
+    sub = this->octants[this->which_octant(pos)].load(
+        std::memory_order_relaxed);
+    return sub != NULL && sub->holds(gobj, pos);
+}
+
+/* Collect everything in this subtree.  Nobody else can change it
+ * without coming through our lock, which the caller must hold.
+ */
+void Octree::gather(Octree::object_list_t& result)
+{
+    Octree::object_list_t *list
+        = this->residents.load(std::memory_order_relaxed);
+    Octree *sub;
+
+    result.insert(result.end(), list->begin(), list->end());
+    for (int i = 0; i < 8; ++i)
+        if ((sub = this->octants[i].load(std::memory_order_relaxed)) != NULL)
+            sub->gather(result);
+}
+
+bool Octree::visit(SpatialIndex::visitor_t visitor, void *arg)
+{
+    return this->for_each_object(
+        [&](GameObject *go) { return visitor(go, arg); }
+    );
+}
+
+bool Octree::visit_sphere(const glm::dvec3& pt,
+                          double radius,
+                          SpatialIndex::visitor_t visitor,
+                          void *arg)
+{
+    Epoch::reader guard;
+    Octree::query_cost cost;
+    auto visit = [&](GameObject *go) { return visitor(go, arg); };
+    bool result = this->walk_sphere(pt, radius, visit, cost);
+
+    this->count_query(cost);
+    return result;
+}
+
+Octree::object_set_t Octree::get_objects(void)
+{
+    Octree::object_set_t result;
+
+    this->for_each_object(
+        [&](GameObject *go) {
+            result.insert(go);
+            return true;
+        }
+    );
+    return result;
+}
+
+/* Everything which might overlap the given sphere.  In a loose tree,
+ * this is every object whose bounding sphere could touch it; in a
+ * point tree, it's every object whose center is in a node which the
+ * sphere touches.
+ */
+Octree::object_set_t Octree::get_objects(const glm::dvec3& pt, double radius)
+{
+    Octree::object_set_t result;
+
+    this->for_each_in_sphere(
+        pt, radius,
+        [&](GameObject *go) {
+            result.insert(go);
+            return true;
+        }
+    );
+    return result;
+}
+
+/* Every object whose center is within radius of the point.  Since
+ * an object's center is always within the loose bounds of the node
+ * it's stored in, we only need to visit nodes which the sphere
+ * touches, and don't need to check the objects in nodes which are
+ * completely inside it.
+ */
+void Octree::range(const glm::dvec3& pt,
+                   double radius,
+                   Octree::object_list_t& result)
+{
+    Epoch::reader guard;
+    Octree::query_cost cost;
 
-        if (this->octants[octant] != NULL)
-            this->octants[octant]->remove(gobj);
-        this->objects.erase(gobj);
+    this->find_in_range(pt, radius, result, cost);
+    this->count_query(cost);
+}
+
+void Octree::find_in_range(const glm::dvec3& pt,
+                           double radius,
+                           Octree::object_list_t& result,
+                           Octree::query_cost& cost)
+{
+    Octree::object_list_t *list;
+    Octree *sub;
 
-        if (this->objects.size() < Octree::MAX_LEAF_OBJECTS
-            && this->depth > Octree::MIN_DEPTH)
+    ++cost.nodes;
+    if (!this->touches(pt, radius))
+        return;
+    list = this->residents.load(std::memory_order_acquire);
+    cost.objects += list->size();
+    if (this->within(pt, radius))
+        result.insert(result.end(), list->begin(), list->end());
+    else
+        for (auto i : *list)
         {
-            if (this->parent != NULL)
-                this->parent->octants[this->parent_index] = NULL;
-            write_lock.unlock();
-            delete this;
-            return;
+            glm::dvec3 d = i->get_position() - pt;
+
+            if (glm::dot(d, d) <= radius * radius)
+                result.push_back(i);
         }
+    for (int i = 0; i < 8; ++i)
+        if ((sub = this->octants[i].load(std::memory_order_acquire)) != NULL
+            && sub->count > 0)
+            sub->find_in_range(pt, radius, result, cost);
+}
+
+/* Add our nearest objects to a max-heap of no more than k entries,
+ * keyed on squared distance, so the current kth nearest is always at
+ * the front.  Subtrees are visited nearest first, and skipped once
+ * they're further away than anything we'd keep.  Callers can start
+ * with an empty heap, or pass one in from a neighboring tree.
+ */
+void Octree::nearest(const glm::dvec3& pt,
+                     size_t k,
+                     double max_dist,
+                     Octree::neighbor_list_t& best)
+{
+    Epoch::reader guard;
+    Octree::query_cost cost;
+
+    this->find_nearest(pt, k, max_dist, best, cost);
+    this->count_query(cost);
+}
+
+void Octree::find_nearest(const glm::dvec3& pt,
+                          size_t k,
+                          double max_dist,
+                          Octree::neighbor_list_t& best,
+                          Octree::query_cost& cost)
+{
+    std::pair<double, Octree *> subs[8];
+    double limit = max_dist * max_dist;
+    Octree::object_list_t *list;
+    Octree *sub;
+    int i, n = 0;
+
+    ++cost.nodes;
+    if (k == 0)
+        return;
+    list = this->residents.load(std::memory_order_acquire);
+    cost.objects += list->size();
+    for (auto j : *list)
+    {
+        glm::dvec3 d = j->get_position() - pt;
+        double dist2 = glm::dot(d, d);
+
+        if (dist2 <= limit)
+            SpatialIndex::keep_nearest(best, k, dist2, j);
+    }
+
+    for (i = 0; i < 8; ++i)
+        if ((sub = this->octants[i].load(std::memory_order_acquire)) != NULL
+            && sub->count > 0)
+            subs[n++] = std::make_pair(sub->distance2(pt), sub);
+    std::sort(subs, subs + n);
+    for (i = 0; i < n; ++i)
+    {
+        if (subs[i].first > limit
+            || (best.size() == k && subs[i].first >= best.front().first))
+            break;
+        subs[i].second->find_nearest(pt, k, max_dist, best, cost);
     }
 }
 
-Octree::object_set_t Octree::get_objects(void)
+/* The first object along the ray, if it's nearer than anything the
+ * ray has already hit.  Subtrees are visited in the order the ray
+ * enters them, and skipped once they start beyond its latest hit.
+ */
+void Octree::raycast(SpatialIndex::ray& r)
+{
+    Epoch::reader guard;
+    Octree::query_cost cost;
+    double pad = this->max_radius, dist;
+
+    if (this->crossed_by(r, pad, dist))
+        this->cast(r, pad, cost);
+    this->count_query(cost);
+}
+
+void Octree::cast(SpatialIndex::ray& r,
+                  double pad,
+                  Octree::query_cost& cost)
+{
+    std::pair<double, Octree *> subs[8];
+    Octree::object_list_t *list;
+    Octree *sub;
+    double dist;
+    int i, n = 0;
+
+    ++cost.nodes;
+    list = this->residents.load(std::memory_order_acquire);
+    cost.objects += list->size();
+    for (auto j : *list)
+        r.hits(j);
+
+    for (i = 0; i < 8; ++i)
+        if ((sub = this->octants[i].load(std::memory_order_acquire)) != NULL
+            && sub->count > 0
+            && sub->crossed_by(r, pad, dist))
+            subs[n++] = std::make_pair(dist, sub);
+    std::sort(subs, subs + n);
+    for (i = 0; i < n; ++i)
+    {
+        if (subs[i].first > r.max_dist)
+            break;
+        subs[i].second->cast(r, pad, cost);
+    }
+}
+
+/* Work out everybody's mass and center of mass, from the leaves up.
+ * Empty subtrees are left as they were; nothing looks at them.
+ */
+void Octree::weigh(void)
+{
+    Epoch::reader guard;
+
+    this->add_up_mass();
+}
+
+void Octree::add_up_mass(void)
+{
+    glm::dvec3 moment(0.0, 0.0, 0.0);
+    double total = 0.0;
+    Octree *sub;
+
+    for (auto i : *this->residents.load(std::memory_order_acquire))
+    {
+        total += i->geometry->mass;
+        moment += i->get_position() * i->geometry->mass;
+    }
+    for (int i = 0; i < 8; ++i)
+        if ((sub = this->octants[i].load(std::memory_order_acquire)) != NULL
+            && sub->count > 0)
+        {
+            sub->add_up_mass();
+            total += sub->mass;
+            moment += sub->center_of_mass * sub->mass;
+        }
+    this->mass = total;
+    this->center_of_mass = (total > 0.0 ? moment / total : this->center_point);
+}
+
+/* A node pulls as a single body if it's far enough away, and the
+ * point isn't inside it; otherwise, its residents pull one at a
+ * time, and its octants get the same choice.
+ */
+glm::dvec3 Octree::pull(GameObject *go, const glm::dvec3& pt, double theta)
+{
+    Octree::query_cost cost;
+
+    return this->pull(go, pt, theta, cost);
+}
+
+glm::dvec3 Octree::pull(GameObject *go,
+                        const glm::dvec3& pt,
+                        double theta,
+                        Octree::query_cost& cost)
+{
+    Epoch::reader guard;
+    glm::dvec3 accel(0.0, 0.0, 0.0);
+
+    this->pull_from(go, pt, theta, accel, cost);
+    return accel;
+}
+
+void Octree::pull_from(GameObject *go,
+                       const glm::dvec3& pt,
+                       double theta,
+                       glm::dvec3& accel,
+                       Octree::query_cost& cost)
 {
-    std::shared_lock read_lock(this->lock);
-    return Octree::object_set_t(this->objects.begin(), this->objects.end());
+    glm::dvec3 size = (this->max_point - this->min_point)
+        * std::max(this->looseness, 1.0);
+    Octree::object_list_t *list;
+    Octree *sub;
+
+    ++cost.nodes;
+    if (this->mass == 0.0)
+        return;
+    if (this->distance2(pt) > 0.0
+        && SpatialIndex::distant(pt, std::max({size.x, size.y, size.z}),
+                                 this->center_of_mass, theta))
+    {
+        accel += SpatialIndex::attraction(pt, this->center_of_mass,
+                                          this->mass, 0.0);
+        return;
+    }
+    list = this->residents.load(std::memory_order_acquire);
+    cost.objects += list->size();
+    for (auto i : *list)
+        if (i != go)
+            accel += SpatialIndex::attraction(go, pt, i);
+    for (int i = 0; i < 8; ++i)
+        if ((sub = this->octants[i].load(std::memory_order_acquire)) != NULL
+            && sub->count > 0)
+            sub->pull_from(go, pt, theta, accel, cost);
 }
 
+/* The node holding an object.  The node can be released as soon as
+ * we return, so don't hang on to it.
+ */
 Octree *Octree::find(GameObject *go)
 {
-    std::shared_lock read_lock(this->lock);
-    if (this->objects.find(go) == this->objects.end())
-        return NULL;
+    Epoch::reader guard;
+
+    return this->find_object(go);
+}
+
+Octree *Octree::find_object(GameObject *go)
+{
+    Octree *sub;
+
+    if (this->is_resident(go))
+        return this;
+    sub = this->octants[this->which_octant(go->get_position())].load(
+        std::memory_order_acquire);
+    return sub != NULL ? sub->find_object(go) : NULL;
+}
+
+/* Charge the shape with the nodes and objects a query looked at */
+void Octree::count_query(const Octree::query_cost& cost)
+{
+    this->shape->queries.fetch_add(1, std::memory_order_relaxed);
+    this->shape->nodes_visited.fetch_add(cost.nodes,
+                                         std::memory_order_relaxed);
+    this->shape->objects_examined.fetch_add(cost.objects,
+                                            std::memory_order_relaxed);
+}
+
+/* Set the depths and leaf size which this tree uses.  An adaptive
+ * tree treats the depths as limits, and starts out at them.
+ */
+void Octree::set_shape(int min_depth, int max_depth, int leaf, bool adaptive)
+{
+    min_depth = std::clamp(min_depth, 0, Octree::DEPTH_LIMIT);
+    max_depth = std::clamp(max_depth, min_depth, Octree::DEPTH_LIMIT);
+
+    this->shape->min_limit = this->shape->min_depth = min_depth;
+    this->shape->max_limit = this->shape->max_depth = max_depth;
+    this->shape->max_leaf_objects = std::max(leaf, 1);
+    this->shape->adaptive = adaptive;
+}
+
+void Octree::describe(SpatialIndex::shape_stats& stats)
+{
+    stats.nodes.clear();
+    stats.objects.clear();
+    stats.occupancy.clear();
+    stats.min_depth = this->shape->min_depth;
+    stats.max_depth = this->shape->max_depth;
+    stats.queries = this->shape->queries;
+    stats.nodes_visited = this->shape->nodes_visited;
+    stats.objects_examined = this->shape->objects_examined;
+    stats.node_rate = this->pool->allocation_rate();
+
+    Epoch::reader guard;
+    this->tally(stats);
+}
+
+void Octree::tally(SpatialIndex::shape_stats& stats)
+{
+    size_t here = this->residents.load(std::memory_order_acquire)->size();
+    Octree *sub;
+    bool leaf = true;
+
+    if ((size_t)this->depth >= stats.nodes.size())
+    {
+        stats.nodes.resize(this->depth + 1, 0);
+        stats.objects.resize(this->depth + 1, 0);
+    }
+    ++stats.nodes[this->depth];
+    stats.objects[this->depth] += here;
+    for (int i = 0; i < 8; ++i)
+        if ((sub = this->octants[i].load(std::memory_order_acquire)) != NULL)
+        {
+            sub->tally(stats);
+            leaf = false;
+        }
+    if (leaf)
+        ++stats.occupancy[here];
+}
+
+/* Pick our depths from how crowded we are, and what our queries have
+ * been costing since the last time.
+ *
+ * A sparse tree doesn't need to split all the way down to the
+ * configured minimum depth; the depth at which evenly spread objects
+ * would just fill the leaves is plenty.  If the queries are mostly
+ * walking through empty nodes, the tree is deeper than it needs to
+ * be, and if they're mostly scanning long lists of objects, it could
+ * stand to be deeper, up to the configured maximum.
+ */
+void Octree::retune(void)
+{
+    Octree::tree_shape *sh = this->shape;
+    uint64_t queries, nodes, examined;
+    size_t per_leaf = sh->max_leaf_objects, n = per_leaf;
+    int want = 0, floor, max_depth = sh->max_depth;
 
-    int octant = this->which_octant(go->get_position());
-    if (this->octants[octant] != NULL)
+    if (!sh->adaptive)
+        return;
+    queries = sh->queries.exchange(0);
+    nodes = sh->nodes_visited.exchange(0);
+    examined = sh->objects_examined.exchange(0);
+
+    while (n < this->count && want < sh->min_limit)
     {
-        Octree *result = this->octants[octant]->find(go);
-        if (result != NULL)
-            return result;
+        n *= 8;
+        ++want;
+    }
+    sh->min_depth = want;
+
+    floor = std::min(std::max(want, 1), (int)sh->max_limit);
+    if (queries > 0 && nodes > 0)
+    {
+        double per_node = (double)examined / nodes;
+
+        if (per_node > 2.0 * per_leaf)
+            ++max_depth;
+        else if (per_node < 0.5)
+            --max_depth;
     }
-    return this;
+    sh->max_depth = std::clamp(max_depth, floor, (int)sh->max_limit);
 }
@@ -22,15 +22,33 @@
  * This file contains the declaration of the octree class.
  *
  * We are not going to subdivide anything - it's more work than we may
- * ever need to do.  For the time being, we'll just classify based on
- * the center of the object.
+ * ever need to do.  By default, we'll just classify based on the
+ * center of the object.
+ *
+ * If the tree is given a looseness factor (greater than 1), it
+ * becomes a loose octree:  each node's bounds are stretched by that
+ * factor around its center, and an object only descends into an
+ * octant if its bounding sphere fits within the octant's loose
+ * bounds.  Large objects stay up near the root, in the residents of
+ * the node where they stopped, and overlap queries only need to
+ * visit the nodes whose loose bounds touch the query sphere.
  *
  * We need to have a max tree height too, but I don't know what range
  * is realistic.  Perhaps 10 or so might be a good start?  We might
  * also want to have a minimum tree height as well, to get a
- * particular maximum sized voxel.  We may need to have config options
- * which determine these parameters, but for the time being, we'll
- * just have constants in the class.
+ * particular maximum sized voxel.  The constants in the class are
+ * only the defaults; each tree has a shape, shared by all its nodes,
+ * which holds the depths and leaf size it actually uses, and which
+ * the zone sets from the config file.  Changing the shape of a tree
+ * which is in use doesn't rebuild anything - nodes just split and
+ * merge according to the new shape as things move around.
+ *
+ * An adaptive tree picks its own depths, within the configured ones,
+ * from how many objects it has and from what its queries have been
+ * costing.  The shape keeps track of how many nodes and objects the
+ * range, nearest and sphere queries have had to look at; a pull can
+ * tell its caller what it cost, but doesn't count towards the shape,
+ * since gravity opens up the tree in its own way.
  *
  * Some links that look like decent info:
  * http://hpcc.engin.umich.edu/CFD/users/charlton/Thesis/html/node29.html
@@ -38,6 +56,55 @@
  * http://www.cg.tuwien.ac.at/research/vr/lodestar/tech/octree/
  * http://www.altdev.co/2011/08/01/loose-octrees-for-frustum-culling-part-1/
  *
+ * Moving an object only touches the part of the tree below the lowest
+ * common ancestor of its old and new positions; everything above
+ * that node already contains the object, and stays as it is.
+ *
+ * Objects are only stored in the node where they stop, in a plain
+ * array.  In a point tree, that's almost always a leaf; a node which
+ * splits only pushes down the octant it needs, so a few objects may
+ * be left behind until their own octants fill up.  Interior nodes
+ * carry only their bounds and a count of what's beneath them, and
+ * getting everything in a subtree means walking down to the leaves.
+ *
+ * Range queries return every object whose center is within a given
+ * distance of a point, and nearest-neighbor queries keep a bounded
+ * heap of the closest objects found so far.  The heap can be passed
+ * from one tree to the next, so a query can span several sectors.
+ *
+ * Each tree keeps a pool of spare nodes, so that moving objects don't
+ * have us constantly allocating and freeing subtrees.  A leaf splits
+ * when it has more than MAX_LEAF_OBJECTS, but a subtree only folds
+ * back into a leaf once it's down to MERGE_LEAF_OBJECTS, so an object
+ * wandering back and forth doesn't split and merge a node every tick.
+ *
+ * Readers - range, nearest, find and the visitors - don't take any
+ * locks at all.  They check in with the epoch scheme instead, and
+ * anything a writer unlinks, whether a node or a resident array,
+ * waits in the pool's limbo until no reader can still be looking at
+ * it.  A resident array never changes once readers can see it; a
+ * writer makes a new one and swaps it in.  Writers still keep out of
+ * each other's way with the per-node locks.  An object which moves
+ * from one subtree to another is put into its new place before it's
+ * taken out of its old one, so a query running at that moment might
+ * see it twice; the zone's queries and the nearest-neighbour heap
+ * weed out the repeats.
+ *
+ * Rays visit the subtrees they pass through nearest first, and stop
+ * as soon as the next subtree starts beyond what they've already
+ * hit.  Each node's bounds are padded by the biggest radius in the
+ * tree, since an object can stick out of the node which holds it.
+ *
+ * The root of a tree can also carry a sweep-and-prune broadphase.
+ * Only the root's public methods keep it up to date; the subtrees
+ * never have one.
+ *
+ * Weighing the tree works out every node's mass and center of mass,
+ * from the leaves up, and pulls walk down from the root until the
+ * nodes look small enough.  Only one thread should weigh a tree at a
+ * time, and nothing should pull on it until it's done; the masses
+ * aren't kept up to date as things move around.
+ *
  * Things to do
  *
  */
@@ -46,54 +113,240 @@
 #define __INC_OCTREE_H__
 
 #include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <list>
+#include <mutex>
 #include <set>
 #include <shared_mutex>
+#include <vector>
 
 #include <glm/vec3.hpp>
 
 #include "game_obj.h"
+#include "epoch.h"
+#include "spatial_index.h"
 
-class Octree
+class Octree : public SpatialIndex
 {
   public:
-    typedef std::set<GameObject *> object_set_t;
-
     static const int MAX_LEAF_OBJECTS;
+    static const int MERGE_LEAF_OBJECTS;
+    static const int MAX_SPARE_NODES;
     static const int MIN_DEPTH;
     static const int MAX_DEPTH;
+    static const int DEPTH_LIMIT;
+
+#ifdef OCTREE_LOCK_COUNT
+    /* Lock acquisitions made by the calling thread, for benchmarks */
+    static thread_local uint64_t lock_count;
+#endif
+
+    /* The nodes and objects one query has looked at */
+    class query_cost
+    {
+      public:
+        uint64_t nodes, objects;
+
+        query_cost() : nodes(0), objects(0) {};
+    };
+
+    /* How the tree is shaped, and what querying it has cost */
+    class tree_shape
+    {
+      public:
+        std::atomic<int> min_depth, max_depth, max_leaf_objects;
+        std::atomic<int> min_limit, max_limit;
+        std::atomic<bool> adaptive;
+        std::atomic<uint64_t> queries, nodes_visited, objects_examined;
+
+        tree_shape();
+    };
+
+    /* Nodes and resident arrays which have been released, waiting
+     * to be reused.  Anything released goes into limbo first, until
+     * no reader can still be looking at it.
+     */
+    class node_pool
+    {
+      public:
+        std::mutex lock;
+        std::vector<Octree *> spare;
+        std::vector<object_list_t *> spare_lists;
+        std::deque<std::pair<uint64_t, Octree *> > limbo;
+        std::deque<std::pair<uint64_t, object_list_t *> > limbo_lists;
+        std::atomic<uint64_t> created, reused, released;
+
+      private:
+        uint64_t last_total;
+        std::chrono::steady_clock::time_point last_time;
+
+        void reclaim(void);
+
+      public:
+        node_pool();
+        ~node_pool();
+
+        Octree *get_node(void);
+        object_list_t *get_list(void);
+        void retire(Octree *);
+        void retire(object_list_t *);
+
+        double allocation_rate(void);
+    };
 
   private:
     std::shared_mutex lock;
 
   public:
-    glm::dvec3 min_point, center_point, max_point;
-    Octree *parent, *octants[8];
+    glm::dvec3 center_point;
+    Octree *parent;
+    std::atomic<Octree *> octants[8];
+    node_pool *pool;
+    tree_shape *shape;
     uint8_t parent_index;
     int depth;
+    double looseness;
 
-    object_set_t objects;
+    /* The objects which stop here.  Our count is how many are in the
+     * whole subtree, so queries can skip empty subtrees.  Readers
+     * don't lock anything, so the array is never changed once it's
+     * been published; writers make a new one and swap it in.
+     */
+    std::atomic<object_list_t *> residents;
 
   private:
+    void init(Octree *, const glm::dvec3&, const glm::dvec3&, uint8_t);
+    Octree *new_node(int);
+    void release(void);
+    void merge(void);
+    void count_query(const query_cost&);
+    void tally(shape_stats&);
+
+    object_list_t *copy_residents(void);
+    void set_residents(object_list_t *);
+    bool add_resident(GameObject *);
+    bool remove_resident(GameObject *);
+
     inline bool in_octant(const glm::dvec3&);
     inline int which_octant(const glm::dvec3&);
     inline glm::dvec3 octant_min(int oct);
     inline glm::dvec3 octant_max(int oct);
+    inline bool fits(GameObject *);
+    inline double distance2(const glm::dvec3&);
+    bool touches(const glm::dvec3&, double);
+    inline bool within(const glm::dvec3&, double);
+    inline bool is_resident(GameObject *);
+    bool crossed_by(const ray&, double, double&);
+
+    void insert(GameObject *, const glm::dvec3&);
+    void insert_below(GameObject *, const glm::dvec3&);
+    bool move(GameObject *, const glm::dvec3&, const glm::dvec3&);
+    void gather(object_list_t&);
+    void find_in_range(const glm::dvec3&, double, object_list_t&,
+                       query_cost&);
+    void find_nearest(const glm::dvec3&, size_t, double, neighbor_list_t&,
+                      query_cost&);
+    void cast(ray&, double, query_cost&);
+    void add_up_mass(void);
+    void pull_from(GameObject *, const glm::dvec3&, double, glm::dvec3&,
+                   query_cost&);
+    Octree *find_object(GameObject *);
+    bool holds(GameObject *, const glm::dvec3&);
+
+    template <typename F>
+    bool walk(F& visit)
+        {
+            for (auto i : *this->residents.load(std::memory_order_acquire))
+                if (!visit(i))
+                    return false;
+            for (int i = 0; i < 8; ++i)
+            {
+                Octree *sub = this->octants[i].load(std::memory_order_acquire);
+
+                if (sub != NULL && sub->count > 0 && !sub->walk(visit))
+                    return false;
+            }
+            return true;
+        };
+
+    template <typename F>
+    bool walk_sphere(const glm::dvec3& pt, double radius, F& visit,
+                     query_cost& cost)
+        {
+            ++cost.nodes;
+            if (!this->touches(pt, radius))
+                return true;
+            for (auto i : *this->residents.load(std::memory_order_acquire))
+            {
+                ++cost.objects;
+                if (!visit(i))
+                    return false;
+            }
+            for (int i = 0; i < 8; ++i)
+            {
+                Octree *sub = this->octants[i].load(std::memory_order_acquire);
+
+                if (sub != NULL && sub->count > 0
+                    && !sub->walk_sphere(pt, radius, visit, cost))
+                    return false;
+            }
+            return true;
+        };
 
   public:
-    Octree(Octree *, glm::dvec3&, glm::dvec3&, uint8_t);
+    Octree(Octree *, glm::dvec3&, glm::dvec3&, uint8_t, double = 0.0);
     ~Octree();
 
-    bool empty(void);
+    void set_shape(int, int, int, bool);
+    void describe(shape_stats&) override;
+    void retune(void) override;
 
     void build(const std::list<GameObject *>&);
     void build(const object_set_t&);
-    void insert(GameObject *);
-    void remove(GameObject *);
+    void build(const object_list_t&) override;
+    void insert(GameObject *) override;
+    bool remove(GameObject *);
+    bool remove(GameObject *, const glm::dvec3&) override;
+    bool move(GameObject *, const glm::dvec3&) override;
 
     object_set_t get_objects(void);
+    object_set_t get_objects(const glm::dvec3&, double);
+
+    /* Call the visitor on each object in the subtree, or in the nodes
+     * whose bounds touch a sphere.  We don't take any locks, and
+     * nothing gets copied.  The visitor returns false to stop early,
+     * and then so do we.
+     */
+    template <typename F>
+    bool for_each_object(F&& visit)
+        {
+            Epoch::reader guard;
+
+            return this->walk(visit);
+        };
+
+    template <typename F>
+    bool for_each_in_sphere(const glm::dvec3& pt, double radius, F&& visit)
+        {
+            Epoch::reader guard;
+            query_cost cost;
+
+            return this->walk_sphere(pt, radius, visit, cost);
+        };
+    bool visit(visitor_t, void *) override;
+    bool visit_sphere(const glm::dvec3&, double, visitor_t, void *) override;
+    void range(const glm::dvec3&, double, object_list_t&) override;
+    void nearest(const glm::dvec3&, size_t, double,
+                 neighbor_list_t&) override;
+    void raycast(ray&) override;
+
+    void weigh(void) override;
+    glm::dvec3 pull(GameObject *, const glm::dvec3&, double) override;
+    glm::dvec3 pull(GameObject *, const glm::dvec3&, double, query_cost&);
 
-    Octree *find(GameObject *);
+    Octree *find(GameObject *) override;
 };
 
 #endif /* INC_OCTREE_H__ */
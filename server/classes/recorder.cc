@@ -0,0 +1,268 @@
+/* recorder.cc
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * The implementation of the recorder.  Ticks are only counted as
+ * they happen, and written out as one event whenever something else
+ * needs to go in after them.
+ *
+ * Things to do
+ *
+ */
+
+#include <errno.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#include "recorder.h"
+#include "config_data.h"
+#include "sim_clock.h"
+
+const char Recorder::MAGIC[4] = { 'R', '9', 'R', 'C' };
+const uint8_t Recorder::FORMAT_VERSION = 5;
+
+const uint8_t Recorder::END = 0;
+const uint8_t Recorder::TICKS = 1;
+const uint8_t Recorder::ACTION = 2;
+
+const uint8_t Recorder::INTERACTIVE = 1;
+const uint8_t Recorder::DRIVEN = 2;
+const uint8_t Recorder::ASLEEP = 4;
+
+/* The header, with everything from the config which changes how the
+ * zone moves, then everything in the zone, in order of the IDs.
+ */
+Recorder::Recorder(const std::string& fname,
+                   unsigned int rate,
+                   GameObject::objects_map& objects)
+    : lock(), out(fname, std::ios::out | std::ios::binary | std::ios::trunc),
+      order_lock(), ticks(0), actions(0)
+{
+    std::vector<GameObject *> all;
+
+    if (!this->out.is_open())
+    {
+        std::string s("couldn't open recording " + fname);
+
+        throw std::system_error(errno, std::generic_category(), s);
+    }
+    this->pending = 0;
+
+    for (auto& i : objects)
+        all.push_back(i.second);
+    std::sort(all.begin(), all.end(),
+              [](GameObject *a, GameObject *b) {
+                  return a->get_object_id() < b->get_object_id();
+              });
+
+    this->out.write(Recorder::MAGIC, sizeof(Recorder::MAGIC));
+    this->out.put(Recorder::FORMAT_VERSION);
+    Recorder::write_number(this->out, rate);
+    Recorder::write_number(this->out, SimClock::ticks());
+    Recorder::write_number(this->out, SimClock::now());
+    for (int i = 0; i < 3; ++i)
+        Recorder::write_number(this->out, config.size.dim[i]);
+    for (int i = 0; i < 3; ++i)
+        Recorder::write_number(this->out, config.size.steps[i]);
+    Recorder::write_double(this->out, config.gravity);
+    Recorder::write_double(this->out, config.gravity_theta);
+    Recorder::write_double(this->out, config.sleep_speed);
+    Recorder::write_double(this->out, config.sleep_spin);
+    Recorder::write_double(this->out, config.sleep_after);
+    Recorder::write_string(this->out, config.spatial_index);
+    Recorder::write_string(this->out, config.broadphase);
+    Recorder::write_double(this->out, config.octree_looseness);
+    Recorder::write_number(this->out, config.octree_min_depth);
+    Recorder::write_number(this->out, config.octree_max_depth);
+    Recorder::write_number(this->out, config.octree_leaf_objects);
+    this->out.put(config.octree_adaptive ? 1 : 0);
+    Recorder::write_number(this->out, all.size());
+    for (auto go : all)
+    {
+        glm::dvec3 pos = go->get_position(), move = go->get_movement();
+        glm::dvec3 rot = go->get_rotation();
+        glm::dquat orient = go->get_orientation();
+        Geometry *geom = go->geometry;
+
+        Recorder::write_number(this->out, go->get_object_id());
+        this->out.put((go->natures.count(
+                           GameObject::nature::non_interactive)
+                       ? 0 : Recorder::INTERACTIVE)
+                      | (go->driven() ? Recorder::DRIVEN : 0)
+                      | (go->asleep() ? Recorder::ASLEEP : 0));
+        Recorder::write_double(this->out, go->calm());
+        for (int i = 0; i < 3; ++i)
+            Recorder::write_double(this->out, pos[i]);
+        for (int i = 0; i < 3; ++i)
+            Recorder::write_double(this->out, move[i]);
+        for (int i = 0; i < 4; ++i)
+            Recorder::write_double(this->out, orient[i]);
+        for (int i = 0; i < 3; ++i)
+            Recorder::write_double(this->out, rot[i]);
+        for (int i = 0; i < 3; ++i)
+            Recorder::write_double(this->out, geom->center[i]);
+        Recorder::write_double(this->out, geom->radius);
+        Recorder::write_double(this->out, geom->mass);
+        Recorder::write_double(this->out, geom->restitution);
+        Recorder::write_double(this->out, geom->friction);
+    }
+}
+
+Recorder::~Recorder()
+{
+    this->close();
+}
+
+void Recorder::flush_ticks(void)
+{
+    if (this->pending > 0)
+    {
+        this->out.put(Recorder::TICKS);
+        Recorder::write_number(this->out, this->pending);
+        this->pending = 0;
+    }
+}
+
+void Recorder::tick(void)
+{
+    std::scoped_lock lock(this->lock);
+
+    ++this->pending;
+    ++this->ticks;
+}
+
+/* Only what the action routine actually sees is kept */
+void Recorder::action(const action_request& req)
+{
+    std::scoped_lock lock(this->lock);
+
+    if (!this->out.is_open())
+        return;
+    this->flush_ticks();
+    this->out.put(Recorder::ACTION);
+    Recorder::write_number(this->out, req.object_id);
+    Recorder::write_number(this->out, req.action_id);
+    this->out.put(req.power_level);
+    Recorder::write_number(this->out, req.dest_object_id);
+    Recorder::write_signed(this->out, req.x_pos_dest);
+    Recorder::write_signed(this->out, req.y_pos_dest);
+    Recorder::write_signed(this->out, req.z_pos_dest);
+    ++this->actions;
+}
+
+void Recorder::close(void)
+{
+    std::scoped_lock lock(this->lock);
+
+    if (!this->out.is_open())
+        return;
+    this->flush_ticks();
+    this->out.put(Recorder::END);
+    this->out.close();
+}
+
+void Recorder::write_number(std::ostream& s, uint64_t n)
+{
+    while (n >= 0x80)
+    {
+        s.put((char)((n & 0x7f) | 0x80));
+        n >>= 7;
+    }
+    s.put((char)n);
+}
+
+/* Small numbers either way stay small */
+void Recorder::write_signed(std::ostream& s, int64_t n)
+{
+    Recorder::write_number(s, ((uint64_t)n << 1) ^ (uint64_t)(n >> 63));
+}
+
+void Recorder::write_double(std::ostream& s, double d)
+{
+    uint64_t bits;
+
+    memcpy(&bits, &d, sizeof(bits));
+    for (int i = 0; i < 8; ++i, bits >>= 8)
+        s.put((char)(bits & 0xff));
+}
+
+void Recorder::write_string(std::ostream& s, const std::string& str)
+{
+    Recorder::write_number(s, str.size());
+    s.write(str.data(), str.size());
+}
+
+uint64_t Recorder::read_number(std::istream& s)
+{
+    uint64_t n = 0;
+    int shift = 0, c;
+
+    do
+    {
+        if ((c = s.get()) == EOF || shift > 63)
+            throw std::runtime_error("recording is cut short");
+        n |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+    }
+    while (c & 0x80);
+    return n;
+}
+
+int64_t Recorder::read_signed(std::istream& s)
+{
+    uint64_t n = Recorder::read_number(s);
+
+    return (int64_t)(n >> 1) ^ -(int64_t)(n & 1);
+}
+
+double Recorder::read_double(std::istream& s)
+{
+    uint64_t bits = 0;
+    double d;
+    int c;
+
+    for (int i = 0; i < 8; ++i)
+    {
+        if ((c = s.get()) == EOF)
+            throw std::runtime_error("recording is cut short");
+        bits |= (uint64_t)c << (i * 8);
+    }
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+std::string Recorder::read_string(std::istream& s)
+{
+    uint64_t len = Recorder::read_number(s);
+    std::string str;
+    int c;
+
+    for (uint64_t i = 0; i < len; ++i)
+    {
+        if ((c = s.get()) == EOF)
+            throw std::runtime_error("recording is cut short");
+        str.push_back((char)c);
+    }
+    return str;
+}
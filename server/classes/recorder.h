@@ -0,0 +1,107 @@
+/* recorder.h                                              -*- C++ -*-
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * This file contains the declaration of the recorder, which writes
+ * down everything that happens to the zone, so it can be played back
+ * later, exactly the same way, by the replay.
+ *
+ * In tick mode, the only things which can change the world are the
+ * ticks themselves and the actions people send in, so those are all
+ * we need to keep.  A recording starts with the tick rate, where the
+ * clock was, everything from the config which changes how things
+ * move, like gravity and the shape of the zone and its sectors, and a
+ * snapshot of every object in the zone, down to whether it's asleep
+ * and how close it is to falling asleep, and then it's a list of
+ * events:  a run of some number of ticks, or an action, in the order
+ * they happened.  An action which comes in while a tick is running
+ * waits for that tick to finish, and goes after it, both in the
+ * recording and in the zone.
+ *
+ * Everything is kept small.  Numbers are written seven bits to a
+ * byte, with signed ones zigzagged first, and any number of ticks in
+ * a row with nothing happening in between is just one event.  The
+ * doubles in the snapshot are written as their bits, lowest byte
+ * first, so the files go between machines.
+ *
+ * Things to do
+ *   - Logins and logouts aren't recorded, so a player's object stays
+ *     however it was when the recording started.
+ *
+ */
+
+#ifndef __INC_RECORDER_H__
+#define __INC_RECORDER_H__
+
+#include <cstdint>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+#include "../../proto/proto.h"
+#include "game_obj.h"
+
+class Recorder
+{
+  public:
+    static const char MAGIC[4];
+    static const uint8_t FORMAT_VERSION;
+
+    /* The events */
+    static const uint8_t END, TICKS, ACTION;
+
+    /* What each object in the snapshot is flagged with */
+    static const uint8_t INTERACTIVE, DRIVEN, ASLEEP;
+
+  private:
+    std::mutex lock;
+    std::ofstream out;
+    uint64_t pending;
+
+    void flush_ticks(void);
+
+  public:
+    /* Held across a whole tick, and across recording and performing
+     * an action, so an action is always done in between the same
+     * two ticks that it's written down between.
+     */
+    std::mutex order_lock;
+    std::atomic<uint64_t> ticks, actions;
+
+    Recorder(const std::string&, unsigned int, GameObject::objects_map&);
+    ~Recorder();
+
+    void tick(void);
+    void action(const action_request&);
+    void close(void);
+
+    static void write_number(std::ostream&, uint64_t);
+    static void write_signed(std::ostream&, int64_t);
+    static void write_double(std::ostream&, double);
+    static void write_string(std::ostream&, const std::string&);
+    static uint64_t read_number(std::istream&);
+    static int64_t read_signed(std::istream&);
+    static double read_double(std::istream&);
+    static std::string read_string(std::istream&);
+};
+
+#endif /* __INC_RECORDER_H__ */
@@ -0,0 +1,197 @@
+/* replay.cc
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * The implementation of the replay.  A recording which stops without
+ * an end, because the server died while making it, plays as far as
+ * it goes.
+ *
+ * Things to do
+ *
+ */
+
+#include <errno.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include "replay.h"
+#include "recorder.h"
+#include "sim_clock.h"
+
+Replay::Replay(const std::string& fname)
+    : in(fname, std::ios::in | std::ios::binary), spatial_index(),
+      broadphase()
+{
+    char magic[sizeof(Recorder::MAGIC)];
+
+    if (!this->in.is_open())
+    {
+        std::string s("couldn't open recording " + fname);
+
+        throw std::system_error(errno, std::generic_category(), s);
+    }
+    if (!this->in.read(magic, sizeof(magic))
+        || memcmp(magic, Recorder::MAGIC, sizeof(magic)) != 0)
+        throw std::runtime_error(fname + " isn't a recording");
+    if (this->in.get() != Recorder::FORMAT_VERSION)
+        throw std::runtime_error(fname + " is the wrong recording version");
+
+    this->zone = NULL;
+    this->tick_rate = Recorder::read_number(this->in);
+    this->first_tick = Recorder::read_number(this->in);
+    this->first_nsec = Recorder::read_number(this->in);
+    for (int i = 0; i < 3; ++i)
+        this->size.dim[i] = Recorder::read_number(this->in);
+    for (int i = 0; i < 3; ++i)
+        this->size.steps[i] = Recorder::read_number(this->in);
+    this->gravity = Recorder::read_double(this->in);
+    this->gravity_theta = Recorder::read_double(this->in);
+    this->sleep_speed = Recorder::read_double(this->in);
+    this->sleep_spin = Recorder::read_double(this->in);
+    this->sleep_after = Recorder::read_double(this->in);
+    this->spatial_index = Recorder::read_string(this->in);
+    this->broadphase = Recorder::read_string(this->in);
+    this->octree_looseness = Recorder::read_double(this->in);
+    this->octree_min_depth = Recorder::read_number(this->in);
+    this->octree_max_depth = Recorder::read_number(this->in);
+    this->octree_leaf_objects = Recorder::read_number(this->in);
+    this->octree_adaptive = (this->in.get() == 1);
+    this->ticks = 0;
+    this->actions = 0;
+}
+
+Replay::~Replay()
+{
+}
+
+/* Whatever the local config says, the recording's settings win, so
+ * the zone we make moves the same way the recorded one did.
+ */
+void Replay::configure(config_data& c)
+{
+    c.size = this->size;
+    c.gravity = this->gravity;
+    c.gravity_theta = this->gravity_theta;
+    c.sleep_speed = this->sleep_speed;
+    c.sleep_spin = this->sleep_spin;
+    c.sleep_after = this->sleep_after;
+    c.spatial_index = this->spatial_index;
+    c.broadphase = this->broadphase;
+    c.octree_looseness = this->octree_looseness;
+    c.octree_min_depth = this->octree_min_depth;
+    c.octree_max_depth = this->octree_max_depth;
+    c.octree_leaf_objects = this->octree_leaf_objects;
+    c.octree_adaptive = this->octree_adaptive;
+}
+
+/* The snapshot goes into the zone's objects, and anything which is
+ * inside the zone goes into its sector.  Returns how many objects
+ * there were.
+ */
+size_t Replay::load(Zone *z)
+{
+    SpatialIndex::object_list_t placed;
+    size_t count = Recorder::read_number(this->in);
+
+    this->zone = z;
+    for (size_t n = 0; n < count; ++n)
+    {
+        uint64_t objid = Recorder::read_number(this->in);
+        int flags = this->in.get();
+        double calm = Recorder::read_double(this->in);
+        glm::dvec3 pos, move, rot;
+        glm::dquat orient;
+        GameObject *go = new GameObject(NULL, NULL, objid);
+
+        for (int i = 0; i < 3; ++i)
+            pos[i] = Recorder::read_double(this->in);
+        for (int i = 0; i < 3; ++i)
+            move[i] = Recorder::read_double(this->in);
+        for (int i = 0; i < 4; ++i)
+            orient[i] = Recorder::read_double(this->in);
+        for (int i = 0; i < 3; ++i)
+            rot[i] = Recorder::read_double(this->in);
+        for (int i = 0; i < 3; ++i)
+            go->geometry->center[i] = Recorder::read_double(this->in);
+        go->geometry->radius = Recorder::read_double(this->in);
+        go->geometry->mass = Recorder::read_double(this->in);
+        go->geometry->restitution = Recorder::read_double(this->in);
+        go->geometry->friction = Recorder::read_double(this->in);
+
+        go->set_position(pos);
+        go->set_orientation(orient);
+        go->set_rotation(rot, (flags & Recorder::DRIVEN) != 0);
+        go->set_movement(move, (flags & Recorder::DRIVEN) != 0);
+        if (!(flags & Recorder::INTERACTIVE))
+            go->deactivate();
+        go->set_rest((flags & Recorder::ASLEEP) != 0, calm);
+        z->game_objects[objid] = go;
+        if (z->sector_contains(pos) != NULL)
+            placed.push_back(go);
+    }
+    z->hand_off(placed);
+    return count;
+}
+
+/* The clock picks up where the recording's did, at whatever rate the
+ * motion pool set.  Without an action pool, the actions are only
+ * counted.  Returns how many ticks we ran.
+ */
+uint64_t Replay::run(ActionPool *act, MotionPool *motion)
+{
+    int event;
+
+    SimClock::start_at(this->first_tick, this->first_nsec);
+    while ((event = this->in.get()) != EOF && event != Recorder::END)
+    {
+        if (event == Recorder::TICKS)
+        {
+            uint64_t count = Recorder::read_number(this->in);
+
+            for (uint64_t i = 0; i < count; ++i)
+                motion->tick();
+            this->ticks += count;
+        }
+        else if (event == Recorder::ACTION)
+        {
+            action_request req;
+
+            memset(&req, 0, sizeof(action_request));
+            req.type = TYPE_ACTREQ;
+            req.object_id = Recorder::read_number(this->in);
+            req.action_id = Recorder::read_number(this->in);
+            req.power_level = this->in.get();
+            req.dest_object_id = Recorder::read_number(this->in);
+            req.x_pos_dest = Recorder::read_signed(this->in);
+            req.y_pos_dest = Recorder::read_signed(this->in);
+            req.z_pos_dest = Recorder::read_signed(this->in);
+
+            auto found = this->zone->game_objects.find(req.object_id);
+            if (act != NULL && found != this->zone->game_objects.end())
+                act->perform(found->second, req);
+            ++this->actions;
+        }
+        else
+            throw std::runtime_error("unknown event in recording");
+    }
+    return this->ticks;
+}
@@ -0,0 +1,84 @@
+/* replay.h                                                -*- C++ -*-
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * This file contains the declaration of the replay, which plays back
+ * whatever the recorder wrote down.
+ *
+ * The objects in the recording go into a zone which has no database
+ * behind it, and then the ticks and actions go through the motion
+ * and action pools in exactly the order they were recorded.  Nobody
+ * needs to be connected; the actions go straight to their routines,
+ * since they were already checked when they were recorded.  Nothing
+ * waits on the clock, either, so the ticks go as fast as the pools
+ * can take them, and since each tick always goes the same way, so
+ * does the whole replay, every time.
+ *
+ * The recording also has everything from the config which changes
+ * how things move, like gravity and the shape of the zone and its
+ * sectors, which gets put back into the config before the zone is
+ * made, and the clock starts from wherever it was when the recording
+ * started.
+ *
+ * Things to do
+ *
+ */
+
+#ifndef __INC_REPLAY_H__
+#define __INC_REPLAY_H__
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "zone.h"
+#include "action_pool.h"
+#include "config_data.h"
+#include "motion_pool.h"
+
+class Replay
+{
+  private:
+    std::ifstream in;
+    Zone *zone;
+
+    /* What the recording's config said */
+    location size;
+    double gravity, gravity_theta;
+    double sleep_speed, sleep_spin, sleep_after;
+    std::string spatial_index, broadphase;
+    double octree_looseness;
+    int octree_min_depth, octree_max_depth, octree_leaf_objects;
+    bool octree_adaptive;
+
+  public:
+    unsigned int tick_rate;
+    uint64_t first_tick, first_nsec, ticks, actions;
+
+    Replay(const std::string&);
+    ~Replay();
+
+    void configure(config_data&);
+
+    size_t load(Zone *);
+    uint64_t run(ActionPool *, MotionPool *);
+};
+
+#endif /* __INC_REPLAY_H__ */
@@ -0,0 +1,94 @@
+/* sim_clock.cc
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * The implementation of the simulation clock.  Whatever time it was
+ * when the rate last changed is the base, and we count forward from
+ * there, either in ticks or on the monotonic clock.
+ *
+ * Things to do
+ *
+ */
+
+#include "sim_clock.h"
+
+const uint64_t SimClock::NSEC_PER_SEC = 1000000000ULL;
+
+std::mutex SimClock::rate_lock;
+std::atomic<uint64_t> SimClock::tick_count(0);
+std::atomic<uint64_t> SimClock::step_nsec(0);
+std::atomic<uint64_t> SimClock::base_nsec(0);
+std::atomic<uint64_t> SimClock::base_tick(0);
+std::chrono::steady_clock::time_point SimClock::base_time
+    = std::chrono::steady_clock::now();
+
+/* A rate of zero runs freely */
+void SimClock::set_rate(unsigned int rate)
+{
+    std::scoped_lock lock(SimClock::rate_lock);
+    uint64_t current = SimClock::now();
+
+    SimClock::base_nsec = current;
+    SimClock::base_tick = SimClock::tick_count.load();
+    SimClock::base_time = std::chrono::steady_clock::now();
+    SimClock::step_nsec = (rate > 0 ? SimClock::NSEC_PER_SEC / rate : 0);
+}
+
+/* Carry on from the given tick and time, at whatever the rate is */
+void SimClock::start_at(uint64_t tick, uint64_t nsec)
+{
+    std::scoped_lock lock(SimClock::rate_lock);
+
+    SimClock::tick_count = tick;
+    SimClock::base_tick = tick;
+    SimClock::base_nsec = nsec;
+    SimClock::base_time = std::chrono::steady_clock::now();
+}
+
+/* Returns the number of the tick which has just started */
+uint64_t SimClock::tick(void)
+{
+    return ++SimClock::tick_count;
+}
+
+uint64_t SimClock::ticks(void)
+{
+    return SimClock::tick_count;
+}
+
+uint64_t SimClock::now(void)
+{
+    uint64_t step = SimClock::step_nsec.load(std::memory_order_relaxed);
+
+    if (step > 0)
+        return SimClock::base_nsec.load(std::memory_order_relaxed)
+            + (SimClock::tick_count.load(std::memory_order_relaxed)
+               - SimClock::base_tick.load(std::memory_order_relaxed))
+            * step;
+    return SimClock::base_nsec.load(std::memory_order_relaxed)
+        + std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - SimClock::base_time).count();
+}
+
+/* An interval of simulation time, in seconds */
+double SimClock::seconds(uint64_t nsec)
+{
+    return (double)nsec / SimClock::NSEC_PER_SEC;
+}
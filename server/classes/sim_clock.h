@@ -0,0 +1,73 @@
+/* sim_clock.h                                             -*- C++ -*-
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * This file contains the declaration of the simulation clock, which
+ * everything in the server shares.  Simulation time is a count of
+ * nanoseconds, which only ever goes forward.
+ *
+ * Running freely, the clock follows the system's monotonic clock.
+ * With a tick rate, it doesn't move at all on its own; each tick
+ * moves it forward by exactly one timestep, so the time is nothing
+ * but the tick number times the timestep, no matter how long each
+ * tick really took.  Running the same ticks again gives exactly the
+ * same times.
+ *
+ * Changing the rate carries on from whatever the time is when it's
+ * changed, so the clock never goes backwards.  It's meant to be
+ * changed while nothing is moving, though.
+ *
+ * A replay can also set the tick and the time outright, so it starts
+ * from wherever its recording did; that's the only way the clock
+ * ever goes back.
+ *
+ * Things to do
+ *
+ */
+
+#ifndef __INC_SIM_CLOCK_H__
+#define __INC_SIM_CLOCK_H__
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+class SimClock
+{
+  public:
+    static const uint64_t NSEC_PER_SEC;
+
+  private:
+    static std::mutex rate_lock;
+    static std::atomic<uint64_t> tick_count, step_nsec;
+    static std::atomic<uint64_t> base_nsec, base_tick;
+    static std::chrono::steady_clock::time_point base_time;
+
+  public:
+    static void set_rate(unsigned int);
+    static void start_at(uint64_t, uint64_t);
+    static uint64_t tick(void);
+    static uint64_t ticks(void);
+    static uint64_t now(void);
+    static double seconds(uint64_t);
+};
+
+#endif /* __INC_SIM_CLOCK_H__ */
@@ -0,0 +1,281 @@
+/* spatial_index.cc
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * The parts of the spatial index which don't depend on how it's
+ * actually organized.
+ *
+ * Things to do
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include <glm/geometric.hpp>
+
+#include "spatial_index.h"
+
+SpatialIndex::shape_stats::shape_stats()
+    : nodes(), objects(), occupancy()
+{
+    this->min_depth = this->max_depth = 0;
+    this->queries = this->nodes_visited = this->objects_examined = 0;
+    this->node_rate = 0.0;
+}
+
+/* The direction doesn't have to be a unit vector; we'll make it one */
+SpatialIndex::ray::ray(const glm::dvec3& start,
+                       const glm::dvec3& toward,
+                       double dist,
+                       GameObject *skip)
+    : origin(start), dir(glm::normalize(toward))
+{
+    this->max_dist = dist;
+    this->hit = NULL;
+    this->ignore = skip;
+}
+
+/* Whether we pass through a box before max_dist, and if so, how far
+ * along we get before we're in it.  We start inside at distance 0.
+ */
+bool SpatialIndex::ray::enters(const glm::dvec3& lo,
+                               const glm::dvec3& hi,
+                               double& dist) const
+{
+    double near = 0.0, far = this->max_dist, t1, t2;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        if (this->dir[i] == 0.0)
+        {
+            if (this->origin[i] < lo[i] || this->origin[i] > hi[i])
+                return false;
+            continue;
+        }
+        t1 = (lo[i] - this->origin[i]) / this->dir[i];
+        t2 = (hi[i] - this->origin[i]) / this->dir[i];
+        if (t1 > t2)
+            std::swap(t1, t2);
+        near = std::max(near, t1);
+        far = std::min(far, t2);
+        if (near > far)
+            return false;
+    }
+    dist = near;
+    return true;
+}
+
+/* Whether we hit an object's bounding sphere nearer than anything
+ * we've hit so far.  If we do, it's our new hit.
+ */
+bool SpatialIndex::ray::hits(GameObject *go)
+{
+    glm::dvec3 m = this->origin - go->get_position();
+    double b = glm::dot(m, this->dir), disc, dist;
+    double c = glm::dot(m, m) - go->geometry->radius * go->geometry->radius;
+
+    /* Outside of it and heading away */
+    if (go == this->ignore || (c > 0.0 && b > 0.0))
+        return false;
+    if ((disc = b * b - c) < 0.0)
+        return false;
+    dist = std::max(-b - sqrt(disc), 0.0);
+    if (dist > this->max_dist
+        || (dist == this->max_dist && this->hit != NULL))
+        return false;
+    this->max_dist = dist;
+    this->hit = go;
+    return true;
+}
+
+SpatialIndex::SpatialIndex(const glm::dvec3& min, const glm::dvec3& max)
+    : min_point(min), max_point(max), count(0), max_radius(0.0),
+      center_of_mass((min + max) * 0.5)
+{
+    this->broadphase = NULL;
+    this->mass = 0.0;
+}
+
+SpatialIndex::~SpatialIndex()
+{
+    if (this->broadphase != NULL)
+        delete this->broadphase;
+}
+
+bool SpatialIndex::empty(void)
+{
+    return this->count == 0;
+}
+
+/* With no tree to speak of, we're one leaf holding everything */
+void SpatialIndex::describe(SpatialIndex::shape_stats& stats)
+{
+    stats.nodes.assign(1, 1);
+    stats.objects.assign(1, this->count);
+    stats.occupancy.clear();
+    stats.occupancy[this->count] = 1;
+    stats.node_rate = 0.0;
+}
+
+void SpatialIndex::retune(void)
+{
+}
+
+/* With no order to go in, the ray just has to try everything */
+void SpatialIndex::raycast(SpatialIndex::ray& r)
+{
+    this->for_each_object(
+        [&](GameObject *go) {
+            r.hits(go);
+            return true;
+        }
+    );
+}
+
+/* Everything's in one big node */
+void SpatialIndex::weigh(void)
+{
+    glm::dvec3 moment(0.0, 0.0, 0.0);
+    double total = 0.0;
+
+    this->for_each_object(
+        [&](GameObject *go) {
+            total += go->geometry->mass;
+            moment += go->get_position() * go->geometry->mass;
+            return true;
+        }
+    );
+    this->mass = total;
+    this->center_of_mass = (total > 0.0
+                            ? moment / total
+                            : (this->min_point + this->max_point) * 0.5);
+}
+
+/* The pull on the object, which is at the point, per unit of the
+ * gravitational constant.  The object doesn't pull on itself.
+ */
+glm::dvec3 SpatialIndex::pull(GameObject *go,
+                              const glm::dvec3& pt,
+                              double theta)
+{
+    glm::dvec3 size = this->max_point - this->min_point;
+    glm::dvec3 accel(0.0, 0.0, 0.0);
+
+    if (this->mass == 0.0)
+        return accel;
+    if ((pt.x < this->min_point.x || pt.x > this->max_point.x
+         || pt.y < this->min_point.y || pt.y > this->max_point.y
+         || pt.z < this->min_point.z || pt.z > this->max_point.z)
+        && SpatialIndex::distant(pt, std::max({size.x, size.y, size.z}),
+                                 this->center_of_mass, theta))
+        return SpatialIndex::attraction(pt, this->center_of_mass,
+                                        this->mass, 0.0);
+    this->for_each_object(
+        [&](GameObject *obj) {
+            if (obj != go)
+                accel += SpatialIndex::attraction(go, pt, obj);
+            return true;
+        }
+    );
+    return accel;
+}
+
+/* Whether something of the given size, with its mass centered at
+ * the given spot, is far enough away from the point to count as a
+ * single body.
+ */
+bool SpatialIndex::distant(const glm::dvec3& pt,
+                           double size,
+                           const glm::dvec3& center,
+                           double theta)
+{
+    glm::dvec3 d = center - pt;
+
+    return size * size < theta * theta * glm::dot(d, d);
+}
+
+/* How hard a mass pulls on a point, per unit of the gravitational
+ * constant.  Anything closer than the reach pulls as if it were at
+ * the reach.
+ */
+glm::dvec3 SpatialIndex::attraction(const glm::dvec3& pt,
+                                    const glm::dvec3& at,
+                                    double mass,
+                                    double reach)
+{
+    glm::dvec3 d = at - pt;
+    double r2 = std::max(glm::dot(d, d), reach * reach);
+
+    if (r2 == 0.0)
+        return glm::dvec3(0.0, 0.0, 0.0);
+    return d * (mass / (r2 * sqrt(r2)));
+}
+
+/* Objects pull on each other no harder than they do when touching */
+glm::dvec3 SpatialIndex::attraction(GameObject *go,
+                                    const glm::dvec3& pt,
+                                    GameObject *obj)
+{
+    return SpatialIndex::attraction(
+        pt, obj->get_position(), obj->geometry->mass,
+        go->geometry->radius + obj->geometry->radius);
+}
+
+/* The biggest radius only ever grows.  An object which grows after
+ * it's been put in isn't noticed until it's put in again.
+ */
+void SpatialIndex::grow_radius(GameObject *go)
+{
+    double radius = go->geometry->radius;
+    double current = this->max_radius.load(std::memory_order_relaxed);
+
+    while (radius > current
+           && !this->max_radius.compare_exchange_weak(
+               current, radius, std::memory_order_relaxed))
+        ;
+}
+
+/* Add an object to a max-heap of no more than k entries, keyed on
+ * squared distance, if it's nearer than the kth nearest so far.  An
+ * object which is moving might be seen twice, but only takes up one
+ * place.
+ */
+void SpatialIndex::keep_nearest(SpatialIndex::neighbor_list_t& best,
+                                size_t k,
+                                double dist2,
+                                GameObject *go)
+{
+    for (auto& i : best)
+        if (i.second == go)
+            return;
+    if (best.size() < k)
+    {
+        best.push_back(std::make_pair(dist2, go));
+        std::push_heap(best.begin(), best.end());
+    }
+    else if (dist2 < best.front().first)
+    {
+        std::pop_heap(best.begin(), best.end());
+        best.back() = std::make_pair(dist2, go);
+        std::push_heap(best.begin(), best.end());
+    }
+}
@@ -0,0 +1,198 @@
+/* spatial_index.h                                         -*- C++ -*-
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * This file contains the interface which the zone uses to keep track
+ * of where things are in each of its sectors.  There's more than one
+ * way to do it; the octree is the original, and the linear octree
+ * keeps everything in one sorted array.
+ *
+ * Visitors can't be virtual templates, so the visiting methods take
+ * a plain function and an argument pointer, and the templates here
+ * wrap up whatever callable the caller gives us.  That way nothing
+ * needs to be allocated to make the call.
+ *
+ * An index can carry a sweep-and-prune broadphase, which it keeps in
+ * step with everything that's inserted, removed or moved.  Whoever
+ * creates the index hangs the broadphase on it, and the index owns
+ * it from then on.
+ *
+ * An index can also describe its own shape - how many nodes and
+ * objects it has at each depth, and how full its leaves are - so the
+ * depth parameters can be tuned on a live server.  An index which
+ * doesn't have any depth to speak of just reports itself as one big
+ * leaf, and has nothing to retune.  A tree which recycles its nodes
+ * also says how fast it's been handing them out since it was last
+ * asked.
+ *
+ * Rays are cast against the objects' bounding spheres, which can
+ * stick out past the bounds of whatever holds their centers, so each
+ * index keeps track of the biggest radius it's been given.  An index
+ * which doesn't have any order to walk its objects in just tries the
+ * ray against all of them.
+ *
+ * For gravity, an index can be weighed, which works out the total
+ * mass and center of mass of everything in it, and then asked how
+ * hard it pulls on a point.  A tree does this Barnes-Hut style:  a
+ * node which looks small enough from the point, for the given
+ * opening angle, pulls as a single body at its center of mass, and
+ * anything nearer gets opened up.  An index without any nodes to
+ * keep masses in is one big node, which gets opened up, object by
+ * object, for anything close by.  Nothing pulls any harder than it
+ * would from touching distance, so things which overlap don't go
+ * flying off.
+ *
+ * Things to do
+ *
+ */
+
+#ifndef __INC_SPATIAL_INDEX_H__
+#define __INC_SPATIAL_INDEX_H__
+
+#include <cstdint>
+#include <atomic>
+#include <map>
+#include <set>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "game_obj.h"
+#include "sweep_prune.h"
+
+class SpatialIndex
+{
+  public:
+    typedef std::set<GameObject *> object_set_t;
+    typedef std::vector<GameObject *> object_list_t;
+    typedef std::vector<std::pair<double, GameObject *> > neighbor_list_t;
+    typedef bool (*visitor_t)(GameObject *, void *);
+
+    /* Node and object counts are by depth, and occupancy maps a
+     * number of objects to how many leaves hold that many.  The node
+     * rate is per second.
+     */
+    class shape_stats
+    {
+      public:
+        int min_depth, max_depth;
+        std::vector<size_t> nodes, objects;
+        std::map<size_t, size_t> occupancy;
+        uint64_t queries, nodes_visited, objects_examined;
+        double node_rate;
+
+        shape_stats();
+    };
+
+    /* A ray, and the nearest object it's hit so far.  Each new hit
+     * shortens max_dist to the distance of the hit, so casting the
+     * same ray into several indexes only finds things nearer than
+     * what it's already hit.  The object casting the ray can be left
+     * out.
+     */
+    class ray
+    {
+      public:
+        glm::dvec3 origin, dir;
+        double max_dist;
+        GameObject *hit, *ignore;
+
+        ray(const glm::dvec3&, const glm::dvec3&, double,
+            GameObject * = NULL);
+
+        bool enters(const glm::dvec3&, const glm::dvec3&, double&) const;
+        bool hits(GameObject *);
+    };
+    typedef std::vector<ray> ray_list_t;
+
+    glm::dvec3 min_point, max_point;
+    std::atomic<size_t> count;
+    std::atomic<double> max_radius;
+    SweepAndPrune *broadphase;
+
+    /* As of the last time we were weighed */
+    double mass;
+    glm::dvec3 center_of_mass;
+
+  protected:
+    static void keep_nearest(neighbor_list_t&, size_t, double, GameObject *);
+    static bool distant(const glm::dvec3&, double, const glm::dvec3&, double);
+    static glm::dvec3 attraction(const glm::dvec3&, const glm::dvec3&,
+                                 double, double);
+    static glm::dvec3 attraction(GameObject *, const glm::dvec3&,
+                                 GameObject *);
+    void grow_radius(GameObject *);
+
+  private:
+    template <typename F>
+    static bool call_visitor(GameObject *go, void *arg)
+        {
+            return (*(F *)arg)(go);
+        };
+
+  public:
+    SpatialIndex(const glm::dvec3&, const glm::dvec3&);
+    virtual ~SpatialIndex();
+
+    bool empty(void);
+
+    virtual void describe(shape_stats&);
+    virtual void retune(void);
+
+    virtual void build(const object_list_t&) = 0;
+    virtual void insert(GameObject *) = 0;
+    virtual bool remove(GameObject *, const glm::dvec3&) = 0;
+    virtual bool move(GameObject *, const glm::dvec3&) = 0;
+    virtual SpatialIndex *find(GameObject *) = 0;
+
+    virtual void range(const glm::dvec3&, double, object_list_t&) = 0;
+    virtual void nearest(const glm::dvec3&, size_t, double,
+                         neighbor_list_t&) = 0;
+    virtual void raycast(ray&);
+
+    virtual void weigh(void);
+    virtual glm::dvec3 pull(GameObject *, const glm::dvec3&, double);
+
+    /* The visitor returns false to stop early, and then so do we */
+    virtual bool visit(visitor_t, void *) = 0;
+    virtual bool visit_sphere(const glm::dvec3&, double,
+                              visitor_t, void *) = 0;
+
+    template <typename F>
+    bool for_each_object(F&& visit)
+        {
+            return this->visit(
+                &SpatialIndex::call_visitor<std::remove_reference_t<F> >,
+                (void *)&visit);
+        };
+
+    template <typename F>
+    bool for_each_in_sphere(const glm::dvec3& pt, double radius, F&& visit)
+        {
+            return this->visit_sphere(
+                pt, radius,
+                &SpatialIndex::call_visitor<std::remove_reference_t<F> >,
+                (void *)&visit);
+        };
+};
+
+#endif /* __INC_SPATIAL_INDEX_H__ */
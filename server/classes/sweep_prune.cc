@@ -0,0 +1,235 @@
+/* sweep_prune.cc
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * The implementation of the sweep-and-prune broadphase.
+ *
+ * Objects are found by the low end of their old x interval, which is
+ * computed exactly the same way every time, so a binary search gets
+ * us to the right run of the array.  A move updates the box in place
+ * and then swaps it along until the array is sorted again, which is
+ * usually no swaps at all.
+ *
+ * Things to do
+ *
+ */
+
+#include "sweep_prune.h"
+
+SweepAndPrune::SweepAndPrune()
+    : lock(), intervals()
+{
+    this->max_width = 0.0;
+}
+
+SweepAndPrune::~SweepAndPrune()
+{
+    this->intervals.clear();
+}
+
+bool SweepAndPrune::overlaps(const interval& a, const interval& b)
+{
+    return a.lo.x <= b.hi.x && b.lo.x <= a.hi.x
+        && a.lo.y <= b.hi.y && b.lo.y <= a.hi.y
+        && a.lo.z <= b.hi.z && b.lo.z <= a.hi.z;
+}
+
+SweepAndPrune::interval SweepAndPrune::bounds(GameObject *gobj,
+                                              const glm::dvec3& pos)
+{
+    glm::dvec3 r(gobj->geometry->radius);
+
+    return { pos - r, pos + r, gobj };
+}
+
+/* The caller must hold our lock. */
+std::vector<SweepAndPrune::interval>::iterator SweepAndPrune::find(
+    GameObject *gobj, double lo_x)
+{
+    auto i = std::lower_bound(
+        this->intervals.begin(), this->intervals.end(), lo_x,
+        [](const interval& a, double x) { return a.lo.x < x; }
+    );
+
+    for ( ; i != this->intervals.end() && i->lo.x == lo_x; ++i)
+        if (i->obj == gobj)
+            return i;
+
+    /* Not where we expected; its radius may have changed */
+    return std::find_if(this->intervals.begin(), this->intervals.end(),
+                        [&](const interval& a) { return a.obj == gobj; });
+}
+
+/* The first interval which could possibly overlap something starting
+ * at lo_x.  The caller must hold our lock.
+ */
+std::vector<SweepAndPrune::interval>::iterator SweepAndPrune::first_candidate(
+    double lo_x)
+{
+    return std::lower_bound(
+        this->intervals.begin(), this->intervals.end(),
+        lo_x - this->max_width,
+        [](const interval& a, double x) { return a.lo.x < x; }
+    );
+}
+
+size_t SweepAndPrune::size(void)
+{
+    std::shared_lock read_lock(this->lock);
+
+    return this->intervals.size();
+}
+
+void SweepAndPrune::build(const SweepAndPrune::object_list_t& objs)
+{
+    std::unique_lock write_lock(this->lock);
+
+    this->intervals.reserve(this->intervals.size() + objs.size());
+    for (auto i : objs)
+    {
+        this->intervals.push_back(this->bounds(i, i->get_position()));
+        this->max_width = std::max(this->max_width,
+                                   i->geometry->radius * 2.0);
+    }
+    std::sort(this->intervals.begin(), this->intervals.end(),
+              [](const interval& a, const interval& b)
+              {
+                  return a.lo.x < b.lo.x;
+              });
+}
+
+void SweepAndPrune::insert(GameObject *gobj)
+{
+    std::unique_lock write_lock(this->lock);
+    interval box = this->bounds(gobj, gobj->get_position());
+    auto i = std::upper_bound(
+        this->intervals.begin(), this->intervals.end(), box.lo.x,
+        [](double x, const interval& a) { return x < a.lo.x; }
+    );
+
+    this->max_width = std::max(this->max_width, box.hi.x - box.lo.x);
+    this->intervals.insert(i, box);
+}
+
+/* The position is where the object was when it was last inserted or
+ * moved, which is how we find its box.
+ */
+bool SweepAndPrune::remove(GameObject *gobj, const glm::dvec3& pos)
+{
+    std::unique_lock write_lock(this->lock);
+    auto i = this->find(gobj, this->bounds(gobj, pos).lo.x);
+
+    if (i == this->intervals.end())
+        return false;
+    this->intervals.erase(i);
+    return true;
+}
+
+/* The object has already moved from old_pos to its current position. */
+bool SweepAndPrune::move(GameObject *gobj, const glm::dvec3& old_pos)
+{
+    std::unique_lock write_lock(this->lock);
+    auto i = this->find(gobj, this->bounds(gobj, old_pos).lo.x);
+
+    if (i == this->intervals.end())
+        return false;
+    *i = this->bounds(gobj, gobj->get_position());
+
+    while (i != this->intervals.begin() && (i - 1)->lo.x > i->lo.x)
+    {
+        std::iter_swap(i - 1, i);
+        --i;
+    }
+    while (i + 1 != this->intervals.end() && (i + 1)->lo.x < i->lo.x)
+    {
+        std::iter_swap(i, i + 1);
+        ++i;
+    }
+    return true;
+}
+
+/* Every pair of objects whose boxes overlap, each pair only once. */
+void SweepAndPrune::pairs(SweepAndPrune::pair_list_t& result)
+{
+    std::shared_lock read_lock(this->lock);
+
+    for (auto i = this->intervals.begin(); i != this->intervals.end(); ++i)
+        for (auto j = i + 1;
+             j != this->intervals.end() && j->lo.x <= i->hi.x;
+             ++j)
+            if (SweepAndPrune::overlaps(*i, *j))
+                result.push_back(std::make_pair(i->obj, j->obj));
+}
+
+/* Every overlapping pair with at least one of the moved objects in
+ * it, each pair only once, with a moved object first.  The moved
+ * objects' boxes cover their whole last move.  The moved list gets
+ * sorted.
+ */
+void SweepAndPrune::swept_pairs(SweepAndPrune::object_list_t& moved,
+                                SweepAndPrune::pair_list_t& result)
+{
+    std::vector<std::pair<interval, bool> > boxes;
+    auto moving = [&](GameObject *go) {
+        return std::binary_search(moved.begin(), moved.end(), go);
+    };
+
+    std::sort(moved.begin(), moved.end());
+    {
+        std::shared_lock read_lock(this->lock);
+
+        boxes.reserve(this->intervals.size());
+        for (auto& i : this->intervals)
+            boxes.push_back(std::make_pair(i, moving(i.obj)));
+    }
+    for (auto& i : boxes)
+        if (i.second)
+        {
+            glm::dvec3 from, to;
+
+            i.first.obj->get_path(from, to);
+
+            interval start = this->bounds(i.first.obj, from);
+            interval end = this->bounds(i.first.obj, to);
+
+            i.first.lo = glm::min(start.lo, end.lo);
+            i.first.hi = glm::max(start.hi, end.hi);
+        }
+    std::sort(boxes.begin(), boxes.end(),
+              [](const std::pair<interval, bool>& a,
+                 const std::pair<interval, bool>& b)
+              {
+                  return a.first.lo.x < b.first.lo.x;
+              });
+    for (auto i = boxes.begin(); i != boxes.end(); ++i)
+        for (auto j = i + 1;
+             j != boxes.end() && j->first.lo.x <= i->first.hi.x;
+             ++j)
+            if ((i->second || j->second)
+                && SweepAndPrune::overlaps(i->first, j->first))
+            {
+                if (i->second)
+                    result.push_back(std::make_pair(i->first.obj,
+                                                    j->first.obj));
+                else
+                    result.push_back(std::make_pair(j->first.obj,
+                                                    i->first.obj));
+            }
+}
@@ -0,0 +1,129 @@
+/* sweep_prune.h                                           -*- C++ -*-
+ *   by Trinity Quirk <tquirk@ymb.net>
+ *
+ * Revision IX game server
+ * Copyright (C) 2026  Trinity Annabelle Quirk
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *
+ * This file contains the declaration of the sweep-and-prune
+ * broadphase, an alternative to the octree for finding out which
+ * objects might be colliding.
+ *
+ * Each object's bounding box is kept in an array sorted by the low
+ * end of its x interval.  Since objects only move a little bit each
+ * tick, a moved object only has to shuffle past a few of its
+ * neighbours to keep the array sorted.  Anything which might overlap
+ * an object on the x axis is in a contiguous run of the array, and we
+ * only have to check the y and z intervals of the boxes in that run.
+ *
+ * A sweep over the whole array produces every overlapping pair at
+ * once.  A single object's candidates start at most one box width
+ * (of the widest box we hold) before its own low end.
+ *
+ * In tick mode, the motion pool sweeps each sector once per tick, for
+ * every pair which has at least one object that moved in it.  The
+ * boxes of the objects which moved cover their whole last move, just
+ * like a single object's candidates do, so fast movers don't skip
+ * through anything.
+ *
+ * Things to do
+ *
+ */
+
+#ifndef __INC_SWEEP_PRUNE_H__
+#define __INC_SWEEP_PRUNE_H__
+
+#include <algorithm>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/common.hpp>
+
+#include "game_obj.h"
+
+class SweepAndPrune
+{
+  public:
+    typedef std::vector<GameObject *> object_list_t;
+    typedef std::vector<std::pair<GameObject *, GameObject *> > pair_list_t;
+
+    typedef struct interval_tag
+    {
+        glm::dvec3 lo, hi;
+        GameObject *obj;
+    }
+    interval;
+
+  private:
+    std::shared_mutex lock;
+    std::vector<interval> intervals;
+    double max_width;
+
+    static bool overlaps(const interval&, const interval&);
+    interval bounds(GameObject *, const glm::dvec3&);
+    std::vector<interval>::iterator find(GameObject *, double);
+    std::vector<interval>::iterator first_candidate(double);
+
+  public:
+    SweepAndPrune();
+    ~SweepAndPrune();
+
+    size_t size(void);
+
+    void build(const object_list_t&);
+    void insert(GameObject *);
+    bool remove(GameObject *, const glm::dvec3&);
+    bool move(GameObject *, const glm::dvec3&);
+
+    void pairs(pair_list_t&);
+    void swept_pairs(object_list_t&, pair_list_t&);
+
+    /* Call the visitor on each object whose box overlaps the given
+     * object's, while holding our read lock.  The object itself is
+     * not included.  The visitor returns false to stop early.
+     *
+     * The box we check against covers the object's whole last move,
+     * so a fast mover sees everything it might have passed through.
+     */
+    template <typename F>
+    bool for_each_candidate(GameObject *gobj, F&& visit)
+        {
+            std::shared_lock read_lock(this->lock);
+            glm::dvec3 from, to;
+
+            gobj->get_path(from, to);
+
+            interval box = this->bounds(gobj, to);
+            interval start = this->bounds(gobj, from);
+
+            box.lo = glm::min(box.lo, start.lo);
+            box.hi = glm::max(box.hi, start.hi);
+
+            for (auto i = this->first_candidate(box.lo.x);
+                 i != this->intervals.end() && i->lo.x <= box.hi.x;
+                 ++i)
+                if (i->obj != gobj
+                    && SweepAndPrune::overlaps(*i, box)
+                    && !visit(i->obj))
+                    return false;
+            return true;
+        };
+};
+
+#endif /* __INC_SWEEP_PRUNE_H__ */
@@ -31,7 +31,16 @@
 #include <glob.h>
 #include <errno.h>
 
+#include <algorithm>
+#include <sstream>
+#include <thread>
+#include <system_error>
+
+#include <glm/common.hpp>
+
 #include "zone.h"
+#include "octree.h"
+#include "linear_octree.h"
 #include "thread_pool.h"
 #include "config_data.h"
 #include "log.h"
@@ -39,51 +48,100 @@
 
 void Zone::init(DB *database)
 {
-    int i, j, k;
-    std::vector<Octree *> z_row;
-    std::vector<std::vector<Octree *> > y_row;
+    size_t count = (size_t)this->x_steps * this->y_steps * this->z_steps;
 
-    database->get_server_objects(this->game_objects);
+    /* Without a database, somebody else fills us in later */
+    if (database != NULL)
+        database->get_server_objects(this->game_objects);
     std::clog << syslogNotice << "loaded " << this->game_objects.size()
               << " objects" << std::endl;
     std::clog << syslogNotice << "creating " << this->x_steps << 'x'
               << this->y_steps << 'x' << this->z_steps << " elements"
               << std::endl;
-    z_row.reserve(this->z_steps);
-    for (i = 0; i < this->z_steps; ++i)
-        z_row.push_back(NULL);
-    y_row.reserve(this->y_steps);
-    for (i = 0; i < this->y_steps; ++i)
-        y_row.push_back(z_row);
-    this->sectors.reserve(x_steps);
-    for (i = 0; i < this->x_steps; ++i)
-        this->sectors.push_back(y_row);
-
-    /* If we have any memory problems in creating the octree roots, it
-     * will be best to happen upon creation, so the blowups can cause
-     * the zone to not construct.
+
+    /* Sector roots get created as things are put into them, so the
+     * only thing which could blow up here is the index itself.
      */
-    for (i = 0; i < this->x_steps; ++i)
-        for (j = 0; j < this->y_steps; ++j)
-            for (k = 0; k < this->z_steps; ++k)
+    this->sectors = std::vector<std::atomic<SpatialIndex *> >(count);
+    this->build_sectors();
+}
+
+/* Put everything we've loaded into its sector.  The objects get
+ * sorted by sector, and each sector's tree is built in one go, with
+ * the sectors spread out over as many threads as we have cores.
+ * Nobody else can see the zone until we're done, so the trees don't
+ * need any locking while they're built.
+ */
+void Zone::build_sectors(void)
+{
+    std::vector<std::pair<size_t, GameObject *> > placed;
+    std::vector<size_t> runs;
+    std::vector<std::thread> builders;
+    std::atomic<size_t> next(0);
+    unsigned int threads = std::max(std::thread::hardware_concurrency(), 1u);
+    size_t i;
+
+    placed.reserve(this->game_objects.size());
+    for (auto& go : this->game_objects)
+    {
+        glm::ivec3 sec = this->which_sector(go.second->get_position());
+
+        if (sec.x >= 0 && sec.x < this->x_steps
+            && sec.y >= 0 && sec.y < this->y_steps
+            && sec.z >= 0 && sec.z < this->z_steps)
+            placed.push_back(std::make_pair(
+                this->sector_index(sec.x, sec.y, sec.z), go.second));
+    }
+    std::sort(placed.begin(), placed.end());
+
+    /* Where each sector's objects start, and where the last one ends */
+    for (i = 0; i < placed.size(); ++i)
+        if (i == 0 || placed[i].first != placed[i - 1].first)
+            runs.push_back(i);
+    runs.push_back(placed.size());
+
+    auto build = [&](void)
+        {
+            size_t run, j;
+
+            while ((run = next++) < runs.size() - 1)
             {
-                glm::dvec3 mn, mx;
-
-                mn.x = i * this->x_dim;
-                mn.y = j * this->y_dim;
-                mn.z = k * this->z_dim;
-                mx.x = mn.x + this->x_dim;
-                mx.y = mn.y + this->y_dim;
-                mx.z = mn.z + this->z_dim;
-                this->sectors[i][j][k] = new Octree(NULL, mn, mx, 0);
+                size_t idx = placed[runs[run]].first;
+                glm::ivec3 sec(idx / ((size_t)this->y_steps * this->z_steps),
+                               idx / this->z_steps % this->y_steps,
+                               idx % this->z_steps);
+                SpatialIndex::object_list_t objs;
+
+                objs.reserve(runs[run + 1] - runs[run]);
+                for (j = runs[run]; j < runs[run + 1]; ++j)
+                    objs.push_back(placed[j].second);
+                this->create_sector(idx, sec)->build(objs);
             }
+        };
 
-    for (auto& go : this->game_objects)
-        this->sector_contains(go.second->get_position())->insert(go.second);
+    threads = std::min<size_t>(threads, runs.size() - 1);
+    try
+    {
+        while (builders.size() + 1 < threads)
+            builders.push_back(std::thread(build));
+    }
+    catch (std::system_error& e)
+    {
+        std::clog << syslogWarn << "couldn't start sector builder: "
+                  << e.code().message() << " (" << e.code().value() << ")"
+                  << std::endl;
+    }
+    build();
+    for (auto& t : builders)
+        t.join();
+
+    std::clog << syslogNotice << "built " << runs.size() - 1
+              << " sectors with " << builders.size() + 1 << " threads"
+              << std::endl;
 }
 
 Zone::Zone(uint64_t dim, uint16_t steps, DB *database)
-    : sectors(), game_objects()
+    : sectors(), live_lock(), live_sectors(), game_objects(), sector_lock()
 {
     this->x_dim = this->y_dim = this->z_dim = dim;
     this->x_steps = this->y_steps = this->z_steps = steps;
@@ -92,7 +150,7 @@ Zone::Zone(uint64_t dim, uint16_t steps, DB *database)
 
 Zone::Zone(uint64_t xd, uint64_t yd, uint64_t zd,
            uint16_t xs, uint16_t ys, uint16_t zs, DB *database)
-    : sectors(), game_objects()
+    : sectors(), live_lock(), live_sectors(), game_objects(), sector_lock()
 {
     this->x_dim = xd;
     this->y_dim = yd;
@@ -105,13 +163,9 @@ Zone::Zone(uint64_t xd, uint64_t yd, uint64_t zd,
 
 Zone::~Zone()
 {
-    int i, j, k;
-
-    for (i = 0; i < this->x_steps; ++i)
-        for (j = 0; j < this->y_steps; ++j)
-            for (k = 0; k < this->z_steps; ++k)
-                if (this->sectors[i][j][k] != NULL)
-                    delete this->sectors[i][j][k];
+    for (auto i : this->live_sectors)
+        if (this->sectors[i] != NULL)
+            delete this->sectors[i];
 
     if (this->game_objects.size())
     {
@@ -125,26 +179,482 @@ Zone::~Zone()
     }
 }
 
-Octree *Zone::sector_contains(const glm::dvec3& pos)
+size_t Zone::sector_index(int x, int y, int z)
+{
+    return ((size_t)x * this->y_steps + y) * this->z_steps + z;
+}
+
+/* Make a new root for a sector.  If someone else beats us to it, we
+ * use theirs instead.
+ */
+SpatialIndex *Zone::create_sector(size_t idx, const glm::ivec3& sec)
+{
+    glm::dvec3 mn, mx;
+    SpatialIndex *sector, *expected = NULL;
+
+    mn.x = sec.x * this->x_dim;
+    mn.y = sec.y * this->y_dim;
+    mn.z = sec.z * this->z_dim;
+    mx.x = mn.x + this->x_dim;
+    mx.y = mn.y + this->y_dim;
+    mx.z = mn.z + this->z_dim;
+    if (config.spatial_index == "linear")
+        sector = new LinearOctree(mn, mx);
+    else
+    {
+        Octree *tree = new Octree(NULL, mn, mx, 0, config.octree_looseness);
+
+        tree->set_shape(config.octree_min_depth, config.octree_max_depth,
+                        config.octree_leaf_objects, config.octree_adaptive);
+        sector = tree;
+    }
+    if (config.broadphase == "sap")
+        sector->broadphase = new SweepAndPrune();
+
+    if (!this->sectors[idx].compare_exchange_strong(expected, sector))
+    {
+        delete sector;
+        return expected;
+    }
+
+    std::scoped_lock lock(this->live_lock);
+    this->live_sectors.push_back(idx);
+    return sector;
+}
+
+/* The sector a point is in, which is created if it doesn't exist
+ * yet, or NULL if the point isn't in this zone.
+ */
+SpatialIndex *Zone::sector_contains(const glm::dvec3& pos)
 {
     glm::ivec3 sec = this->which_sector(pos);
+    size_t idx;
+    SpatialIndex *sector;
 
-    if (sec[0] < 0 || sec[0] >= x_steps
-        || sec[1] < 0 || sec[1] >= y_steps
-        || sec[2] < 0 || sec[2] >= z_steps)
+    if (!this->in_zone(sec))
         return NULL;
 
-    return this->sectors[sec[0]][sec[1]][sec[2]];
+    idx = this->sector_index(sec[0], sec[1], sec[2]);
+    if ((sector = this->sectors[idx]) == NULL)
+        sector = this->create_sector(idx, sec);
+    return sector;
+}
+
+/* The sector a point is in, only if it already exists.  Nothing gets
+ * created, so this is safe anywhere, like in the middle of a tick;
+ * only the handoffs make new sectors.
+ */
+SpatialIndex *Zone::sector_at(const glm::dvec3& pos)
+{
+    glm::ivec3 sec = this->which_sector(pos);
+
+    if (!this->in_zone(sec))
+        return NULL;
+    return this->sectors[this->sector_index(sec[0], sec[1], sec[2])];
+}
+
+bool Zone::in_zone(const glm::ivec3& sec)
+{
+    return sec[0] >= 0 && sec[0] < this->x_steps
+        && sec[1] >= 0 && sec[1] < this->y_steps
+        && sec[2] >= 0 && sec[2] < this->z_steps;
 }
 
 glm::ivec3 Zone::which_sector(const glm::dvec3& pos)
 {
-    glm::ivec3 sector;
+    glm::dvec3 dim(this->x_dim, this->y_dim, this->z_dim);
 
-    sector.x = pos.x / this->x_dim;
-    sector.y = pos.y / this->y_dim;
-    sector.z = pos.z / this->z_dim;
-    return sector;
+    /* Rounding toward zero would put anything just below zero in
+     * the first sector.
+     */
+    return glm::ivec3(glm::floor(pos / dim));
+}
+
+size_t Zone::sector_count(void)
+{
+    std::scoped_lock lock(this->live_lock);
+    return this->live_sectors.size();
+}
+
+/* Get rid of the roots of any sectors which have nothing in them.
+ * Nobody else can be using any sectors while we do it.
+ */
+size_t Zone::release_empty_sectors(void)
+{
+    std::unique_lock sectors_lock(this->sector_lock);
+    std::scoped_lock lock(this->live_lock);
+    size_t released = 0;
+
+    for (auto i = this->live_sectors.begin(); i != this->live_sectors.end(); )
+    {
+        SpatialIndex *sector = this->sectors[*i];
+
+        if (sector->empty())
+        {
+            this->sectors[*i] = NULL;
+            delete sector;
+            *i = this->live_sectors.back();
+            this->live_sectors.pop_back();
+            ++released;
+        }
+        else
+            ++i;
+    }
+    return released;
+}
+
+/* Let each sector reshape itself, if it's adaptive */
+void Zone::tune_sectors(void)
+{
+    std::shared_lock sectors_lock(this->sector_lock);
+    std::vector<size_t> live;
+
+    {
+        std::scoped_lock lock(this->live_lock);
+
+        live = this->live_sectors;
+    }
+    for (auto i : live)
+        this->sectors[i].load()->retune();
+}
+
+/* A description of every sector's shape, with node and object counts
+ * by depth, and how many leaves hold how many objects.  Queries are
+ * what's been done since the sector last retuned, and node rates are
+ * since the last report.
+ */
+std::string Zone::sector_report(void)
+{
+    std::shared_lock sectors_lock(this->sector_lock);
+    std::ostringstream s, total;
+    std::vector<size_t> live;
+    SpatialIndex::shape_stats stats;
+    size_t awake, asleep, still;
+    double node_rate = 0.0;
+
+    /* Nothing can be released while we hold the sector lock, so we
+     * only need the live list long enough to copy it.
+     */
+    {
+        std::scoped_lock lock(this->live_lock);
+
+        live = this->live_sectors;
+    }
+    std::sort(live.begin(), live.end());
+    for (auto i : live)
+    {
+        SpatialIndex *sector = this->sectors[i];
+        size_t z = i % this->z_steps, y = i / this->z_steps % this->y_steps;
+        size_t x = i / this->z_steps / this->y_steps;
+
+        awake = asleep = still = 0;
+        sector->for_each_object(
+            [&](GameObject *go) {
+                if (go->still_moving())
+                    ++awake;
+                else if (go->asleep())
+                    ++asleep;
+                else
+                    ++still;
+                return true;
+            }
+        );
+        sector->describe(stats);
+        s << std::endl << "sector " << x << ',' << y << ',' << z << ": "
+          << sector->count << " objects (" << awake << " awake, "
+          << asleep << " sleeping, " << still << " still), depth "
+          << stats.min_depth << '-' << stats.max_depth;
+        if (stats.queries > 0)
+            s << ", " << stats.queries << " queries, "
+              << (double)stats.nodes_visited / stats.queries
+              << " nodes and "
+              << (double)stats.objects_examined / stats.queries
+              << " objects each";
+        s << ", " << stats.node_rate << " nodes/s";
+        node_rate += stats.node_rate;
+        s << std::endl << "  nodes:";
+        for (auto n : stats.nodes)
+            s << ' ' << n;
+        s << std::endl << "  objects:";
+        for (auto n : stats.objects)
+            s << ' ' << n;
+        s << std::endl << "  occupancy:";
+        for (auto& n : stats.occupancy)
+            s << ' ' << n.first << ':' << n.second;
+    }
+    total << live.size() << " sectors, " << node_rate << " nodes/s"
+          << s.str();
+    return total.str();
+}
+
+/* The sector a point is in, or the nearest one if it's outside */
+glm::ivec3 Zone::clamp_sector(const glm::dvec3& pos)
+{
+    glm::ivec3 mx(this->x_steps - 1, this->y_steps - 1, this->z_steps - 1);
+
+    return glm::clamp(this->which_sector(pos), glm::ivec3(0, 0, 0), mx);
+}
+
+/* The nearest point to pos which is inside the zone */
+glm::dvec3 Zone::clamp_position(const glm::dvec3& pos)
+{
+    glm::dvec3 mx((double)this->x_steps * this->x_dim,
+                  (double)this->y_steps * this->y_dim,
+                  (double)this->z_steps * this->z_dim);
+    glm::dvec3 p = glm::clamp(pos, glm::dvec3(0.0, 0.0, 0.0), mx);
+
+    /* The far edges belong to the next sector over, which isn't here */
+    for (int i = 0; i < 3; ++i)
+        if (p[i] >= mx[i])
+            p[i] = nextafter(mx[i], 0.0);
+    return p;
+}
+
+/* Put objects which have been taken out of their old sectors into
+ * their new ones.  We sort them by destination, and do one sector at
+ * a time, so we never hold more than one sector's locks.  Within a
+ * sector they go in by ID, so the sector ends up the same however
+ * they were handed to us.  There are no neighboring servers to pass
+ * things to yet, so anything headed out of the zone gets stopped at
+ * the edge.  The caller must hold the sector lock.
+ */
+void Zone::hand_off(SpatialIndex::object_list_t& objs)
+{
+    std::vector<std::pair<size_t, GameObject *> > dest;
+
+    dest.reserve(objs.size());
+    for (auto go : objs)
+    {
+        glm::ivec3 sec = this->which_sector(go->get_position());
+
+        if (!this->in_zone(sec))
+        {
+            go->set_position(this->clamp_position(go->get_position()));
+            go->set_movement(glm::dvec3(0.0, 0.0, 0.0));
+            sec = this->which_sector(go->get_position());
+        }
+        dest.push_back(std::make_pair(
+                           this->sector_index(sec[0], sec[1], sec[2]), go));
+    }
+
+    std::sort(dest.begin(), dest.end(),
+              [](const std::pair<size_t, GameObject *>& a,
+                 const std::pair<size_t, GameObject *>& b) {
+                  if (a.first != b.first)
+                      return a.first < b.first;
+                  return a.second->get_object_id()
+                      < b.second->get_object_id();
+              });
+    for (auto& i : dest)
+        this->sector_contains(i.second->get_position())->insert(i.second);
+}
+
+/* Everything pulls on everything else, with the strength of the
+ * given gravitational constant, for the given interval.  The sectors
+ * are weighed first, and then each object's pull from all of them is
+ * worked out, a block of objects at a time, spread out however the
+ * caller likes; without a spreader, we just do all the blocks
+ * ourselves.  Each object's pulls are added up in order of the
+ * sectors' indexes, and none of the movements are changed until all
+ * the pulls are known, so nothing depends on which thread did what.
+ * Anything asleep which is pulled too gently to matter is left
+ * asleep.  The caller must hold the sector lock.  Returns how many
+ * objects were pulled.
+ */
+size_t Zone::gravitate(double g, double theta, double interval,
+                       const Zone::spread_t& spread)
+{
+    const size_t BLOCK = 1024;
+    std::vector<size_t> indexes;
+    std::vector<SpatialIndex *> live;
+    SpatialIndex::object_list_t objs;
+    std::vector<glm::dvec3> accel;
+    size_t blocks, pulled = 0;
+
+    {
+        std::scoped_lock lock(this->live_lock);
+
+        indexes = this->live_sectors;
+    }
+    std::sort(indexes.begin(), indexes.end());
+    for (auto i : indexes)
+        live.push_back(this->sectors[i]);
+    for (auto sector : live)
+    {
+        sector->weigh();
+        sector->for_each_object(
+            [&](GameObject *go) {
+                objs.push_back(go);
+                return true;
+            }
+        );
+    }
+    accel.resize(objs.size());
+
+    auto pull = [&](size_t block)
+        {
+            size_t i, end = std::min((block + 1) * BLOCK, objs.size());
+
+            for (i = block * BLOCK; i < end; ++i)
+            {
+                glm::dvec3 pos = objs[i]->get_position();
+
+                accel[i] = glm::dvec3(0.0, 0.0, 0.0);
+                for (auto sector : live)
+                    accel[i] += sector->pull(objs[i], pos, theta);
+            }
+        };
+
+    blocks = (objs.size() + BLOCK - 1) / BLOCK;
+    if (spread)
+        spread(blocks, pull);
+    else
+        for (size_t b = 0; b < blocks; ++b)
+            pull(b);
+
+    for (size_t i = 0; i < objs.size(); ++i)
+        if (accel[i] != glm::dvec3(0.0, 0.0, 0.0)
+            && objs[i]->accelerate(accel[i] * g * interval))
+            ++pulled;
+    return pulled;
+}
+
+/* Every object whose center is within radius of the point, from all
+ * the sectors the sphere reaches into.
+ */
+void Zone::objects_in_range(const glm::dvec3& pt,
+                            double radius,
+                            SpatialIndex::object_list_t& result)
+{
+    glm::dvec3 r(radius, radius, radius);
+    glm::ivec3 lo = this->clamp_sector(pt - r);
+    glm::ivec3 hi = this->clamp_sector(pt + r);
+    std::shared_lock lock(this->sector_lock);
+    size_t start = result.size();
+    int i, j, k;
+
+    for (i = lo.x; i <= hi.x; ++i)
+        for (j = lo.y; j <= hi.y; ++j)
+            for (k = lo.z; k <= hi.z; ++k)
+            {
+                SpatialIndex *sector
+                    = this->sectors[this->sector_index(i, j, k)];
+
+                if (sector != NULL)
+                    sector->range(pt, radius, result);
+            }
+
+    /* Something moving while we looked might have turned up twice */
+    std::sort(result.begin() + start, result.end());
+    result.erase(std::unique(result.begin() + start, result.end()),
+                 result.end());
+}
+
+/* The k objects nearest to the point, and no further than max_dist,
+ * nearest first.  We search outward one shell of sectors at a time.
+ * Everything in shell n is at least n - 1 sectors' width away, so
+ * once that's further than the kth nearest object we've found, we
+ * can stop.
+ */
+void Zone::nearest_objects(const glm::dvec3& pt,
+                           size_t k,
+                           double max_dist,
+                           SpatialIndex::object_list_t& result)
+{
+    SpatialIndex::neighbor_list_t best;
+    glm::ivec3 c = this->clamp_sector(pt), lo, hi;
+    double width = std::min({this->x_dim, this->y_dim, this->z_dim});
+    int shells = std::max({this->x_steps, this->y_steps, this->z_steps});
+    std::shared_lock lock(this->sector_lock);
+    int n, i, j, l;
+
+    for (n = 0; n < shells; ++n)
+    {
+        double bound = (n - 1) * width;
+
+        if (n > 1
+            && (bound > max_dist
+                || (best.size() == k && bound * bound >= best.front().first)))
+            break;
+
+        lo = glm::max(c - n, glm::ivec3(0, 0, 0));
+        hi = glm::min(c + n, glm::ivec3(this->x_steps - 1,
+                                        this->y_steps - 1,
+                                        this->z_steps - 1));
+        for (i = lo.x; i <= hi.x; ++i)
+            for (j = lo.y; j <= hi.y; ++j)
+                for (l = lo.z; l <= hi.z; ++l)
+                {
+                    SpatialIndex *sector
+                        = this->sectors[this->sector_index(i, j, l)];
+
+                    if (sector != NULL
+                        && std::max({abs(i - c.x), abs(j - c.y),
+                                     abs(l - c.z)}) == n)
+                        sector->nearest(pt, k, max_dist, best);
+                }
+    }
+
+    std::sort_heap(best.begin(), best.end());
+    for (auto& i : best)
+        result.push_back(i.second);
+}
+
+/* The first object along a ray, no further than max_dist away,
+ * leaving out the object doing the looking.
+ */
+GameObject *Zone::raycast(const glm::dvec3& origin,
+                          const glm::dvec3& dir,
+                          double max_dist,
+                          GameObject *ignore)
+{
+    SpatialIndex::ray_list_t rays;
+
+    rays.push_back(SpatialIndex::ray(origin, dir, max_dist, ignore));
+    this->raycast(rays);
+    return rays.front().hit;
+}
+
+/* Cast a whole batch of rays, for anybody who needs to look in a lot
+ * of directions at once.  We only have to find the live sectors once
+ * for all of them.  Each ray tries the sectors it passes through -
+ * padded by the biggest object in each - in the order it reaches
+ * them, and stops once the next one starts beyond what it's already
+ * hit.
+ */
+void Zone::raycast(SpatialIndex::ray_list_t& rays)
+{
+    std::vector<std::pair<double, SpatialIndex *> > order;
+    std::vector<SpatialIndex *> live;
+    std::shared_lock lock(this->sector_lock);
+    double dist;
+
+    {
+        std::scoped_lock hold_live(this->live_lock);
+
+        for (auto i : this->live_sectors)
+            live.push_back(this->sectors[i]);
+    }
+
+    for (auto& r : rays)
+    {
+        order.clear();
+        for (auto sector : live)
+        {
+            double pad = sector->max_radius;
+
+            if (r.enters(sector->min_point - pad, sector->max_point + pad,
+                         dist))
+                order.push_back(std::make_pair(dist, sector));
+        }
+        std::sort(order.begin(), order.end());
+        for (auto& i : order)
+        {
+            if (i.first > r.max_dist)
+                break;
+            i.second->raycast(r);
+        }
+    }
 }
 
 GameObject *Zone::find_game_object(uint64_t objid)
@@ -157,6 +667,8 @@ GameObject *Zone::find_game_object(uint64_t objid)
         go = new GameObject(NULL, NULL, objid);
         this->game_objects[objid] = go;
         go->set_position(glm::dvec3(0.0, 0.0, 0.0));
+
+        std::shared_lock lock(this->sector_lock);
         this->sector_contains(go->get_position())->insert(go);
     }
     else
@@ -168,14 +680,13 @@ GameObject *Zone::find_game_object(uint64_t objid)
 void Zone::send_nearby_objects(uint64_t objid)
 {
     GameObject *go = this->find_game_object(objid);
+    SpatialIndex::object_list_t nearby;
 
     update_pool->push(go);
 
     /* Send updates on all objects within visual range */
-    for (auto& gi : this->game_objects)
-    {
-        if (gi.second != go
-            && go->distance_from(gi.second->get_position()) < 1000.0)
-            update_pool->push(gi.second);
-    }
+    this->objects_in_range(go->get_position(), 1000.0, nearby);
+    for (auto i : nearby)
+        if (i != go)
+            update_pool->push(i);
 }
@@ -32,6 +32,39 @@
  * Plus, if we have geometry updates (people blowing up dynamite and
  * such, heh), it'll be easier and faster to tell people what happened.
  *
+ * The sectors are kept in one flat array, and a sector's octree is
+ * only created when something needs to go into it.  Empty sectors
+ * can be released again, but since other threads may be holding on
+ * to a sector, anyone who uses one must hold the sector lock (shared)
+ * while doing so.  Releasing takes it exclusively.
+ * Only putting things into sectors, and handing them off from one to
+ * another, creates a sector; the motion tick only ever looks up the
+ * ones which are already there.
+ *
+ * Each sector can be indexed by either a pointer octree or a linear
+ * octree; the config file decides which, and the rest of the zone
+ * doesn't care.
+ *
+ * Everything loaded from the database at startup is sorted into
+ * sectors first, and the sectors' trees are all built at once, in
+ * parallel, before the zone is handed over to anybody else.
+ *
+ * Every so often, each sector gets the chance to retune its index,
+ * and the console can ask for a report of how they're all shaped,
+ * and how many of the objects in each are awake, how many the
+ * motion state put to sleep, and how many were never moving at all.
+ *
+ * Range and nearest-neighbor queries look in every sector they could
+ * possibly reach, so callers don't need to care where the sector
+ * boundaries are.  So do rays, which try the sectors they pass
+ * through in the order they reach them.
+ *
+ * Gravity, when there is any, works across all the sectors:  each
+ * sector's index adds up its own masses, and every object feels the
+ * pull of every sector, Barnes-Hut style.  The sectors' pulls are
+ * always added up in order of their place in the zone, so the same
+ * objects in the same places always get exactly the same pulls.
+ *
  * Things to do
  *
  */
@@ -40,10 +73,15 @@
 #define __INC_ZONE_H__
 
 #include <cstdint>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
 #include <vector>
 #include <map>
 
-#include "octree.h"
+#include "spatial_index.h"
 
 #include "modules/db.h"
 
@@ -53,21 +91,53 @@ class Zone
     uint16_t x_steps, y_steps, z_steps;
     uint64_t x_dim, y_dim, z_dim;
 
-    std::vector< std::vector< std::vector<Octree *> > > sectors;
+    /* Indexed by ((x * y_steps) + y) * z_steps + z */
+    std::vector<std::atomic<SpatialIndex *> > sectors;
+    std::mutex live_lock;
+    std::vector<size_t> live_sectors;
 
   public:
+    /* Runs a job once for each number below the count, on whatever
+     * threads it likes, and returns once they're all done.
+     */
+    typedef std::function<void(size_t,
+                               const std::function<void(size_t)>&)> spread_t;
+
     GameObject::objects_map game_objects;
+    std::shared_mutex sector_lock;
 
   protected:
     virtual void init(DB *);
+    void build_sectors(void);
+
+    inline size_t sector_index(int, int, int);
+    bool in_zone(const glm::ivec3&);
+    SpatialIndex *create_sector(size_t, const glm::ivec3&);
+    glm::ivec3 clamp_sector(const glm::dvec3&);
+    glm::dvec3 clamp_position(const glm::dvec3&);
 
   public:
     Zone(uint64_t, uint16_t, DB *);
     Zone(uint64_t, uint64_t, uint64_t, uint16_t, uint16_t, uint16_t, DB *);
     ~Zone();
 
-    Octree *sector_contains(const glm::dvec3&);
+    SpatialIndex *sector_contains(const glm::dvec3&);
+    SpatialIndex *sector_at(const glm::dvec3&);
     glm::ivec3 which_sector(const glm::dvec3&);
+    size_t sector_count(void);
+    size_t release_empty_sectors(void);
+    void tune_sectors(void);
+    std::string sector_report(void);
+    void hand_off(SpatialIndex::object_list_t&);
+    size_t gravitate(double, double, double, const spread_t& = spread_t());
+
+    void objects_in_range(const glm::dvec3&, double,
+                          SpatialIndex::object_list_t&);
+    void nearest_objects(const glm::dvec3&, size_t, double,
+                         SpatialIndex::object_list_t&);
+    GameObject *raycast(const glm::dvec3&, const glm::dvec3&, double,
+                        GameObject * = NULL);
+    void raycast(SpatialIndex::ray_list_t&);
 
     GameObject *find_game_object(uint64_t);
     virtual void send_nearby_objects(uint64_t);
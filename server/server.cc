@@ -41,11 +41,13 @@
 #include <fcntl.h>
 #include <errno.h>
 
+#include <chrono>
 #include <mutex>
 #include <condition_variable>
 #include <fstream>
 #include <stdexcept>
 #include <system_error>
+#include <thread>
 
 #include "server.h"
 #include "signals.h"
@@ -55,6 +57,7 @@
 #include "classes/library.h"
 #include "classes/socket.h"
 #include "classes/console.h"
+#include "classes/replay.h"
 
 static void setup_daemon(void);
 static void setup_log(void);
@@ -62,6 +65,7 @@ static void setup_sockets(void);
 static void setup_zone(void);
 static void setup_thread_pools(void);
 static void setup_console(void);
+static int replay_recording(void);
 static void cleanup_console(void);
 static void cleanup_thread_pools(void);
 static void cleanup_zone(void);
@@ -74,6 +78,7 @@ Zone *zone = NULL;
 ActionPool *action_pool = NULL;
 MotionPool *motion_pool = NULL;
 UpdatePool *update_pool = NULL;
+Recorder *recorder = NULL;
 DB *database = NULL;
 static Library *db_lib = NULL;
 std::vector<listen_socket *> sockets;
@@ -81,9 +86,14 @@ std::vector<Console *> consoles;
 static std::mutex exit_mutex;
 static std::condition_variable exit_flag;
 
+/* How often we get rid of empty sectors */
+static const std::chrono::seconds SECTOR_RELEASE_INTERVAL(60);
+
 int main(int argc, char **argv)
 {
     setup_configuration(argc, argv);
+    if (config.replay_fname.size() > 0)
+        return replay_recording();
     try { setup_daemon(); }
     catch (std::exception& e)
     {
@@ -112,11 +122,19 @@ int main(int argc, char **argv)
     }
 
     /* Since all our stuff is running in other threads, we'll just
-     * wait until the exit flag gets waved.
+     * wait until the exit flag gets waved, cleaning out any empty
+     * sectors and letting the rest retune themselves every so often.
      */
     {
         std::unique_lock lock(exit_mutex);
-        exit_flag.wait(lock);
+        while (!main_loop_exit_flag)
+            if (exit_flag.wait_for(lock, SECTOR_RELEASE_INTERVAL)
+                == std::cv_status::timeout
+                && zone != NULL)
+            {
+                zone->release_empty_sectors();
+                zone->tune_sectors();
+            }
     }
 
     cleanup_console();
@@ -259,12 +277,34 @@ static void setup_thread_pools(void)
      * the actions library keeps a pointer to it in its own address
      * space.
      */
-    motion_pool = new MotionPool("motion", config.motion_threads);
+    motion_pool = new MotionPool("motion", config.motion_threads,
+                                 config.tick_rate);
+    motion_pool->gravity = config.gravity;
+    motion_pool->opening_angle = config.gravity_theta;
+    MotionState::set_sleep(config.sleep_speed, config.sleep_spin,
+                           config.sleep_after);
     update_pool = new UpdatePool("update", config.update_threads);
     action_pool = new ActionPool(config.action_threads,
                                  zone->game_objects,
                                  database);
 
+    /* Nothing's moved yet, so the recording starts from what we
+     * just loaded.
+     */
+    if (config.record_fname.size() > 0)
+    {
+        if (config.tick_rate > 0)
+        {
+            recorder = new Recorder(config.record_fname, config.tick_rate,
+                                    zone->game_objects);
+            std::clog << "recording to " << config.record_fname
+                      << std::endl;
+        }
+        else
+            std::clog << syslogWarn
+                      << "can't record without a tick rate" << std::endl;
+    }
+
     action_pool->start();
     motion_pool->start();
     update_pool->start();
@@ -327,6 +367,13 @@ static void cleanup_thread_pools(void)
         delete update_pool;
         update_pool = NULL;
     }
+    if (recorder != NULL)
+    {
+        std::clog << "recorded " << recorder->ticks << " ticks and "
+                  << recorder->actions << " actions" << std::endl;
+        delete recorder;
+        recorder = NULL;
+    }
 }
 
 static void cleanup_zone(void)
@@ -382,6 +429,75 @@ static void cleanup_daemon(void)
     unlink(config.pid_fname.c_str());
 }
 
+/* Play back a recording, with no database, sockets or consoles,
+ * as fast as it'll go, and say how long it took.
+ */
+static int replay_recording(void)
+{
+    Replay *replay = NULL;
+    size_t count;
+    int ret = 0;
+
+    std::clog << "replaying " << config.replay_fname << std::endl;
+    try
+    {
+        replay = new Replay(config.replay_fname);
+        replay->configure(config);
+        zone = new Zone(config.size.dim[0], config.size.dim[1],
+                        config.size.dim[2], config.size.steps[0],
+                        config.size.steps[1], config.size.steps[2], NULL);
+        count = replay->load(zone);
+        std::clog << "loaded " << count << " objects from the recording"
+                  << std::endl;
+
+        motion_pool = new MotionPool("motion", config.motion_threads,
+                                     replay->tick_rate);
+        motion_pool->paced = false;
+        motion_pool->gravity = config.gravity;
+        motion_pool->opening_angle = config.gravity_theta;
+        MotionState::set_sleep(config.sleep_speed, config.sleep_spin,
+                               config.sleep_after);
+        update_pool = new UpdatePool("update", config.update_threads);
+        try
+        {
+            action_pool = new ActionPool(config.action_threads,
+                                         zone->game_objects,
+                                         NULL);
+        }
+        catch (std::exception& e)
+        {
+            std::clog << syslogWarn << "replaying without actions: "
+                      << e.what() << std::endl;
+        }
+        motion_pool->start();
+        update_pool->start();
+
+        auto start = std::chrono::steady_clock::now();
+        replay->run(action_pool, motion_pool);
+        while (update_pool->queue_size() > 0)
+            std::this_thread::yield();
+        std::chrono::duration<double> secs
+            = std::chrono::steady_clock::now() - start;
+
+        std::clog << "replayed " << replay->ticks << " ticks and "
+                  << replay->actions << " actions in " << secs.count()
+                  << "s, " << replay->ticks / secs.count()
+                  << " ticks per second" << std::endl;
+        std::clog << motion_pool->report();
+    }
+    catch (std::exception& e)
+    {
+        std::clog << syslogErr << e.what() << std::endl;
+        ret = 1;
+    }
+
+    cleanup_zone();
+    if (replay != NULL)
+        delete replay;
+    cleanup_configuration();
+    return ret;
+}
+
 /* For the signal handlers. */
 void complete_startup(void)
 {
@@ -34,6 +34,7 @@
 #include "classes/action_pool.h"
 #include "classes/motion_pool.h"
 #include "classes/update_pool.h"
+#include "classes/recorder.h"
 #include "classes/modules/db.h"
 
 extern Zone *zone;
@@ -41,6 +42,7 @@ extern DB *database;
 extern ActionPool *action_pool;
 extern MotionPool *motion_pool;
 extern UpdatePool *update_pool;
+extern Recorder *recorder;
 extern std::atomic<bool> main_loop_exit_flag;
 
 void set_exit_flag(void);
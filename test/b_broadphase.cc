@@ -0,0 +1,157 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <sstream>
+#include <vector>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include "../server/classes/octree.h"
+#include "../server/classes/sweep_prune.h"
+
+#include "mock_server_globals.h"
+#include "bench_util.h"
+
+#define OBJECTS      50000
+#define RADIUS       0.5
+#define STEP         0.1
+
+std::vector<GameObject *> objects;
+
+void place_objects(double size)
+{
+    for (auto go : objects)
+        go->set_position(glm::dvec3(bench_random(0.0, size),
+                                    bench_random(0.0, size),
+                                    bench_random(0.0, size)));
+}
+
+bool touching(GameObject *a, GameObject *b)
+{
+    return a != b
+        && glm::length(a->get_position() - b->get_position())
+        <= a->geometry->radius + b->geometry->radius;
+}
+
+void report(const std::string& name, double secs)
+{
+    std::ostringstream s;
+
+    s << name << ": " << secs * 1e9 / OBJECTS << " ns per object";
+    note(s.str());
+}
+
+/* Find every contact once per object, and once by sweeping the whole
+ * sector, then move everything a little bit, at one density.
+ */
+void bench_density(double size)
+{
+    std::ostringstream s;
+    std::string test;
+    glm::dvec3 min(0.0, 0.0, 0.0), max(size, size, size);
+    Octree *tree = new Octree(NULL, min, max, 0);
+    Octree *sap_tree = new Octree(NULL, min, max, 0);
+    Octree::object_list_t objs(objects.begin(), objects.end());
+    SweepAndPrune::pair_list_t pairs;
+    std::vector<glm::dvec3> steps;
+    uint64_t tree_contacts = 0, sap_contacts = 0;
+
+    s << "size " << size << ": ";
+    test = s.str();
+    s << (double)OBJECTS / (size * size * size) * 1e6
+      << " objects per 100 m cube";
+    note(s.str());
+
+    place_objects(size);
+    sap_tree->broadphase = new SweepAndPrune();
+    tree->build(objs);
+    sap_tree->build(objs);
+
+    {
+        bench_timer t;
+
+        for (auto go : objects)
+            tree->for_each_in_sphere(
+                go->get_position(), go->geometry->radius * 2.0,
+                [&](GameObject *target) {
+                    if (touching(go, target))
+                        ++tree_contacts;
+                    return true;
+                }
+            );
+        report(test + "octree query", t.elapsed());
+    }
+
+    {
+        bench_timer t;
+
+        for (auto go : objects)
+            sap_tree->broadphase->for_each_candidate(
+                go,
+                [&](GameObject *target) {
+                    if (touching(go, target))
+                        ++sap_contacts;
+                    return true;
+                }
+            );
+        report(test + "sap query", t.elapsed());
+    }
+
+    {
+        bench_timer t;
+        uint64_t contacts = 0;
+
+        pairs.reserve(OBJECTS);
+        sap_tree->broadphase->pairs(pairs);
+        for (auto& i : pairs)
+            if (touching(i.first, i.second))
+                ++contacts;
+        report(test + "sap pairs", t.elapsed());
+        is(contacts * 2, tree_contacts, test + "same contacts from pairs");
+    }
+    is(sap_contacts, tree_contacts, test + "same contacts");
+
+    /* Movers pay to keep the sorted intervals up to date.  Each
+     * object goes somewhere nearby and comes back again.
+     */
+    for (auto go : objects)
+        steps.push_back(glm::clamp(go->get_position()
+                                   + glm::dvec3(bench_random(-STEP, STEP),
+                                                bench_random(-STEP, STEP),
+                                                bench_random(-STEP, STEP)),
+                                   min, max * 0.999999));
+    for (auto t : { tree, sap_tree })
+    {
+        bench_timer timer;
+        int i = 0;
+
+        for (auto go : objects)
+        {
+            glm::dvec3 old_pos = go->get_position();
+
+            go->set_position(steps[i++]);
+            t->move(go, old_pos);
+            go->set_position(old_pos);
+            t->move(go, steps[i - 1]);
+        }
+        report(test + (t == tree ? "octree" : "sap") + " move and back",
+               timer.elapsed());
+    }
+
+    delete sap_tree;
+    delete tree;
+}
+
+int main(int argc, char **argv)
+{
+    plan(8);
+
+    objects = bench_objects(OBJECTS, 1000.0, RADIUS);
+    for (double size : { 1000.0, 250.0, 100.0, 50.0 })
+        bench_density(size);
+    for (auto go : objects)
+        delete go;
+    return exit_status();
+}
@@ -0,0 +1,91 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <sstream>
+#include <vector>
+
+#include "../server/classes/motion_pool.h"
+#include "../server/classes/octree.h"
+
+#include "mock_db.h"
+#include "mock_server_globals.h"
+#include "bench_util.h"
+
+#define SECTOR_SIZE  1000.0
+#define OBJECTS      100000
+#define RADIUS       0.5
+
+std::vector<GameObject *> objects;
+
+void report(const std::string& name, uint64_t allocs, double secs)
+{
+    std::ostringstream s;
+
+    s << name << ": " << (double)allocs / OBJECTS << " allocs, "
+      << secs * 1e9 / OBJECTS << " ns per collide";
+    note(s.str());
+}
+
+void bench_collide(void)
+{
+    std::string test = "collide: ";
+    glm::dvec3 min(0.0, 0.0, 0.0);
+    glm::dvec3 max(SECTOR_SIZE, SECTOR_SIZE, SECTOR_SIZE);
+    Octree *sector = new Octree(NULL, min, max, 0);
+    std::list<GameObject *> objs(objects.begin(), objects.end());
+    uint64_t copy_allocs, visit_allocs;
+    double copy_time, visit_time;
+
+    sector->build(objs);
+    motion_pool = new MotionPool("bench", 1);
+
+    /* Before:  copying the candidates out of the tree */
+    alloc_count = 0;
+    {
+        bench_timer t;
+
+        for (auto go : objects)
+        {
+            Octree::object_set_t candidates
+                = sector->get_objects(go->get_position(),
+                                      go->geometry->radius);
+
+            for (auto target : candidates)
+                if (go->collide(target))
+                    break;
+        }
+        copy_time = t.elapsed();
+    }
+    copy_allocs = alloc_count;
+    report("copy", copy_allocs, copy_time);
+
+    /* After:  visiting them in place */
+    alloc_count = 0;
+    {
+        bench_timer t;
+
+        for (auto go : objects)
+            motion_pool->collide(sector, go);
+        visit_time = t.elapsed();
+    }
+    visit_allocs = alloc_count;
+    report("visit", visit_allocs, visit_time);
+
+    ok(copy_allocs > 0, test + "copying allocates");
+    is(visit_allocs, 0, test + "no allocations per collide");
+
+    delete motion_pool;
+    delete sector;
+}
+
+int main(int argc, char **argv)
+{
+    plan(2);
+
+    objects = bench_objects(OBJECTS, SECTOR_SIZE, RADIUS);
+    bench_collide();
+    for (auto go : objects)
+        delete go;
+    return exit_status();
+}
@@ -0,0 +1,118 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <glm/common.hpp>
+
+#include "../server/classes/octree.h"
+
+#include "mock_server_globals.h"
+#include "bench_util.h"
+
+#define SECTOR_SIZE  1000.0
+#define OBJECTS      100000
+#define READERS      32
+#define MOVERS       8
+#define SECONDS      2.0
+#define RADIUS       25.0
+#define STEP         1.0
+
+std::vector<GameObject *> objects;
+std::atomic<bool> done(false);
+std::atomic<uint64_t> reads(0), moves(0), found(0);
+
+/* Range queries at random points, like the interest and collision
+ * queries do.
+ */
+void reader(Octree *tree, int seed)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> dist(0.0, SECTOR_SIZE);
+    Octree::object_list_t result;
+    uint64_t count = 0, total = 0;
+
+    while (!done)
+    {
+        result.clear();
+        tree->range(glm::dvec3(dist(rng), dist(rng), dist(rng)),
+                    RADIUS, result);
+        total += result.size();
+        ++count;
+    }
+    reads += count;
+    found += total;
+}
+
+/* Each mover wanders its own share of the objects around */
+void mover(Octree *tree, int which)
+{
+    std::mt19937_64 rng(which);
+    std::uniform_real_distribution<double> dist(-STEP, STEP);
+    glm::dvec3 mn(0.0, 0.0, 0.0), mx(SECTOR_SIZE, SECTOR_SIZE, SECTOR_SIZE);
+    uint64_t count = 0;
+
+    while (!done)
+        for (size_t i = which; i < objects.size() && !done; i += MOVERS)
+        {
+            GameObject *go = objects[i];
+            glm::dvec3 old_pos = go->get_position();
+
+            go->set_position(glm::clamp(old_pos + glm::dvec3(dist(rng),
+                                                             dist(rng),
+                                                             dist(rng)),
+                                        mn, mx));
+            tree->move(go, old_pos);
+            ++count;
+        }
+    moves += count;
+}
+
+int main(int argc, char **argv)
+{
+    std::string test = "contention: ";
+    glm::dvec3 min(0.0, 0.0, 0.0), max(SECTOR_SIZE, SECTOR_SIZE, SECTOR_SIZE);
+    Octree *tree = new Octree(NULL, min, max, 0);
+    std::vector<std::thread> threads;
+    std::ostringstream s;
+    double secs;
+
+    plan(3);
+
+    objects = bench_objects(OBJECTS, SECTOR_SIZE);
+    tree->build(Octree::object_list_t(objects.begin(), objects.end()));
+
+    {
+        bench_timer t;
+
+        for (int i = 0; i < READERS; ++i)
+            threads.push_back(std::thread(reader, tree, i + 1));
+        for (int i = 0; i < MOVERS; ++i)
+            threads.push_back(std::thread(mover, tree, i));
+        while (t.elapsed() < SECONDS)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        done = true;
+        for (auto& th : threads)
+            th.join();
+        secs = t.elapsed();
+    }
+
+    s << READERS << " readers, " << MOVERS << " movers: "
+      << reads / secs << " queries per second, "
+      << moves / secs << " moves per second, "
+      << (double)found / std::max(reads.load(), (uint64_t)1)
+      << " objects per query";
+    note(s.str());
+
+    ok(reads > 0, test + "queries done");
+    ok(moves > 0, test + "moves done");
+    is(tree->count, OBJECTS, test + "expected object count");
+
+    delete tree;
+    for (auto go : objects)
+        delete go;
+    return exit_status();
+}
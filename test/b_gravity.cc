@@ -0,0 +1,139 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+#include "../server/classes/octree.h"
+
+#include "mock_server_globals.h"
+#include "bench_util.h"
+
+#define SECTOR_SIZE  1000.0
+#define THETA        0.5
+#define SAMPLES      100
+
+std::vector<GameObject *> objects;
+
+/* Everything pulling on one body, one at a time */
+glm::dvec3 brute_force(size_t count, GameObject *go)
+{
+    glm::dvec3 pos = go->get_position(), accel(0.0, 0.0, 0.0);
+
+    for (size_t i = 0; i < count; ++i)
+        if (objects[i] != go)
+        {
+            glm::dvec3 d = objects[i]->get_position() - pos;
+            double r2 = std::max(glm::dot(d, d), 1.0);
+
+            accel += d * (objects[i]->geometry->mass / (r2 * sqrt(r2)));
+        }
+    return accel;
+}
+
+void report(const std::string& name, size_t count, double secs)
+{
+    std::ostringstream s;
+
+    s << name << ", " << count << " bodies: " << secs * 1e3 << " ms, "
+      << secs * 1e9 / count << " ns per body, "
+      << secs * 1e9 / count / log2((double)count) << " ns per body per log n";
+    note(s.str());
+}
+
+/* Returns the time per body for weighing the tree and working out
+ * every body's pull, and the mean relative error of a sample of them.
+ * The bodies go in the tree's own order, like the zone does it, so
+ * each one walks mostly the same nodes as the one before.
+ */
+double bench_tree(size_t count, double& error)
+{
+    glm::dvec3 min(0.0, 0.0, 0.0), max(SECTOR_SIZE, SECTOR_SIZE, SECTOR_SIZE);
+    Octree *tree = new Octree(NULL, min, max, 0);
+    Octree::object_list_t objs(objects.begin(), objects.begin() + count);
+    std::vector<glm::dvec3> accel(count);
+    Octree::query_cost cost;
+    double secs;
+
+    tree->build(objs);
+    {
+        bench_timer t;
+
+        tree->weigh();
+        objs.clear();
+        tree->for_each_object(
+            [&](GameObject *go) {
+                objs.push_back(go);
+                return true;
+            }
+        );
+        for (size_t i = 0; i < count; ++i)
+            accel[i] = tree->pull(objs[i], objs[i]->get_position(), THETA,
+                                  cost);
+        secs = t.elapsed();
+    }
+    report("Barnes-Hut", count, secs);
+    {
+        std::ostringstream s;
+
+        s << (double)cost.nodes / count << " nodes per body";
+        note(s.str());
+    }
+
+    error = 0.0;
+    for (size_t i = 0; i < SAMPLES; ++i)
+    {
+        size_t which = i * (count / SAMPLES);
+        glm::dvec3 exact = brute_force(count, objs[which]);
+
+        error += glm::length(accel[which] - exact) / glm::length(exact);
+    }
+    error /= SAMPLES;
+
+    delete tree;
+    return secs / count;
+}
+
+int main(int argc, char **argv)
+{
+    size_t counts[3] = { 1000, 10000, 100000 };
+    double per_body[3], error, worst = 0.0;
+
+    plan(2);
+
+    objects = bench_objects(counts[2], SECTOR_SIZE);
+
+    /* The old way, for comparison, while it's still bearable */
+    for (int i = 0; i < 2; ++i)
+    {
+        bench_timer t;
+
+        for (size_t j = 0; j < counts[i]; ++j)
+            brute_force(counts[i], objects[j]);
+        report("brute force", counts[i], t.elapsed());
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        per_body[i] = bench_tree(counts[i], error);
+        worst = std::max(worst, error);
+    }
+
+    {
+        std::ostringstream s;
+
+        s << "mean relative error at theta " << THETA << ": at most "
+          << worst * 100.0 << "%";
+        note(s.str());
+    }
+    ok(worst < 0.01, "within 1% of brute force");
+
+    /* Brute force would be 100 times the cost per body */
+    ok(per_body[2] < per_body[0] * 10.0, "scales like n log n");
+
+    for (auto go : objects)
+        delete go;
+    return exit_status();
+}
@@ -0,0 +1,120 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "../server/classes/contact_islands.h"
+
+#include "bench_util.h"
+
+#define CLUSTERS  20000
+#define CHAIN     8
+
+std::vector<GameObject *> objects;
+std::vector<glm::dvec3> start, heading;
+
+/* Each cluster is a chain of objects, each touching the next, all
+ * shoved at each other from random directions.
+ */
+void create_objects(void)
+{
+    objects.reserve(CLUSTERS * CHAIN);
+    for (int i = 0; i < CLUSTERS; ++i)
+        for (int j = 0; j < CHAIN; ++j)
+        {
+            objects.push_back(new GameObject(NULL, NULL,
+                                             i * CHAIN + j + 1));
+            start.push_back(glm::dvec3(10.0 * (i % 100) + 0.9 * j,
+                                       10.0 * (i / 100),
+                                       bench_random(-0.05, 0.05)));
+            heading.push_back(glm::dvec3(bench_random(-1.0, 1.0),
+                                         bench_random(-1.0, 1.0),
+                                         bench_random(-1.0, 1.0)));
+        }
+}
+
+void reset(ContactIslands& islands)
+{
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        objects[i]->set_position(start[i]);
+        objects[i]->set_movement(heading[i]);
+    }
+    islands.clear();
+    for (size_t i = 0; i + 1 < objects.size(); ++i)
+        if (objects[i]->contact(objects[i + 1]) >= 0.0)
+            islands.add(objects[i], objects[i + 1]);
+}
+
+/* Each thread takes every nth island */
+double bench_solve(ContactIslands& islands, int threads)
+{
+    std::vector<std::thread> th;
+    std::ostringstream s;
+    double secs, build;
+
+    reset(islands);
+    {
+        bench_timer t;
+
+        islands.build();
+        build = t.elapsed();
+    }
+    {
+        bench_timer t;
+
+        for (int n = 0; n < threads; ++n)
+            th.push_back(std::thread([&islands, threads, n]() {
+                for (size_t i = n; i < islands.size(); i += threads)
+                    islands.solve(i);
+            }));
+        for (auto& t : th)
+            t.join();
+        secs = t.elapsed();
+    }
+
+    s << threads << " threads: " << islands.size() / secs / 1e6
+      << "M islands per second (" << islands.contacts() << " contacts, "
+      << build * 1e3 << " ms to build)";
+    note(s.str());
+    return secs;
+}
+
+int main(int argc, char **argv)
+{
+    ContactIslands islands;
+    std::vector<glm::dvec3> first;
+    int counts[4] = { 1, 2, 4, 8 };
+    bool same = true;
+
+    plan(2);
+
+    create_objects();
+    {
+        std::ostringstream s;
+
+        s << std::thread::hardware_concurrency() << " cores";
+        note(s.str());
+    }
+
+    for (auto count : counts)
+    {
+        bench_solve(islands, count);
+        if (first.empty())
+            for (auto go : objects)
+                first.push_back(go->get_position());
+        else
+            for (size_t i = 0; i < objects.size(); ++i)
+                if (objects[i]->get_position() != first[i])
+                    same = false;
+    }
+    is(islands.size(), CLUSTERS, "one island per cluster");
+    is(same, true, "same results on any number of threads");
+
+    for (auto go : objects)
+        delete go;
+    return exit_status();
+}
@@ -0,0 +1,105 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <vector>
+
+#include "../server/classes/motion_pool.h"
+
+#include "mock_db.h"
+#include "mock_server_globals.h"
+#include "bench_util.h"
+
+#define SECTOR_SIZE  1000
+#define RUN_SECS     1
+#define TICK_RATE    30
+
+/* User and system time used by the whole process, in seconds */
+double cpu_time(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6
+        + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+/* Keep count objects moving for a while, and see how much CPU it
+ * takes and how many updates it sends.
+ */
+double bench_mode(int count, unsigned int rate)
+{
+    std::vector<GameObject *> objects;
+    std::ostringstream s;
+    double cpu, updates;
+
+    database = new fake_DB("a", 0, "b", "c", "d");
+    zone = new Zone(SECTOR_SIZE, 1, database);
+    motion_pool = new MotionPool("bench", 2, rate);
+    update_pool = new UpdatePool("bench", 1);
+
+    for (int i = 0; i < count; ++i)
+    {
+        GameObject *go = new GameObject(NULL, NULL, i + 1);
+
+        go->set_position(glm::dvec3(bench_random(100.0, SECTOR_SIZE - 100.0),
+                                    bench_random(100.0, SECTOR_SIZE - 100.0),
+                                    bench_random(100.0, SECTOR_SIZE - 100.0)));
+        go->set_movement(glm::dvec3(bench_random(-1.0, 1.0),
+                                    bench_random(-1.0, 1.0),
+                                    bench_random(-1.0, 1.0)));
+        go->geometry->radius = 0.01;
+        zone->sector_contains(go->get_position())->insert(go);
+        objects.push_back(go);
+        motion_pool->push(go);
+    }
+
+    update_pool->start();
+    cpu = cpu_time();
+    motion_pool->start();
+    sleep(RUN_SECS);
+    motion_pool->stop();
+    cpu = cpu_time() - cpu;
+    update_pool->stop();
+
+    updates = (double)motion_pool->updates / RUN_SECS;
+    s << count << " objects, "
+      << (rate > 0 ? std::to_string(rate) + " Hz" : std::string("free"))
+      << ": " << cpu / RUN_SECS * 100.0 << "% CPU, "
+      << motion_pool->moves / RUN_SECS << " moves/s, "
+      << updates << " updates/s";
+    note(s.str());
+
+    delete update_pool;
+    delete motion_pool;
+    delete zone;
+    for (auto go : objects)
+        delete go;
+    delete (fake_DB *)database;
+    return updates;
+}
+
+int main(int argc, char **argv)
+{
+    std::streambuf *orig_rdbuf = std::clog.rdbuf(new Log("blah", LOG_DAEMON));
+    int counts[3] = { 10, 1000, 10000 };
+
+    plan(3);
+
+    for (auto count : counts)
+    {
+        std::ostringstream s;
+
+        bench_mode(count, 0);
+        s << count << " objects: updates bounded by the tick rate";
+        ok(bench_mode(count, TICK_RATE) <= (TICK_RATE + 1.0) * count * 1.05,
+           s.str());
+    }
+
+    delete std::clog.rdbuf(orig_rdbuf);
+    return exit_status();
+}
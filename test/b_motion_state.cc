@@ -0,0 +1,117 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <sstream>
+#include <vector>
+
+#include "../server/classes/game_obj.h"
+
+#include "bench_util.h"
+
+#define MOVERS   1000000
+#define PASSES   20
+#define STEP     (1.0 / 30.0)
+
+std::vector<GameObject *> objects;
+std::vector<glm::dvec3> start;
+
+/* Everything moves, and one in ten is turning as well */
+void create_objects(void)
+{
+    objects = bench_objects(MOVERS, 1000.0);
+    for (int i = 0; i < MOVERS; ++i)
+    {
+        GameObject *go = objects[i];
+
+        start.push_back(go->get_position());
+        go->set_movement(glm::dvec3(bench_random(-1.0, 1.0),
+                                    bench_random(-1.0, 1.0),
+                                    bench_random(-1.0, 1.0)));
+        if (i % 10 == 0)
+            go->set_rotation(glm::dvec3(0.0, 0.0, bench_random(-1.0, 1.0)));
+    }
+}
+
+void reset(void)
+{
+    for (int i = 0; i < MOVERS; ++i)
+    {
+        objects[i]->set_position(start[i]);
+        objects[i]->set_orientation(glm::dquat(1.0, 0.0, 0.0, 0.0));
+    }
+}
+
+void report(const std::string& name, double secs, size_t count)
+{
+    std::ostringstream s;
+
+    s << name << ": " << count / secs / 1e6 << "M objects per second, "
+      << secs * 1e9 / count << " ns each";
+    note(s.str());
+}
+
+/* All on this one thread, so it's the rate for a single core */
+size_t bench_integrate(const std::string& name, bool simd)
+{
+    size_t moved = 0;
+
+    reset();
+    MotionState::use_simd(simd);
+    {
+        bench_timer t;
+
+        for (int i = 0; i < PASSES; ++i)
+            moved += MotionState::integrate(
+                STEP,
+                [](GameObject *go, const glm::dvec3& from) {}
+            );
+        report(name, t.elapsed(), moved);
+    }
+    return moved;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<glm::dvec3> scalar;
+    size_t moved;
+
+    plan(2);
+
+    /* Nothing gets to fall asleep partway through */
+    MotionState::set_sleep(0.0, 0.0, 0.0);
+    create_objects();
+
+    /* The old way, one object and one lock at a time */
+    reset();
+    {
+        bench_timer t;
+
+        for (int i = 0; i < PASSES; ++i)
+            for (auto go : objects)
+                go->move_and_rotate(STEP);
+        report("one at a time", t.elapsed(), (size_t)MOVERS * PASSES);
+    }
+
+    moved = bench_integrate("scalar", false);
+    for (auto go : objects)
+        scalar.push_back(go->get_position());
+    is(moved, (size_t)MOVERS * PASSES, "everything moved every pass");
+
+    if (MotionState::have_simd())
+    {
+        bool same = true;
+
+        bench_integrate("AVX2", true);
+        for (int i = 0; i < MOVERS; ++i)
+            if (objects[i]->get_position() != scalar[i])
+                same = false;
+        is(same, true, "AVX2 matches scalar");
+    }
+    else
+        skip(1, "no AVX2 here");
+
+    for (auto go : objects)
+        delete go;
+    return exit_status();
+}
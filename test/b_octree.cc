@@ -0,0 +1,171 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <sstream>
+#include <vector>
+
+#include <glm/common.hpp>
+
+#include "../server/classes/octree.h"
+
+#include "mock_server_globals.h"
+#include "bench_util.h"
+
+#define SECTOR_SIZE  1000.0
+#define OBJECTS      100000
+#define BIG_OBJECTS  1000000
+#define STEP         1.0
+
+std::vector<GameObject *> objects;
+
+Octree *create_tree(void)
+{
+    glm::dvec3 min(0.0, 0.0, 0.0);
+    glm::dvec3 max(SECTOR_SIZE, SECTOR_SIZE, SECTOR_SIZE);
+    Octree *tree = new Octree(NULL, min, max, 0);
+    std::list<GameObject *> objs(objects.begin(), objects.end());
+
+    tree->build(objs);
+    return tree;
+}
+
+glm::dvec3 step(const glm::dvec3& pos)
+{
+    glm::dvec3 p = pos + glm::dvec3(bench_random(-STEP, STEP),
+                                    bench_random(-STEP, STEP),
+                                    bench_random(-STEP, STEP));
+
+    p = glm::max(p, glm::dvec3(0.0, 0.0, 0.0));
+    return glm::min(p, glm::dvec3(SECTOR_SIZE, SECTOR_SIZE, SECTOR_SIZE));
+}
+
+void report(const std::string& name,
+            uint64_t locks, uint64_t allocs, double secs)
+{
+    std::ostringstream s;
+
+    s << name << ": " << (double)locks / OBJECTS << " locks, "
+      << (double)allocs / OBJECTS << " allocs, "
+      << secs * 1e9 / OBJECTS << " ns per moved object";
+    note(s.str());
+}
+
+void bench_move(void)
+{
+    std::string test = "move: ";
+    Octree *tree = create_tree();
+    uint64_t pair_locks, pair_allocs, move_locks, move_allocs;
+    uint64_t created, reused;
+    double pair_time, move_time;
+
+    /* Before:  the remove/insert pair the motion pool used to do */
+    Octree::lock_count = 0;
+    alloc_count = 0;
+    {
+        bench_timer t;
+
+        for (auto go : objects)
+        {
+            tree->remove(go);
+            go->set_position(step(go->get_position()));
+            tree->insert(go);
+        }
+        pair_time = t.elapsed();
+    }
+    pair_locks = Octree::lock_count;
+    pair_allocs = alloc_count;
+    report("remove/insert", pair_locks, pair_allocs, pair_time);
+
+    /* After:  in-place relocation */
+    Octree::lock_count = 0;
+    alloc_count = 0;
+    created = tree->pool->created;
+    reused = tree->pool->reused;
+    {
+        bench_timer t;
+
+        for (auto go : objects)
+        {
+            glm::dvec3 old_pos = go->get_position();
+
+            go->set_position(step(old_pos));
+            tree->move(go, old_pos);
+        }
+        move_time = t.elapsed();
+    }
+    move_locks = Octree::lock_count;
+    move_allocs = alloc_count;
+    report("move", move_locks, move_allocs, move_time);
+    {
+        std::ostringstream s;
+
+        s << "move: " << tree->pool->created - created << " nodes created, "
+          << tree->pool->reused - reused << " reused, "
+          << tree->pool->allocation_rate() << " nodes per second overall";
+        note(s.str());
+    }
+
+    ok(move_locks < pair_locks, test + "fewer lock acquisitions");
+    ok(move_allocs < pair_allocs, test + "fewer allocations");
+    is(tree->count, OBJECTS, test + "expected object count");
+
+    delete tree;
+}
+
+void bench_insert(void)
+{
+    std::string test = "insert: ";
+    std::vector<GameObject *> big;
+    std::ostringstream s;
+    glm::dvec3 min(0.0, 0.0, 0.0);
+    glm::dvec3 max(SECTOR_SIZE, SECTOR_SIZE, SECTOR_SIZE);
+    Octree *tree;
+    int64_t before, after;
+    double secs;
+    int i;
+
+    big.reserve(BIG_OBJECTS);
+    for (i = 0; i < BIG_OBJECTS; ++i)
+    {
+        GameObject *go = new GameObject(NULL, NULL, OBJECTS + i + 1);
+
+        go->set_position(glm::dvec3(bench_random(0.0, SECTOR_SIZE),
+                                    bench_random(0.0, SECTOR_SIZE),
+                                    bench_random(0.0, SECTOR_SIZE)));
+        big.push_back(go);
+    }
+
+    before = alloc_bytes;
+    tree = new Octree(NULL, min, max, 0);
+    {
+        bench_timer t;
+
+        for (auto go : big)
+            tree->insert(go);
+        secs = t.elapsed();
+    }
+    after = alloc_bytes;
+
+    s << BIG_OBJECTS << " objects: "
+      << (double)(after - before) / BIG_OBJECTS << " bytes per object, "
+      << BIG_OBJECTS / secs << " inserts per second";
+    note(s.str());
+    is(tree->get_objects().size(), BIG_OBJECTS, test + "expected object count");
+
+    delete tree;
+    for (auto go : big)
+        delete go;
+}
+
+int main(int argc, char **argv)
+{
+    plan(4);
+
+    objects = bench_objects(OBJECTS, SECTOR_SIZE);
+    bench_move();
+    bench_insert();
+    for (auto go : objects)
+        delete go;
+    return exit_status();
+}
@@ -0,0 +1,129 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <atomic>
+#include <chrono>
+#include <shared_mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "../server/classes/game_obj.h"
+
+#include "bench_util.h"
+
+#define OBJECTS   10000
+#define RUN_SECS  1
+
+/* The way it used to be done, for comparison:  one shared_mutex per
+ * object, which every reader has to write to.
+ */
+class locked_pose
+{
+  public:
+    std::shared_mutex lock;
+    glm::dvec3 position;
+
+    locked_pose() : lock(), position(0.0, 0.0, 0.0) {};
+
+    glm::dvec3 get_position(void)
+        {
+            std::shared_lock hold(this->lock);
+            return this->position;
+        };
+    void set_position(const glm::dvec3& p)
+        {
+            std::unique_lock hold(this->lock);
+            this->position = p;
+        };
+};
+
+std::vector<GameObject *> objects;
+std::vector<locked_pose *> locked;
+std::atomic<int> torn(0);
+
+/* Readers go over everything as fast as they can, while one writer
+ * keeps changing things.
+ */
+template <typename T>
+void bench_poses(const std::string& name, std::vector<T *>& poses, int readers)
+{
+    std::atomic<bool> finished(false);
+    std::atomic<uint64_t> reads(0), writes(0);
+    std::vector<std::thread> th;
+    std::ostringstream s;
+
+    for (int i = 0; i < readers; ++i)
+        th.push_back(std::thread([&]() {
+            uint64_t count = 0;
+            int bad = 0;
+
+            while (!finished)
+                for (auto p : poses)
+                {
+                    glm::dvec3 pos = p->get_position();
+
+                    if (pos.x != pos.y || pos.y != pos.z)
+                        ++bad;
+                    ++count;
+                }
+            reads += count;
+            torn += bad;
+        }));
+    th.push_back(std::thread([&]() {
+        uint64_t count = 0;
+        double v = 0.0;
+
+        while (!finished)
+        {
+            for (auto p : poses)
+                p->set_position(glm::dvec3(v, v, v));
+            count += poses.size();
+            v += 1.0;
+        }
+        writes += count;
+    }));
+
+    std::this_thread::sleep_for(std::chrono::seconds(RUN_SECS));
+    finished = true;
+    for (auto& t : th)
+        t.join();
+
+    s << name << ", " << readers << " readers: "
+      << reads / RUN_SECS / 1e6 << "M reads/s, "
+      << writes / RUN_SECS / 1e6 << "M writes/s";
+    note(s.str());
+}
+
+int main(int argc, char **argv)
+{
+    int counts[3] = { 1, 2, 4 };
+
+    plan(1);
+
+    for (int i = 0; i < OBJECTS; ++i)
+    {
+        objects.push_back(new GameObject(NULL, NULL, i + 1));
+        locked.push_back(new locked_pose);
+    }
+    {
+        std::ostringstream s;
+
+        s << std::thread::hardware_concurrency() << " cores";
+        note(s.str());
+    }
+
+    for (auto count : counts)
+    {
+        bench_poses("shared_mutex", locked, count);
+        bench_poses("seqlock", objects, count);
+    }
+    is(torn, 0, "no torn reads");
+
+    for (auto go : objects)
+        delete go;
+    for (auto p : locked)
+        delete p;
+    return exit_status();
+}
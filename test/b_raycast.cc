@@ -0,0 +1,172 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <sstream>
+#include <vector>
+
+#include "../server/classes/zone.h"
+#include "../server/classes/octree.h"
+#include "../server/classes/linear_octree.h"
+
+#include "mock_db.h"
+#include "mock_server_globals.h"
+#include "bench_util.h"
+
+#define SECTOR_SIZE  1000
+#define OBJECTS      100000
+#define RAYS         10000
+#define SCANNED      100
+#define RAY_LENGTH   500.0
+#define RADIUS       5.0
+
+std::vector<GameObject *> objects;
+SpatialIndex::ray_list_t rays;
+
+void create_objects(void)
+{
+    int i;
+
+    objects = bench_objects(OBJECTS,
+                            glm::dvec3(SECTOR_SIZE * 2.0,
+                                       SECTOR_SIZE * 2.0,
+                                       SECTOR_SIZE),
+                            RADIUS);
+    for (i = 0; i < RAYS; ++i)
+        rays.push_back(SpatialIndex::ray(
+                           glm::dvec3(bench_random(0.0, SECTOR_SIZE * 2.0),
+                                      bench_random(0.0, SECTOR_SIZE * 2.0),
+                                      bench_random(0.0, SECTOR_SIZE)),
+                           glm::dvec3(bench_random(-1.0, 1.0),
+                                      bench_random(-1.0, 1.0),
+                                      bench_random(-1.0, 1.0)),
+                           RAY_LENGTH));
+}
+
+/* Hands the objects over to the zone, without giving them up */
+class ray_DB : public fake_DB
+{
+  public:
+    ray_DB(const std::string& a, int b, const std::string& c,
+           const std::string& d, const std::string& e)
+        : fake_DB(a, b, c, d, e)
+        {};
+    virtual ~ray_DB() {};
+
+    virtual int get_server_objects(GameObject::objects_map& a)
+        {
+            for (auto go : objects)
+                a[go->get_object_id()] = go;
+            return a.size();
+        };
+};
+
+void report(const std::string& name, double secs, int count)
+{
+    std::ostringstream s;
+
+    s << name << ": " << secs * 1e9 / count << " ns per ray";
+    note(s.str());
+}
+
+/* Casting front to back into one index, against trying every
+ * object, which we can only stand to do for a few rays.
+ */
+void bench_index(const std::string& name, SpatialIndex *index)
+{
+    std::string test = name + ": ";
+    SpatialIndex::object_list_t objs;
+    SpatialIndex::ray_list_t cast(rays), scanned(rays.begin(),
+                                                 rays.begin() + SCANNED);
+    std::ostringstream s;
+    int i, hits = 0, same = 0;
+
+    for (auto go : objects)
+        if (go->get_position().x < SECTOR_SIZE
+            && go->get_position().y < SECTOR_SIZE)
+            objs.push_back(go);
+    index->build(objs);
+
+    {
+        bench_timer t;
+
+        for (auto& r : cast)
+            index->raycast(r);
+        report(name + " raycast", t.elapsed(), RAYS);
+    }
+    {
+        bench_timer t;
+
+        for (auto& r : scanned)
+            index->SpatialIndex::raycast(r);
+        report(name + " scan", t.elapsed(), SCANNED);
+    }
+
+    for (i = 0; i < SCANNED; ++i)
+    {
+        if (cast[i].hit != NULL)
+            ++hits;
+        if (cast[i].hit == scanned[i].hit)
+            ++same;
+    }
+    s << name << ": " << hits << " of " << SCANNED << " rays hit";
+    note(s.str());
+    is(same, SCANNED, test + "same hits as a scan");
+    delete index;
+}
+
+/* One ray at a time through the zone, against all in one batch */
+void bench_zone(void)
+{
+    std::string test = "zone: ";
+    SpatialIndex::ray_list_t batch(rays);
+    std::vector<GameObject *> hit(RAYS);
+    int i, same = 0;
+    double single_time;
+
+    database = new ray_DB("a", 0, "b", "c", "d");
+    zone = new Zone(SECTOR_SIZE, SECTOR_SIZE, SECTOR_SIZE, 2, 2, 1, database);
+
+    {
+        bench_timer t;
+
+        for (i = 0; i < RAYS; ++i)
+            hit[i] = zone->raycast(rays[i].origin, rays[i].dir,
+                                   rays[i].max_dist);
+        single_time = t.elapsed();
+    }
+    report("zone single", single_time, RAYS);
+    {
+        bench_timer t;
+
+        zone->raycast(batch);
+        report("zone batch", t.elapsed(), RAYS);
+    }
+
+    for (i = 0; i < RAYS; ++i)
+        if (batch[i].hit == hit[i])
+            ++same;
+    is(same, RAYS, test + "same hits one at a time and batched");
+
+    /* The zone doesn't own our objects */
+    zone->game_objects.clear();
+    delete zone;
+    delete (ray_DB *)database;
+}
+
+int main(int argc, char **argv)
+{
+    glm::dvec3 min(0.0, 0.0, 0.0);
+    glm::dvec3 max(SECTOR_SIZE, SECTOR_SIZE, SECTOR_SIZE);
+
+    plan(3);
+
+    create_objects();
+    bench_index("octree", new Octree(NULL, min, max, 0));
+    bench_index("linear", new LinearOctree(min, max));
+    bench_zone();
+
+    for (auto go : objects)
+        delete go;
+    return exit_status();
+}
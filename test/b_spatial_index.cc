@@ -0,0 +1,134 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <sstream>
+#include <vector>
+
+#include <glm/common.hpp>
+
+#include "../server/classes/octree.h"
+#include "../server/classes/linear_octree.h"
+
+#include "mock_server_globals.h"
+#include "bench_util.h"
+
+#define SECTOR_SIZE  1000.0
+#define OBJECTS      100000
+#define QUERIES      10000
+#define STEP         1.0
+
+std::vector<GameObject *> objects;
+std::vector<glm::dvec3> points, steps;
+
+void create_objects(void)
+{
+    int i;
+
+    objects = bench_objects(OBJECTS, SECTOR_SIZE);
+    for (i = 0; i < OBJECTS; ++i)
+        steps.push_back(glm::dvec3(bench_random(-STEP, STEP),
+                                   bench_random(-STEP, STEP),
+                                   bench_random(-STEP, STEP)));
+    for (i = 0; i < QUERIES; ++i)
+        points.push_back(glm::dvec3(bench_random(0.0, SECTOR_SIZE),
+                                    bench_random(0.0, SECTOR_SIZE),
+                                    bench_random(0.0, SECTOR_SIZE)));
+}
+
+void report(const std::string& name, double secs, int count)
+{
+    std::ostringstream s;
+
+    s << name << ": " << secs * 1e9 / count << " ns each";
+    note(s.str());
+}
+
+/* The same workload for each index:  build, query, and move
+ * everything a little bit.
+ */
+size_t bench_index(const std::string& name, SpatialIndex *index)
+{
+    SpatialIndex::object_list_t objs(objects.begin(), objects.end());
+    std::vector<glm::dvec3> start;
+    std::ostringstream s;
+    size_t found = 0;
+    int64_t before = alloc_bytes;
+
+    {
+        bench_timer t;
+
+        index->build(objs);
+        report(name + " build", t.elapsed(), OBJECTS);
+    }
+    s << name << ": " << (double)(alloc_bytes - before) / OBJECTS
+      << " bytes per object";
+    note(s.str());
+
+    {
+        bench_timer t;
+        SpatialIndex::object_list_t result;
+
+        for (auto& pt : points)
+        {
+            result.clear();
+            index->range(pt, 50.0, result);
+            found += result.size();
+        }
+        report(name + " range", t.elapsed(), QUERIES);
+    }
+
+    {
+        bench_timer t;
+        SpatialIndex::neighbor_list_t best;
+
+        for (auto& pt : points)
+        {
+            best.clear();
+            index->nearest(pt, 10, 1000.0, best);
+            found += best.size();
+        }
+        report(name + " nearest", t.elapsed(), QUERIES);
+    }
+
+    for (auto go : objects)
+        start.push_back(go->get_position());
+    {
+        bench_timer t;
+        glm::dvec3 mn(0.0, 0.0, 0.0);
+        glm::dvec3 mx(SECTOR_SIZE * 0.999999);
+        int i = 0;
+
+        for (auto go : objects)
+        {
+            glm::dvec3 old_pos = go->get_position();
+
+            go->set_position(glm::clamp(old_pos + steps[i++], mn, mx));
+            index->move(go, old_pos);
+        }
+        report(name + " move", t.elapsed(), OBJECTS);
+    }
+
+    /* Put everything back for the next one */
+    for (int i = 0; i < OBJECTS; ++i)
+        objects[i]->set_position(start[i]);
+    delete index;
+    return found;
+}
+
+int main(int argc, char **argv)
+{
+    glm::dvec3 min(0.0, 0.0, 0.0), max(SECTOR_SIZE, SECTOR_SIZE, SECTOR_SIZE);
+    size_t tree_found, linear_found;
+
+    plan(1);
+
+    create_objects();
+    tree_found = bench_index("octree", new Octree(NULL, min, max, 0));
+    linear_found = bench_index("linear", new LinearOctree(min, max));
+    is(linear_found, tree_found, "same results from both");
+
+    for (auto go : objects)
+        delete go;
+    return exit_status();
+}
@@ -0,0 +1,185 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <math.h>
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include "../server/classes/game_obj.h"
+
+#include "bench_util.h"
+
+#define SPINNERS  1000000
+#define PASSES    20
+#define STEP      (1.0 / 30.0)
+#define DRIFTERS  100
+#define TURNS     100000
+
+std::vector<glm::dvec3> spins;
+std::vector<glm::dquat> orient;
+
+/* Every which way, up to a turn a second or so */
+void create_spins(size_t count)
+{
+    spins.clear();
+    while (spins.size() < count)
+        spins.push_back(glm::dvec3(bench_random(-4.0, 4.0),
+                                   bench_random(-4.0, 4.0),
+                                   bench_random(-4.0, 4.0)));
+    orient.assign(count, glm::dquat(1.0, 0.0, 0.0, 0.0));
+}
+
+/* The old way; the rotation was the turn over one second */
+glm::dquat euler_turn(const glm::dquat& o, const glm::dquat& r, double dt)
+{
+    return glm::dquat(glm::eulerAngles(r) * dt) * o;
+}
+
+glm::dquat as_turn(const glm::dvec3& spin)
+{
+    return glm::angleAxis(glm::length(spin), glm::normalize(spin));
+}
+
+/* How far apart two orientations are, in radians */
+double angle_between(const glm::dquat& a, const glm::dquat& b)
+{
+    double d = fabs(glm::dot(a, b)) / (glm::length(a) * glm::length(b));
+
+    return 2.0 * acos(std::min(d, 1.0));
+}
+
+void report(const std::string& name, double secs, size_t count)
+{
+    std::ostringstream s;
+
+    s << name << ": " << count / secs / 1e6 << "M turns per second, "
+      << secs * 1e9 / count << " ns each";
+    note(s.str());
+}
+
+void report_drift(const std::string& name, double err, double norm)
+{
+    std::ostringstream s;
+
+    s << name << " after " << TURNS << " steps: " << err
+      << " radians off at worst, length off by " << norm;
+    note(s.str());
+}
+
+/* Returns the time per turn */
+double bench_euler(void)
+{
+    std::vector<glm::dquat> rot;
+    double secs;
+
+    for (auto& s : spins)
+        rot.push_back(as_turn(s));
+    {
+        bench_timer t;
+
+        for (int i = 0; i < PASSES; ++i)
+            for (size_t j = 0; j < orient.size(); ++j)
+                orient[j] = euler_turn(orient[j], rot[j], STEP);
+        secs = t.elapsed();
+    }
+    report("Euler angles", secs, orient.size() * PASSES);
+    return secs / (orient.size() * PASSES);
+}
+
+double bench_exp_map(void)
+{
+    double secs;
+
+    orient.assign(spins.size(), glm::dquat(1.0, 0.0, 0.0, 0.0));
+    {
+        bench_timer t;
+
+        for (int i = 0; i < PASSES; ++i)
+            for (size_t j = 0; j < orient.size(); ++j)
+                orient[j] = MotionState::turn_by(spins[j], STEP) * orient[j];
+        secs = t.elapsed();
+    }
+    report("exp map", secs, orient.size() * PASSES);
+    return secs / (orient.size() * PASSES);
+}
+
+/* The whole integrator, with nothing moving, only turning */
+void bench_integrate(void)
+{
+    std::vector<GameObject *> go;
+    size_t turned = 0;
+
+    for (size_t i = 0; i < spins.size(); ++i)
+    {
+        go.push_back(new GameObject(NULL, NULL, i + 1));
+        go.back()->set_rotation(spins[i]);
+    }
+    {
+        bench_timer t;
+
+        for (int i = 0; i < PASSES; ++i)
+            turned += MotionState::integrate(
+                STEP,
+                [](GameObject *go, const glm::dvec3& from) {}
+            );
+        report("integrator", t.elapsed(), turned);
+    }
+    for (auto g : go)
+        delete g;
+}
+
+/* Each way, against the turn we'd get all at once */
+void drift(double& euler_err, double& euler_norm,
+           double& exp_err, double& exp_norm)
+{
+    euler_err = euler_norm = exp_err = exp_norm = 0.0;
+    for (size_t i = 0; i < DRIFTERS; ++i)
+    {
+        glm::dquat r = as_turn(spins[i]), o(1.0, 0.0, 0.0, 0.0);
+        glm::dquat want = as_turn(spins[i] * (STEP * TURNS));
+        GameObject *go = new GameObject(NULL, NULL, i + 1);
+
+        go->set_rotation(spins[i]);
+        for (int j = 0; j < TURNS; ++j)
+        {
+            o = euler_turn(o, r, STEP);
+            go->move_and_rotate(STEP);
+        }
+        euler_err = std::max(euler_err, angle_between(o, want));
+        euler_norm = std::max(euler_norm, fabs(glm::length(o) - 1.0));
+
+        glm::dquat q = go->get_orientation();
+        exp_err = std::max(exp_err, angle_between(q, want));
+        exp_norm = std::max(exp_norm, fabs(glm::length(q) - 1.0));
+        delete go;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    double euler, exp_map, euler_err, euler_norm, exp_err, exp_norm;
+
+    plan(3);
+
+    /* Nothing gets to fall asleep partway through */
+    MotionState::set_sleep(0.0, 0.0, 0.0);
+    create_spins(SPINNERS);
+
+    /* The old way, for comparison */
+    euler = bench_euler();
+    exp_map = bench_exp_map();
+    bench_integrate();
+
+    create_spins(DRIFTERS);
+    drift(euler_err, euler_norm, exp_err, exp_norm);
+    report_drift("Euler angles", euler_err, euler_norm);
+    report_drift("exp map", exp_err, exp_norm);
+
+    ok(exp_map < euler, "exp map is cheaper than Euler angles");
+    ok(exp_err < 1e-6, "exp map stays on the turn");
+    ok(exp_norm < 1e-12, "exp map stays a unit quaternion");
+    return exit_status();
+}
@@ -0,0 +1,265 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "../server/classes/zone.h"
+
+#include "mock_db.h"
+#include "mock_server_globals.h"
+#include "bench_util.h"
+
+#define SECTOR_SIZE  1000
+#define PER_SECTOR   5000
+#define LOGINS       20
+
+int world_steps = 1;
+
+class world_DB : public fake_DB
+{
+  public:
+    world_DB(const std::string& a, int b, const std::string& c,
+             const std::string& d, const std::string& e)
+        : fake_DB(a, b, c, d, e)
+        {};
+    virtual ~world_DB() {};
+
+    virtual int get_server_objects(GameObject::objects_map& a)
+        {
+            double extent = (double)SECTOR_SIZE * world_steps;
+            int count = PER_SECTOR * world_steps * world_steps, i;
+
+            for (i = 0; i < count; ++i)
+            {
+                a[i + 1] = new GameObject(NULL, NULL, i + 1);
+                a[i + 1]->set_position(
+                    glm::dvec3(bench_random(0.0, extent),
+                               bench_random(0.0, extent),
+                               bench_random(0.0, SECTOR_SIZE)));
+            }
+            return count;
+        };
+};
+
+/* Hands over a world that's already been made, so that timing the
+ * zone's construction doesn't include creating all the objects.
+ */
+GameObject::objects_map preloaded;
+
+class preloaded_DB : public fake_DB
+{
+  public:
+    preloaded_DB(const std::string& a, int b, const std::string& c,
+                 const std::string& d, const std::string& e)
+        : fake_DB(a, b, c, d, e)
+        {};
+    virtual ~preloaded_DB() {};
+
+    virtual int get_server_objects(GameObject::objects_map& a)
+        {
+            a.swap(preloaded);
+            return a.size();
+        };
+};
+
+/* What send_nearby_objects used to do:  look at everything */
+void full_scan(uint64_t objid)
+{
+    GameObject *go = zone->find_game_object(objid);
+
+    update_pool->push(go);
+    for (auto& gi : zone->game_objects)
+    {
+        if (gi.second != go
+            && go->distance_from(gi.second->get_position()) < 1000.0)
+            update_pool->push(gi.second);
+    }
+}
+
+void bench_login(int steps)
+{
+    std::string test = "login: ";
+    std::vector<uint64_t> logins;
+    std::ostringstream s;
+    unsigned int scan_sent, query_sent;
+    double scan_time, query_time;
+    int i;
+
+    world_steps = steps;
+    database = new world_DB("a", 0, "b", "c", "d");
+    zone = new Zone(SECTOR_SIZE, SECTOR_SIZE, SECTOR_SIZE,
+                    steps, steps, 1, database);
+    for (i = 0; i < LOGINS; ++i)
+        logins.push_back(1 + bench_rng() % zone->game_objects.size());
+
+    update_pool = new UpdatePool("bench", 1);
+    {
+        bench_timer t;
+
+        for (auto id : logins)
+            full_scan(id);
+        scan_time = t.elapsed();
+    }
+    scan_sent = update_pool->queue_size();
+    delete update_pool;
+
+    update_pool = new UpdatePool("bench", 1);
+    {
+        bench_timer t;
+
+        for (auto id : logins)
+            zone->send_nearby_objects(id);
+        query_time = t.elapsed();
+    }
+    query_sent = update_pool->queue_size();
+    delete update_pool;
+
+    s << zone->game_objects.size() << " objects in " << steps * steps
+      << " sectors: scan " << scan_time * 1e6 / LOGINS
+      << " us, range query " << query_time * 1e6 / LOGINS
+      << " us per login, " << query_sent / LOGINS << " objects sent";
+    note(s.str());
+    is(query_sent, scan_sent, test + "same objects sent");
+
+    delete zone;
+    delete (world_DB *)database;
+}
+
+/* Resident set size, in bytes */
+size_t resident(void)
+{
+    std::ifstream statm("/proc/self/statm");
+    size_t size = 0, rss = 0;
+
+    statm >> size >> rss;
+    return rss * sysconf(_SC_PAGESIZE);
+}
+
+void bench_startup(int x, int y, int z)
+{
+    std::string test = "startup: ";
+    std::ostringstream s;
+    size_t before;
+    double secs;
+
+    database = new fake_DB("a", 0, "b", "c", "d");
+    before = resident();
+    {
+        bench_timer t;
+
+        zone = new Zone(SECTOR_SIZE, SECTOR_SIZE, SECTOR_SIZE,
+                        x, y, z, database);
+        secs = t.elapsed();
+    }
+
+    s << x << 'x' << y << 'x' << z << " sectors: " << secs * 1e3
+      << " ms to start, " << (resident() - before) / 1048576.0
+      << " MB resident";
+    note(s.str());
+    is(zone->sector_count(), 0, test + "no sectors created");
+
+    delete zone;
+    delete (fake_DB *)database;
+}
+
+/* Loading a world of count objects into 10x10x10 sectors, one at a
+ * time the way we used to, and in bulk.
+ */
+void bench_load(size_t count)
+{
+    std::string test = "load: ";
+    std::ostringstream s;
+    double extent = (double)SECTOR_SIZE * 10, insert_time, build_time;
+    size_t i, sectors, missing = 0;
+
+    s << count << " objects: ";
+    test += s.str();
+
+    /* Objects, the map and their trees take somewhere around 700
+     * bytes apiece.
+     */
+    if ((double)sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGESIZE)
+        < count * 700.0)
+    {
+        skip(2, test + "not enough memory");
+        return;
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        GameObject *go = new GameObject(NULL, NULL, i + 1);
+
+        go->set_position(glm::dvec3(bench_random(0.0, extent),
+                                    bench_random(0.0, extent),
+                                    bench_random(0.0, extent)));
+        preloaded[i + 1] = go;
+    }
+    database = new preloaded_DB("a", 0, "b", "c", "d");
+
+    /* Before:  an empty zone, with the objects inserted one by one */
+    {
+        GameObject::objects_map empty;
+
+        empty.swap(preloaded);
+        zone = new Zone(SECTOR_SIZE, SECTOR_SIZE, SECTOR_SIZE,
+                        10, 10, 10, database);
+        empty.swap(preloaded);
+    }
+    {
+        bench_timer t;
+
+        for (auto& go : preloaded)
+            zone->sector_contains(go.second->get_position())
+                ->insert(go.second);
+        insert_time = t.elapsed();
+    }
+    sectors = zone->sector_count();
+    delete zone;
+
+    /* After:  everything sorted into sectors and built at once */
+    {
+        bench_timer t;
+
+        zone = new Zone(SECTOR_SIZE, SECTOR_SIZE, SECTOR_SIZE,
+                        10, 10, 10, database);
+        build_time = t.elapsed();
+    }
+    is(zone->sector_count(), sectors, test + "same sectors");
+    for (auto& go : zone->game_objects)
+        if (go.first % 1000 == 0
+            && zone->sector_contains(go.second->get_position())
+            ->find(go.second) == NULL)
+            ++missing;
+    is(missing, 0, test + "objects placed");
+
+    s.str("");
+    s << count << " objects: insert " << insert_time * 1e3 << " ms, bulk "
+      << build_time * 1e3 << " ms with "
+      << std::thread::hardware_concurrency() << " cores";
+    note(s.str());
+
+    delete zone;
+    delete (preloaded_DB *)database;
+}
+
+int main(int argc, char **argv)
+{
+    plan(11);
+
+    bench_startup(1000, 1000, 10);
+    bench_load(100000);
+    bench_load(1000000);
+    bench_load(10000000);
+
+    bench_login(1);
+    bench_login(2);
+    bench_login(4);
+    bench_login(8);
+    return exit_status();
+}
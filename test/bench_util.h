@@ -0,0 +1,105 @@
+#ifndef __INC_BENCH_UTIL_H__
+#define __INC_BENCH_UTIL_H__
+
+#include <stdlib.h>
+#include <malloc.h>
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <random>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "../server/classes/game_obj.h"
+
+/* Every allocation in the benchmark program goes through here, so we
+ * can count how many each operation costs, and how much memory is in
+ * use at any given time.
+ */
+std::atomic<uint64_t> alloc_count(0);
+std::atomic<int64_t> alloc_bytes(0);
+
+void *operator new(size_t sz)
+{
+    void *ptr;
+
+    ++alloc_count;
+    if ((ptr = malloc(sz == 0 ? 1 : sz)) == NULL)
+        throw std::bad_alloc();
+    alloc_bytes += malloc_usable_size(ptr);
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    alloc_bytes -= malloc_usable_size(ptr);
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t sz) noexcept
+{
+    alloc_bytes -= malloc_usable_size(ptr);
+    free(ptr);
+}
+
+class bench_timer
+{
+  private:
+    std::chrono::steady_clock::time_point start;
+
+  public:
+    bench_timer() : start(std::chrono::steady_clock::now()) {};
+
+    double elapsed(void)
+        {
+            std::chrono::duration<double> d
+                = std::chrono::steady_clock::now() - this->start;
+            return d.count();
+        };
+};
+
+/* Fixed seed, so runs are comparable */
+std::mt19937_64 bench_rng(0x5239);
+
+double bench_random(double lo, double hi)
+{
+    std::uniform_real_distribution<double> dist(lo, hi);
+
+    return dist(bench_rng);
+}
+
+/* Objects numbered from 1, scattered through a box with one corner at
+ * the origin.  Anything else a benchmark needs for them, it adds
+ * itself.  The cube version keeps the default geometry's radius
+ * unless it's told otherwise.
+ */
+std::vector<GameObject *> bench_objects(size_t count,
+                                        const glm::dvec3& size,
+                                        double radius)
+{
+    std::vector<GameObject *> objs;
+
+    objs.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        GameObject *go = new GameObject(NULL, NULL, i + 1);
+
+        go->geometry->radius = radius;
+        go->set_position(glm::dvec3(bench_random(0.0, size.x),
+                                    bench_random(0.0, size.y),
+                                    bench_random(0.0, size.z)));
+        objs.push_back(go);
+    }
+    return objs;
+}
+
+std::vector<GameObject *> bench_objects(size_t count,
+                                        double size,
+                                        double radius = 0.5)
+{
+    return bench_objects(count, glm::dvec3(size, size, size), radius);
+}
+
+#endif /* __INC_BENCH_UTIL_H__ */
@@ -7,6 +7,7 @@
 #include "../server/classes/action_pool.h"
 #include "../server/classes/motion_pool.h"
 #include "../server/classes/update_pool.h"
+#include "../server/classes/recorder.h"
 #include "../server/classes/listensock.h"
 #include "../server/classes/modules/db.h"
 #include "../server/classes/console.h"
@@ -16,6 +17,7 @@ Zone *zone = NULL;
 ActionPool *action_pool = NULL;   /* Takes action requests      */
 MotionPool *motion_pool = NULL;   /* Processes motion/collision */
 UpdatePool *update_pool = NULL;   /* Sends motion updates       */
+Recorder *recorder = NULL;        /* Writes down what happens   */
 DB *database = NULL;
 std::vector<listen_socket *> sockets;
 std::vector<Console *> consoles;
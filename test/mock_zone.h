@@ -4,7 +4,7 @@
 #include "../server/classes/zone.h"
 
 int send_nearby_objects_count = 0;
-Octree *sector_contains_result = NULL;
+SpatialIndex *sector_contains_result = NULL;
 glm::ivec3 which_sector_result(0, 0, 0);
 
 class fake_Zone : public Zone
@@ -18,7 +18,7 @@ class fake_Zone : public Zone
             ++send_nearby_objects_count;
         };
 
-    virtual Octree *sector_contains(glm::dvec3& a)
+    virtual SpatialIndex *sector_contains(glm::dvec3& a)
         {
             return sector_contains_result;
         };
@@ -222,7 +222,9 @@ void test_parse_command_line(void)
     std::string test = "parse command line: ";
     std::string fname = "./t_config_data.fake";
     char prog[] = "r9d", d_arg[] = "-d", f_arg[] = "-f", n_arg[] = "-n";
-    char *args[5] = { prog, d_arg, f_arg, (char *)fname.c_str(), n_arg };
+    char r_arg[] = "-r", r_fname[] = "some.rec";
+    char *args[7] = { prog, d_arg, f_arg, (char *)fname.c_str(), n_arg,
+                      r_arg, r_fname };
     config_data *conf = new config_data;
 
     std::ofstream ofs(fname);
@@ -232,15 +234,16 @@ void test_parse_command_line(void)
     conf->daemonize = true;
     try
     {
-        conf->parse_command_line(5, args);
+        conf->parse_command_line(7, args);
     }
     catch (...)
     {
         fail(test + "parse exception");
         return;
     }
-    is(conf->argv.size(), 5, test + "expected args size");
+    is(conf->argv.size(), 7, test + "expected args size");
     is(conf->daemonize, false, test + "expected daemonize");
+    is(conf->replay_fname, "some.rec", test + "expected replay fname");
 
     unlink(fname.c_str());
     delete conf;
@@ -296,6 +299,20 @@ void test_parse_config_file(void)
     ofs << "Port dgram:1.2.3.4:9876" << std::endl;
     ofs << "Port stream:[f00f::abcd]:9876" << std::endl;
     ofs << "ZoneSize 10 15 20 25 30 35" << std::endl;
+    ofs << "OctreeLooseness 2.5" << std::endl;
+    ofs << "Broadphase sap" << std::endl;
+    ofs << "SpatialIndex linear" << std::endl;
+    ofs << "OctreeMinDepth 2" << std::endl;
+    ofs << "OctreeMaxDepth 12" << std::endl;
+    ofs << "OctreeLeafObjects 6" << std::endl;
+    ofs << "OctreeAdaptive yes" << std::endl;
+    ofs << "TickRate 60" << std::endl;
+    ofs << "Gravity 6.67e-11" << std::endl;
+    ofs << "GravityTheta 0.7" << std::endl;
+    ofs << "SleepSpeed 0.05" << std::endl;
+    ofs << "SleepSpin 0.02" << std::endl;
+    ofs << "SleepAfter 2.5" << std::endl;
+    ofs << "RecordFile some.rec" << std::endl;
     ofs.close();
 
     st = "default values: ";
@@ -319,6 +336,32 @@ void test_parse_config_file(void)
        test + st + "expected zone y steps");
     is(config.size.steps[2], config_data::ZONE_STEPS,
        test + st + "expected zone z steps");
+    is(config.octree_looseness == config_data::OCTREE_LOOSENESS, true,
+       test + st + "expected octree looseness");
+    is(config.broadphase, config_data::BROADPHASE,
+       test + st + "expected broadphase");
+    is(config.spatial_index, config_data::SPATIAL_INDEX,
+       test + st + "expected spatial index");
+    is(config.octree_min_depth, config_data::OCTREE_MIN_DEPTH,
+       test + st + "expected octree min depth");
+    is(config.octree_max_depth, config_data::OCTREE_MAX_DEPTH,
+       test + st + "expected octree max depth");
+    is(config.octree_leaf_objects, config_data::OCTREE_LEAF_OBJECTS,
+       test + st + "expected octree leaf objects");
+    is(config.octree_adaptive, false, test + st + "expected octree adaptive");
+    is(config.tick_rate, config_data::TICK_RATE,
+       test + st + "expected tick rate");
+    is(config.gravity == config_data::GRAVITY, true,
+       test + st + "expected gravity");
+    is(config.gravity_theta == config_data::GRAVITY_THETA, true,
+       test + st + "expected gravity theta");
+    is(config.sleep_speed == config_data::SLEEP_SPEED, true,
+       test + st + "expected sleep speed");
+    is(config.sleep_spin == config_data::SLEEP_SPIN, true,
+       test + st + "expected sleep spin");
+    is(config.sleep_after == config_data::SLEEP_AFTER, true,
+       test + st + "expected sleep after");
+    is(config.record_fname, "", test + st + "expected record fname");
 
     getpwnam_count = seteuid_count = 0;
     getgrnam_count = setegid_count = 0;
@@ -342,6 +385,22 @@ void test_parse_config_file(void)
     is(config.size.steps[0], 25, test + st + "expected zone x steps");
     is(config.size.steps[1], 30, test + st + "expected zone y steps");
     is(config.size.steps[2], 35, test + st + "expected zone z steps");
+    is(config.octree_looseness, 2.5, test + st + "expected octree looseness");
+    is(config.broadphase, "sap", test + st + "expected broadphase");
+    is(config.spatial_index, "linear", test + st + "expected spatial index");
+    is(config.octree_min_depth, 2, test + st + "expected octree min depth");
+    is(config.octree_max_depth, 12, test + st + "expected octree max depth");
+    is(config.octree_leaf_objects, 6,
+       test + st + "expected octree leaf objects");
+    is(config.octree_adaptive, true, test + st + "expected octree adaptive");
+    is(config.tick_rate, 60, test + st + "expected tick rate");
+    is(config.gravity == 6.67e-11, true, test + st + "expected gravity");
+    is(config.gravity_theta == 0.7, true,
+       test + st + "expected gravity theta");
+    is(config.sleep_speed == 0.05, true, test + st + "expected sleep speed");
+    is(config.sleep_spin == 0.02, true, test + st + "expected sleep spin");
+    is(config.sleep_after == 2.5, true, test + st + "expected sleep after");
+    is(config.record_fname, "some.rec", test + st + "expected record fname");
 }
 
 void test_bad_key(void)
@@ -377,7 +436,7 @@ void test_bad_key(void)
 
 int main(int argc, char **argv)
 {
-    plan(84);
+    plan(113);
 
     test_create_delete();
     test_setup_cleanup();
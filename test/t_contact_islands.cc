@@ -0,0 +1,133 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "../server/classes/contact_islands.h"
+
+#define CLUSTERS 50
+
+/* Each cluster is a little chain of three:  the middle one touches
+ * both of the others, which don't touch each other, and the ends are
+ * both heading in.
+ */
+std::vector<GameObject *> make_world(uint64_t base)
+{
+    std::vector<GameObject *> world;
+
+    for (int i = 0; i < CLUSTERS; ++i)
+    {
+        GameObject *a = new GameObject(NULL, NULL, base + i * 3);
+        GameObject *b = new GameObject(NULL, NULL, base + i * 3 + 1);
+        GameObject *c = new GameObject(NULL, NULL, base + i * 3 + 2);
+
+        a->set_position(glm::dvec3(10.0 * i, 0.0, 0.0));
+        a->set_movement(glm::dvec3(1.0, 0.0, 0.0));
+        b->set_position(glm::dvec3(10.0 * i + 0.8, 0.1, 0.0));
+        c->set_position(glm::dvec3(10.0 * i + 1.6, 0.0, 0.1));
+        c->set_movement(glm::dvec3(-1.0, 0.5, 0.0));
+        world.push_back(a);
+        world.push_back(b);
+        world.push_back(c);
+    }
+    return world;
+}
+
+void find_contacts(ContactIslands& islands, std::vector<GameObject *>& world)
+{
+    for (auto a : world)
+        for (auto b : world)
+            if (a->contact(b) >= 0.0)
+                islands.add(a, b);
+}
+
+void test_build(void)
+{
+    std::string test = "build: ";
+    ContactIslands islands;
+    std::vector<GameObject *> go;
+
+    for (int i = 0; i < 6; ++i)
+        go.push_back(new GameObject(NULL, NULL, 100LL + i));
+
+    is(islands.build(), 0, test + "expected empty islands");
+
+    /* Added backwards, and more than once */
+    islands.add(go[4], go[3]);
+    islands.add(go[2], go[1]);
+    islands.add(go[0], go[1]);
+    islands.add(go[1], go[0]);
+    islands.add(go[5], go[5]);
+    is(islands.build(), 2, test + "expected islands");
+    is(islands.contacts(), 3, test + "expected contacts");
+    is(islands[0].members.size(), 3, test + "expected members");
+    is(islands[0].contacts[0].first == go[0]
+       && islands[0].contacts[0].second == go[1]
+       && islands[0].contacts[1].first == go[1]
+       && islands[0].contacts[1].second == go[2], true,
+       test + "expected contact order");
+    is(islands.island_of(go[3]), 1, test + "expected island");
+    is(islands.island_of(go[5]), -1, test + "expected lone object");
+
+    islands.clear();
+    is(islands.size(), 0, test + "expected cleared");
+
+    for (auto g : go)
+        delete g;
+}
+
+/* However the islands are spread over the threads, they all end up
+ * in the same place.
+ */
+void test_solve(void)
+{
+    std::string test = "solve: ";
+    ContactIslands in_order, spread;
+    std::vector<GameObject *> one = make_world(1000LL);
+    std::vector<GameObject *> two = make_world(2000LL);
+    std::vector<std::thread> th;
+    bool same = true;
+    size_t hits = 0;
+
+    find_contacts(in_order, one);
+    std::reverse(two.begin(), two.end());
+    find_contacts(spread, two);
+    std::reverse(two.begin(), two.end());
+
+    is(in_order.build(), CLUSTERS, test + "expected islands");
+    spread.build();
+
+    for (size_t i = 0; i < in_order.size(); ++i)
+        hits += in_order.solve(i);
+    for (int t = 0; t < 4; ++t)
+        th.push_back(std::thread([&spread, t]() {
+            for (int i = spread.size() - 1 - t; i >= 0; i -= 4)
+                spread.solve(i);
+        }));
+    for (auto& t : th)
+        t.join();
+
+    ok(hits > 0, test + "expected hits");
+    for (size_t i = 0; i < one.size(); ++i)
+        if (one[i]->get_position() != two[i]->get_position()
+            || one[i]->get_movement() != two[i]->get_movement())
+            same = false;
+    is(same, true, test + "same results on any thread");
+
+    for (auto g : one)
+        delete g;
+    for (auto g : two)
+        delete g;
+}
+
+int main(int argc, char **argv)
+{
+    plan(11);
+
+    test_build();
+    test_solve();
+    return exit_status();
+}
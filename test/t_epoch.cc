@@ -0,0 +1,76 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <atomic>
+#include <thread>
+
+#include "../server/classes/epoch.h"
+
+void test_single_reader(void)
+{
+    std::string test = "single reader: ";
+    uint64_t stamp;
+
+    stamp = Epoch::now();
+    is(Epoch::safe(stamp, Epoch::oldest()), true,
+       test + "safe with no readers");
+
+    {
+        Epoch::reader guard;
+
+        stamp = Epoch::now();
+        is(Epoch::safe(stamp, Epoch::oldest()), false,
+           test + "not safe while reading");
+        {
+            Epoch::reader inner;
+        }
+        is(Epoch::safe(stamp, Epoch::oldest()), false,
+           test + "nested reader doesn't end the read");
+    }
+    is(Epoch::safe(stamp, Epoch::oldest()), true,
+       test + "safe after reading");
+
+    /* A reader which starts after something was unlinked can't see it */
+    stamp = Epoch::now();
+    Epoch::oldest();
+    {
+        Epoch::reader guard;
+
+        is(Epoch::safe(stamp, Epoch::oldest()), true,
+           test + "later readers don't hold things back");
+    }
+}
+
+void test_other_thread(void)
+{
+    std::string test = "other thread: ";
+    std::atomic<int> step(0);
+    uint64_t stamp;
+
+    std::thread th([&]() {
+        Epoch::reader guard;
+
+        step = 1;
+        while (step != 2)
+            std::this_thread::yield();
+    });
+    while (step != 1)
+        std::this_thread::yield();
+    stamp = Epoch::now();
+    is(Epoch::safe(stamp, Epoch::oldest()), false,
+       test + "not safe while other thread reads");
+    step = 2;
+    th.join();
+    is(Epoch::safe(stamp, Epoch::oldest()), true,
+       test + "safe after other thread is done");
+}
+
+int main(int argc, char **argv)
+{
+    plan(7);
+
+    test_single_reader();
+    test_other_thread();
+    return exit_status();
+}
@@ -2,6 +2,8 @@
 
 using namespace TAP;
 
+#include <cmath>
+
 #include "../server/classes/game_obj.h"
 
 void test_create_delete(void)
@@ -180,8 +182,8 @@ void test_accessors(void)
     ok(go->get_movement() == test_vec, test + "expected movement");
     go->set_orientation(test_quat);
     ok(go->get_orientation() == test_quat, test + "expected orientation");
-    go->set_rotation(test_quat);
-    ok(go->get_rotation() == test_quat, test + "expected rotation");
+    go->set_rotation(test_vec);
+    ok(go->get_rotation() == test_vec, test + "expected rotation");
 
     delete go;
     delete con;
@@ -203,7 +205,7 @@ void test_move_and_rotate(void)
        test + "expected no rotation");
 
     go->set_movement(glm::dvec3(1.0, 1.0, 1.0));
-    go->set_rotation(glm::dquat(1.0, 0.0, 0.0, 1.0));
+    go->set_rotation(glm::dvec3(0.0, 0.0, 1.0));
 
     usleep(100);
     go->move_and_rotate();
@@ -249,6 +251,31 @@ void test_collide(void)
 
     ok(result, test + st + "expected result");
 
+    /* Fast enough to go right through go2 in one move */
+    st = "swept: ";
+    go1->set_position(glm::dvec3(0.0, 0.0, 0.0));
+    go1->set_movement(glm::dvec3(1000000.0, 0.0, 0.0));
+    go2->set_position(glm::dvec3(500.0, 0.0, 0.0));
+    usleep(1000);
+    go1->move_and_rotate();
+
+    result = go1->collide(go2);
+
+    ok(result, test + st + "expected result");
+    is(fabs(go1->distance_from(go2->get_position()) - 1.0) < 1e-6, true,
+       test + st + "backed up to contact");
+
+    st = "swept miss: ";
+    go1->set_position(glm::dvec3(0.0, 0.0, 0.0));
+    go1->set_movement(glm::dvec3(1000000.0, 0.0, 0.0));
+    go2->set_position(glm::dvec3(500.0, 10.0, 0.0));
+    usleep(1000);
+    go1->move_and_rotate();
+
+    result = go1->collide(go2);
+
+    not_ok(result, test + st + "expected result");
+
     delete go2;
     delete go1;
 }
@@ -287,7 +314,7 @@ void test_update(void)
 
 int main(int argc, char **argv)
 {
-    plan(46);
+    plan(49);
 
     test_create_delete();
     test_clone();
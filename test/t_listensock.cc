@@ -439,7 +439,7 @@ void test_listen_socket_handle_action(void)
     st = "working: ";
     bu->timestamp = 0;
     go->set_position({50.0f, 50.0f, 50.0f});
-    sector_contains_result = (Octree *)bu;
+    sector_contains_result = (SpatialIndex *)bu;
     listen_socket::handle_action(listen, p, bu, NULL);
     isnt(bu->timestamp, 0, test + st + "expected timestamp");
     isnt(action_pool->queue_size(), 0, test + st + "expected queue size");
@@ -2,7 +2,14 @@
 
 using namespace TAP;
 
+#include <unistd.h>
+
+#include <cmath>
+#include <random>
+
 #include "../server/classes/motion_pool.h"
+#include "../server/classes/octree.h"
+#include "../server/classes/config_data.h"
 
 #include "mock_db.h"
 #include "mock_zone.h"
@@ -51,6 +58,9 @@ void test_operate(void)
     go1->set_movement(glm::dvec3(1.0, 1.0, 1.0));
     motion_pool->push(go1);
     is(motion_pool->queue_size(), 1, test + "expected queue size");
+    motion_pool->push(go1);
+    is(motion_pool->queue_size(), 1, test + "only queued once");
+    is(motion_pool->duplicates, 1, test + "expected duplicates");
     go2->set_position(glm::dvec3(123.0, 123.0, 123.0));
     go2->set_movement(glm::dvec3(0.0, 1.0, 1.0));
     motion_pool->push(go2);
@@ -60,11 +70,11 @@ void test_operate(void)
     motion_pool->push(go3);
     is(motion_pool->queue_size(), 3, test + "expected queue size");
     go4->set_position(glm::dvec3(0.0, 0.0, 0.0));
-    go4->set_rotation(glm::angleAxis(1.0, glm::dvec3(1.0, 0.0, 0.0)));
+    go4->set_rotation(glm::dvec3(1.0, 0.0, 0.0));
     motion_pool->push(go4);
     is(motion_pool->queue_size(), 4, test + "expected queue size");
     go5->set_position(glm::dvec3(1.0, 1.0, 1.0));
-    go5->set_rotation(glm::angleAxis(1.0, glm::dvec3(0.0, 1.0, 0.0)));
+    go5->set_rotation(glm::dvec3(0.0, 1.0, 0.0));
     motion_pool->push(go5);
     is(motion_pool->queue_size(), 5, test + "expected queue size");
     go6->set_position(glm::dvec3(2.0, 2.0, 2.0));
@@ -136,20 +146,297 @@ void test_collide(void)
 
     isnt(motion_pool->queue_size(), 0, test + st + "expected queue length");
 
+    /* Right through go2 in one move, and backed up to where it hit */
+    st = "swept: ";
+    sector->remove(go1);
+    go1->set_position(glm::dvec3(123.0, 123.0, 0.0));
+    go1->set_movement(glm::dvec3(0.0, 0.0, 200000.0));
+    usleep(1000);
+    go1->move_and_rotate();
+    sector->insert(go1);
+
+    is(motion_pool->collide(sector, go1), true, test + st + "expected hit");
+    is(sector->find(go1) != NULL
+       && go1->get_position().z < 123.0, true,
+       test + st + "expected position");
+
+    /* A big target sticks out of the nodes near its center, into the
+     * ones our move goes through.
+     */
+    st = "big target: ";
+    Geometry *big = new Geometry();
+    big->radius = 50.0;
+    GameObject *go3 = new GameObject(big, NULL, 9878LL);
+    go3->set_position(glm::dvec3(640.0, 600.0, 600.0));
+    sector->insert(go3);
+    sector->remove(go1);
+    go1->set_position(glm::dvec3(600.0, 600.0, 590.0));
+    go1->set_movement(glm::dvec3(0.0, 0.0, 20.0));
+    go1->move_and_rotate(1.0);
+    sector->insert(go1);
+
+    is(motion_pool->collide(sector, go1), true, test + st + "expected hit");
+
+    sector->remove(go3);
     sector->remove(go2);
     sector->remove(go1);
+    delete go3;
     delete go2;
     delete go1;
     delete sector;
     delete motion_pool;
 }
 
+/* Each tick moves an object once, by exactly one timestep, and sends
+ * one update for it.
+ */
+void test_tick(void)
+{
+    std::string test = "tick: ";
+    std::streambuf *orig_rdbuf = std::clog.rdbuf(new Log("blah", LOG_DAEMON));
+    GameObject *go = new GameObject(NULL, NULL, 9999LL);
+    glm::dvec3 start(500.0, 500.0, 500.0);
+    double expected;
+
+    database = new fake_DB("a", 0, "b", "c", "d");
+    zone = new Zone(1000, 1, database);
+    motion_pool = new MotionPool("t_motion", 2, 100);
+    update_pool = new UpdatePool("mot_test", 1);
+
+    go->set_position(start);
+    go->set_movement(glm::dvec3(0.0, 0.0, 1.0));
+    zone->sector_contains(start)->insert(go);
+
+    motion_pool->push(go);
+    is(motion_pool->queue_size(), 0, test + "waits for the next tick");
+
+    motion_pool->start();
+    usleep(200000);
+    motion_pool->stop();
+
+    expected = start.z + motion_pool->moves * 0.01;
+    ok(motion_pool->ticks > 0, test + "expected ticks");
+    is(fabs(go->get_position().z - expected) < 1e-9, true,
+       test + "one timestep per move");
+    is(update_pool->queue_size(), motion_pool->moves,
+       test + "one update per move");
+    is(motion_pool->report().find("tick mode, 100 Hz") == 0, true,
+       test + "expected report");
+
+    delete update_pool;
+    delete motion_pool;
+    delete zone;
+    delete go;
+    delete (fake_DB *)database;
+    delete std::clog.rdbuf(orig_rdbuf);
+}
+
+/* Two objects heading right into each other get sorted out as one
+ * island, and both of them get updates.
+ */
+void test_tick_collide(void)
+{
+    std::string test = "tick collide: ";
+    std::streambuf *orig_rdbuf = std::clog.rdbuf(new Log("blah", LOG_DAEMON));
+    GameObject *go1 = new GameObject(NULL, NULL, 9998LL);
+    GameObject *go2 = new GameObject(NULL, NULL, 9999LL);
+
+    database = new fake_DB("a", 0, "b", "c", "d");
+    zone = new Zone(1000, 1, database);
+    motion_pool = new MotionPool("t_motion", 2, 100);
+    update_pool = new UpdatePool("mot_test", 1);
+
+    go1->set_position(glm::dvec3(500.0, 500.0, 500.0));
+    go1->set_movement(glm::dvec3(5.0, 0.0, 0.0));
+    go2->set_position(glm::dvec3(501.2, 500.0, 500.0));
+    go2->set_movement(glm::dvec3(-5.0, 0.0, 0.0));
+    zone->sector_contains(go1->get_position())->insert(go1);
+    zone->sector_contains(go2->get_position())->insert(go2);
+
+    motion_pool->start();
+    usleep(200000);
+    motion_pool->stop();
+
+    ok(motion_pool->islands > 0 && motion_pool->contacts > 0,
+       test + "expected islands");
+    is(motion_pool->report().find(" islands") != std::string::npos, true,
+       test + "expected report");
+
+    delete update_pool;
+    delete motion_pool;
+    delete zone;
+    delete go2;
+    delete go1;
+    delete (fake_DB *)database;
+    delete std::clog.rdbuf(orig_rdbuf);
+}
+
+/* With a sweep-and-prune broadphase, the whole sector is checked at
+ * once, and something fast still can't skip through a sitting duck.
+ */
+void test_tick_sweep(void)
+{
+    std::string test = "tick sweep: ";
+    std::streambuf *orig_rdbuf = std::clog.rdbuf(new Log("blah", LOG_DAEMON));
+    GameObject *go1 = new GameObject(NULL, NULL, 9998LL);
+    GameObject *go2 = new GameObject(NULL, NULL, 9999LL);
+
+    database = new fake_DB("a", 0, "b", "c", "d");
+    config.broadphase = "sap";
+    zone = new Zone(1000, 1, database);
+    motion_pool = new MotionPool("t_motion", 2, 100);
+    motion_pool->paced = false;
+    update_pool = new UpdatePool("mot_test", 1);
+
+    go1->set_position(glm::dvec3(500.0, 500.0, 500.0));
+    go1->set_movement(glm::dvec3(5000.0, 0.0, 0.0));
+    go2->set_position(glm::dvec3(525.0, 500.0, 500.0));
+    zone->sector_contains(go1->get_position())->insert(go1);
+    zone->sector_contains(go2->get_position())->insert(go2);
+    is(zone->sector_contains(go1->get_position())->broadphase != NULL, true,
+       test + "sector has a broadphase");
+
+    motion_pool->start();
+    motion_pool->tick();
+    motion_pool->stop();
+    ok(motion_pool->islands > 0 && motion_pool->contacts > 0,
+       test + "expected islands");
+    ok(go1->get_position().x < 525.0, test + "stopped where it hit");
+    ok(go2->still_moving(), test + "got knocked along");
+    is(update_pool->queue_size(), 2, test + "both got updates");
+
+    delete update_pool;
+    delete motion_pool;
+    delete zone;
+    delete go2;
+    delete go1;
+    delete (fake_DB *)database;
+    config.broadphase = config_data::BROADPHASE;
+    delete std::clog.rdbuf(orig_rdbuf);
+}
+
+/* With gravity, two objects sitting still start falling together */
+void test_tick_gravity(void)
+{
+    std::string test = "tick gravity: ";
+    std::streambuf *orig_rdbuf = std::clog.rdbuf(new Log("blah", LOG_DAEMON));
+    GameObject *go1 = new GameObject(NULL, NULL, 9998LL);
+    GameObject *go2 = new GameObject(NULL, NULL, 9999LL);
+
+    database = new fake_DB("a", 0, "b", "c", "d");
+    zone = new Zone(1000, 1, database);
+    motion_pool = new MotionPool("t_motion", 2, 100);
+    motion_pool->gravity = 100.0;
+    update_pool = new UpdatePool("mot_test", 1);
+
+    go1->set_position(glm::dvec3(500.0, 500.0, 500.0));
+    go2->set_position(glm::dvec3(510.0, 500.0, 500.0));
+    zone->sector_contains(go1->get_position())->insert(go1);
+    zone->sector_contains(go2->get_position())->insert(go2);
+
+    motion_pool->start();
+    usleep(200000);
+    motion_pool->stop();
+
+    is(go1->get_position().x > 500.0 && go2->get_position().x < 510.0, true,
+       test + "fell together");
+    is(motion_pool->report().find("gravity 100, ") != std::string::npos,
+       true, test + "expected report");
+
+    delete update_pool;
+    delete motion_pool;
+    delete zone;
+    delete go2;
+    delete go1;
+    delete (fake_DB *)database;
+    delete std::clog.rdbuf(orig_rdbuf);
+}
+
+#define STRESS_OBJECTS 100000
+
+void test_handoff(void)
+{
+    std::string test = "handoff: ";
+    std::streambuf *orig_rdbuf = std::clog.rdbuf(new Log("blah", LOG_DAEMON));
+    std::vector<GameObject *> go;
+    std::vector<glm::ivec3> start_sector;
+    std::mt19937 rng(0x5239);
+    std::uniform_real_distribution<double> across(0.0, 200.0);
+    std::uniform_real_distribution<double> near(-2.0, 2.0);
+    size_t total = 0;
+    int i, crossed = 0, misplaced = 0;
+
+    database = new fake_DB("a", 0, "b", "c", "d");
+    zone = new Zone(100, 2, database);
+    motion_pool = new MotionPool("t_motion", 4);
+    update_pool = new UpdatePool("mot_test", 1);
+
+    /* Everything starts right next to one of the seams, heading
+     * across it.
+     */
+    go.reserve(STRESS_OBJECTS);
+    for (i = 0; i < STRESS_OBJECTS; ++i)
+    {
+        glm::dvec3 pos(across(rng), across(rng), across(rng));
+        double offset = near(rng);
+
+        pos[i % 3] = 100.0 + offset;
+        go.push_back(new GameObject(NULL, NULL, 20000LL + i));
+        go.back()->geometry->radius = 0.001;
+        go.back()->set_position(pos);
+        go.back()->set_movement(glm::dvec3(i % 3 == 0 ? -offset * 10.0 : 0.0,
+                                           i % 3 == 1 ? -offset * 10.0 : 0.0,
+                                           i % 3 == 2 ? -offset * 10.0 : 0.0));
+        zone->sector_contains(pos)->insert(go.back());
+        start_sector.push_back(zone->which_sector(pos));
+    }
+    for (auto g : go)
+        motion_pool->push(g);
+
+    motion_pool->start();
+    sleep(2);
+    motion_pool->stop();
+
+    for (i = 0; i < STRESS_OBJECTS; ++i)
+    {
+        glm::dvec3 pos = go[i]->get_position();
+        SpatialIndex *sector = zone->sector_contains(pos);
+
+        if (zone->which_sector(pos) != start_sector[i])
+            ++crossed;
+        if (sector == NULL || sector->find(go[i]) == NULL)
+            ++misplaced;
+    }
+    for (i = 0; i < 8; ++i)
+        total += zone->sector_contains(glm::dvec3(i & 4 ? 150.0 : 50.0,
+                                                  i & 2 ? 150.0 : 50.0,
+                                                  i & 1 ? 150.0 : 50.0))
+            ->count;
+
+    ok(crossed > 0, test + "objects crossed sectors");
+    is(misplaced, 0, test + "every object in its own sector");
+    is(total, STRESS_OBJECTS, test + "nothing lost or duplicated");
+
+    delete update_pool;
+    delete motion_pool;
+    delete zone;
+    for (auto g : go)
+        delete g;
+    delete (fake_DB *)database;
+    delete std::clog.rdbuf(orig_rdbuf);
+}
+
 int main(int argc, char **argv)
 {
-    plan(21);
+    plan(43);
 
     test_start_stop();
     test_operate();
     test_collide();
+    test_tick();
+    test_tick_collide();
+    test_tick_sweep();
+    test_tick_gravity();
+    test_handoff();
     return exit_status();
 }
@@ -0,0 +1,313 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <math.h>
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../server/classes/game_obj.h"
+
+#define OBJECTS  1000
+#define STEPS    10
+#define STEP     0.1
+#define WRITES   200000
+#define TURNS    10000
+
+/* Only count what happens to our own objects */
+std::vector<std::pair<GameObject *, glm::dvec3> > integrate_ours(
+    const std::vector<GameObject *>& ours)
+{
+    std::vector<std::pair<GameObject *, glm::dvec3> > moved;
+
+    MotionState::integrate(
+        STEP,
+        [&](GameObject *go, const glm::dvec3& from) {
+            for (auto g : ours)
+                if (g == go)
+                    moved.push_back(std::make_pair(go, from));
+        }
+    );
+    return moved;
+}
+
+void test_create_delete(void)
+{
+    std::string test = "create/delete: ";
+    GameObject *go = new GameObject(NULL, NULL);
+
+    is(go->get_position() == glm::dvec3(0.0, 0.0, 0.0), true,
+       test + "expected position");
+    is(go->get_orientation() == glm::dquat(1.0, 0.0, 0.0, 0.0), true,
+       test + "expected orientation");
+    is(go->still_moving(), false, test + "not moving");
+
+    go->set_position(glm::dvec3(1.0, 2.0, 3.0));
+    go->set_movement(glm::dvec3(1.0, 0.0, 0.0));
+    delete go;
+
+    /* The next one gets the same slot, and none of what was in it */
+    go = new GameObject(NULL, NULL);
+    is(go->get_position() == glm::dvec3(0.0, 0.0, 0.0), true,
+       test + "reused slot has expected position");
+    is(go->still_moving(), false, test + "reused slot not moving");
+    delete go;
+}
+
+void test_integrate(void)
+{
+    std::string test = "integrate: ";
+    std::vector<GameObject *> go;
+    std::vector<std::pair<GameObject *, glm::dvec3> > moved;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        go.push_back(new GameObject(NULL, NULL));
+        go.back()->set_position(glm::dvec3(10.0 * i, 0.0, 0.0));
+    }
+    go[0]->set_movement(glm::dvec3(1.0, 0.0, 0.0));
+    go[2]->set_rotation(glm::dvec3(0.0, 1.0, 0.0));
+    go[3]->deactivate();
+    go[3]->set_movement(glm::dvec3(1.0, 0.0, 0.0));
+
+    moved = integrate_ours(go);
+    std::sort(moved.begin(), moved.end(),
+              [](const std::pair<GameObject *, glm::dvec3>& a,
+                 const std::pair<GameObject *, glm::dvec3>& b) {
+                  return a.first->get_object_id() < b.first->get_object_id();
+              });
+    is(moved.size(), 2, test + "expected number moved");
+    is(moved[0].first == go[0] && moved[0].second == glm::dvec3(0.0),
+       true, test + "expected first moved");
+    is(moved[1].first == go[2]
+       && moved[1].second == glm::dvec3(20.0, 0.0, 0.0),
+       true, test + "expected second moved");
+    is(go[0]->get_position() == glm::dvec3(STEP, 0.0, 0.0), true,
+       test + "expected position");
+    is(go[1]->get_position() == glm::dvec3(10.0, 0.0, 0.0), true,
+       test + "still object stayed put");
+    is(go[2]->get_orientation() != glm::dquat(1.0, 0.0, 0.0, 0.0), true,
+       test + "rotating object turned");
+    is(go[3]->get_position() == glm::dvec3(30.0, 0.0, 0.0), true,
+       test + "inactive object stayed put");
+
+    glm::dvec3 from, to;
+    go[0]->get_path(from, to);
+    is(from == glm::dvec3(0.0) && to == glm::dvec3(STEP, 0.0, 0.0), true,
+       test + "expected path");
+
+    for (auto g : go)
+        delete g;
+}
+
+/* Lots of objects going every which way, moved one at a time, with
+ * AVX2, and without, all need to end up in exactly the same places.
+ */
+void test_same_results(void)
+{
+    std::string test = "same results: ";
+    std::mt19937_64 rng(0x5239);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    std::vector<GameObject *> go;
+    std::vector<glm::dvec3> single, scalar, simd;
+    std::vector<glm::dquat> orient;
+    bool simd_ok = true;
+
+    for (int i = 0; i < OBJECTS; ++i)
+    {
+        go.push_back(new GameObject(NULL, NULL));
+        orient.push_back(glm::normalize(
+            glm::dquat(dist(rng), dist(rng), dist(rng), dist(rng))));
+        go.back()->set_movement(glm::dvec3(dist(rng), dist(rng), dist(rng)));
+        if (i % 3 == 0)
+            go.back()->set_rotation(glm::dvec3(dist(rng), dist(rng),
+                                               dist(rng)));
+    }
+    auto reset = [&](void) {
+        std::mt19937_64 again(0x9253);
+
+        for (int i = 0; i < OBJECTS; ++i)
+        {
+            go[i]->set_position(glm::dvec3(dist(again), dist(again),
+                                           dist(again)));
+            go[i]->set_orientation(orient[i]);
+        }
+    };
+    auto positions = [&](std::vector<glm::dvec3>& where) {
+        for (auto g : go)
+            where.push_back(g->get_position());
+    };
+
+    reset();
+    for (int i = 0; i < STEPS; ++i)
+        for (auto g : go)
+            g->move_and_rotate(STEP);
+    positions(single);
+
+    reset();
+    MotionState::use_simd(false);
+    for (int i = 0; i < STEPS; ++i)
+        integrate_ours(go);
+    positions(scalar);
+
+    reset();
+    if (MotionState::use_simd(true))
+    {
+        for (int i = 0; i < STEPS; ++i)
+            integrate_ours(go);
+        positions(simd);
+        simd_ok = (simd == scalar);
+    }
+
+    is(scalar == single, true, test + "scalar matches single moves");
+    is(simd_ok, true, test + "AVX2 matches scalar");
+
+    for (auto g : go)
+        delete g;
+}
+
+/* Readers don't lock anything, but they never see half a write */
+void test_torn_reads(void)
+{
+    std::string test = "torn reads: ";
+    GameObject *go = new GameObject(NULL, NULL);
+    GameObject *other = new GameObject(NULL, NULL);
+    std::atomic<bool> finished(false);
+    int torn = 0, reads = 0;
+
+    std::thread th([&]() {
+        for (int i = 0; i < WRITES; ++i)
+        {
+            go->set_position(glm::dvec3(i, i, i));
+            other->set_movement(glm::dvec3(i, 0.0, 0.0));
+        }
+        finished = true;
+    });
+    while (!finished || reads == 0)
+    {
+        glm::dvec3 pos = go->get_position();
+
+        if (pos.x != pos.y || pos.y != pos.z)
+            ++torn;
+        ++reads;
+    }
+    th.join();
+
+    is(torn, 0, test + "no torn reads");
+
+    delete other;
+    delete go;
+}
+
+/* Anything too slow for too long goes to sleep, and anything which
+ * runs into it wakes it up again.
+ */
+void test_sleep(void)
+{
+    std::string test = "sleep: ";
+    std::vector<GameObject *> go;
+
+    MotionState::set_sleep(0.01, 0.01, 0.45);
+    go.push_back(new GameObject(NULL, NULL));
+    go.push_back(new GameObject(NULL, NULL));
+    go[0]->set_position(glm::dvec3(1.5, 0.0, 0.0));
+    go[0]->set_movement(glm::dvec3(0.001, 0.0, 0.0));
+    go[1]->set_position(glm::dvec3(-10.0, 0.0, 0.0));
+    go[1]->set_movement(glm::dvec3(1.0, 0.0, 0.0));
+    go.push_back(new GameObject(NULL, NULL));
+    go[2]->set_position(glm::dvec3(20.0, 0.0, 0.0));
+    go[2]->set_movement(glm::dvec3(0.001, 0.0, 0.0), true);
+
+    for (int i = 0; i < 4; ++i)
+        integrate_ours(go);
+    is(go[0]->still_moving(), true, test + "slow object not asleep yet");
+    integrate_ours(go);
+    is(go[0]->still_moving(), false, test + "slow object asleep");
+    is(go[0]->get_movement() == glm::dvec3(0.0, 0.0, 0.0), true,
+       test + "no more movement");
+    is(go[0]->asleep(), true, test + "slow object flagged asleep");
+    is(go[1]->still_moving(), true, test + "fast object awake");
+    is(go[2]->still_moving(), true, test + "driven object awake");
+    is(go[2]->driven(), true, test + "driven object still driven");
+
+    go[2]->set_movement(glm::dvec3(0.001, 0.0, 0.0));
+    is(go[2]->driven(), false, test + "plain movement isn't driven");
+    for (int i = 0; i < 5; ++i)
+        integrate_ours(go);
+    is(go[2]->still_moving(), false, test + "undriven object asleep");
+
+    go[1]->set_position(glm::dvec3(0.8, 0.0, 0.0));
+    go[1]->collide(go[0]);
+    is(go[0]->still_moving(), true, test + "woken by contact");
+    is(go[0]->asleep(), false, test + "no longer flagged asleep");
+
+    MotionState::set_sleep(0.01, 0.01, 1.0);
+    for (auto g : go)
+        delete g;
+}
+
+/* How far apart two orientations are, either way round */
+double turn_error(const glm::dquat& a, const glm::dquat& b)
+{
+    return 1.0 - fabs(glm::dot(a, b));
+}
+
+/* A steady spin, about any axis at all, needs to stay on the turn
+ * we'd get all at once, and stay a unit quaternion while it does.
+ */
+void test_drift(void)
+{
+    std::string test = "drift: ";
+    glm::dvec3 spins[3] =
+        {
+            glm::dvec3(0.0, 0.0, 2.0),
+            glm::dvec3(0.0, 1.5, 0.0),
+            glm::dvec3(0.3, -0.7, 1.1)
+        };
+    double worst = 0.0, worst_norm = 0.0;
+
+    for (auto& spin : spins)
+    {
+        GameObject *go = new GameObject(NULL, NULL);
+
+        go->set_rotation(spin);
+        for (int i = 0; i < TURNS; ++i)
+            go->move_and_rotate(STEP);
+
+        glm::dquat q = go->get_orientation();
+        glm::dquat want = glm::angleAxis(glm::length(spin) * STEP * TURNS,
+                                         glm::normalize(spin));
+        worst = std::max(worst, turn_error(q, want));
+        worst_norm = std::max(worst_norm, fabs(glm::length(q) - 1.0));
+        delete go;
+    }
+    ok(worst < 1e-9, test + "stays on the turn");
+    ok(worst_norm < 1e-12, test + "stays a unit quaternion");
+
+    /* Both sides of where the series stops */
+    glm::dvec3 axis = glm::normalize(glm::dvec3(1.0, 2.0, -2.0));
+    double angles[4] = { 1e-6, 0.19, 0.21, 2.5 };
+
+    worst = 0.0;
+    for (double a : angles)
+        worst = std::max(worst, turn_error(MotionState::turn_by(axis * a, 1.0),
+                                           glm::angleAxis(a, axis)));
+    ok(worst < 1e-15, test + "turn_by matches angleAxis");
+}
+
+int main(int argc, char **argv)
+{
+    plan(30);
+
+    test_create_delete();
+    test_integrate();
+    test_same_results();
+    test_torn_reads();
+    test_sleep();
+    test_drift();
+    return exit_status();
+}
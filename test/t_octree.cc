@@ -2,6 +2,11 @@
 
 using namespace TAP;
 
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <thread>
+
 #include "../server/classes/octree.h"
 
 #include "mock_server_globals.h"
@@ -51,15 +56,24 @@ void test_build_empty_list(void)
     }
 
     is(tree->empty(), true, test + "expected empty");
+    is(tree->octants[0] == NULL, true, test + "no empty subtrees");
+
+    /* Anything we do put in still goes down to the minimum depth */
+    GameObject *go = new GameObject(NULL, NULL, 123LL);
+    go->set_position(glm::dvec3(1.0, 1.0, 1.0));
+    objs.push_back(go);
+    tree->build(objs);
 
     Octree *sub = tree->octants[0];
-    is(sub != NULL, true, test + "expected subtree");
-    while (sub->octants[0] != NULL)
+    while (sub != NULL && sub->octants[0] != NULL)
         sub = sub->octants[0];
-    is(sub->parent_index, 0, test + "expected parent index");
-    is(sub->depth, Octree::MIN_DEPTH, test + "expected depth");
+    is(sub != NULL && sub->parent_index == 0, true,
+       test + "expected parent index");
+    is(sub != NULL && sub->depth == Octree::MIN_DEPTH, true,
+       test + "expected depth");
 
     delete tree;
+    delete go;
 }
 
 void test_build(void)
@@ -124,22 +138,22 @@ void test_build(void)
 
     Octree::object_set_t result = tree->get_objects();
 
-    is(result.size(), tree->objects.size(), test + "expected set size");
+    is(result.size(), tree->count, test + "expected set size");
 
     tree->remove(go4);
-    is(tree->objects.find(go4) == tree->objects.end(),
+    is(tree->find(go4) == NULL,
        true,
        test + "deleted fourth object");
     tree->remove(go3);
-    is(tree->objects.find(go3) == tree->objects.end(),
+    is(tree->find(go3) == NULL,
        true,
        test + "deleted third object");
     tree->remove(go2);
-    is(tree->objects.find(go2) == tree->objects.end(),
+    is(tree->find(go2) == NULL,
        true,
        test + "deleted second object");
     tree->remove(go1);
-    is(tree->objects.find(go1) == tree->objects.end(),
+    is(tree->find(go1) == NULL,
        true,
        test + "deleted first object");
 
@@ -150,12 +164,464 @@ void test_build(void)
     delete go1;
 }
 
+void test_move(void)
+{
+    std::string test = "move: ";
+    std::list<GameObject *> objs;
+    GameObject *go[5], *outsider = new GameObject(NULL, NULL, 600LL);
+    glm::dvec3 min = {0.0, 0.0, 0.0}, max = {100.0, 100.0, 100.0}, old_pos;
+    Octree *tree = new Octree(NULL, min, max, 0), *sub;
+    int i;
+
+    for (i = 0; i < 5; ++i)
+    {
+        go[i] = new GameObject(NULL, NULL, 500LL + i);
+        go[i]->set_position(glm::dvec3(10.0 + i, 10.0, 10.0));
+        objs.push_back(go[i]);
+    }
+    tree->build(objs);
+
+    old_pos = go[0]->get_position();
+    go[0]->set_position(glm::dvec3(90.0, 90.0, 90.0));
+    is(tree->move(go[0], old_pos), true, test + "moved across octants");
+    is(tree->find(go[0]) != NULL, true, test + "root still contains object");
+    is(tree->octants[0].load()->find(go[0]) == NULL, true,
+       test + "old octant no longer contains object");
+    is(tree->octants[7] != NULL && tree->octants[7].load()->find(go[0]) != NULL,
+       true, test + "new octant contains object");
+    sub = tree->find(go[0]);
+    is(sub != NULL
+       && sub->min_point.x <= 90.0 && sub->max_point.x >= 90.0, true,
+       test + "found in expected subtree");
+
+    old_pos = go[1]->get_position();
+    go[1]->set_position(old_pos + glm::dvec3(0.001, 0.0, 0.0));
+    is(tree->move(go[1], old_pos), true, test + "moved a small amount");
+    is(tree->find(go[1]) != NULL, true, test + "found after small move");
+
+    old_pos = go[2]->get_position();
+    go[2]->set_position(glm::dvec3(200.0, 10.0, 10.0));
+    is(tree->move(go[2], old_pos), false, test + "out of bounds");
+    is(tree->get_objects().count(go[2]), 1,
+       test + "out of bounds object not removed");
+
+    is(tree->move(outsider, old_pos), false, test + "object not present");
+
+    delete tree;
+    for (i = 0; i < 5; ++i)
+        delete go[i];
+    delete outsider;
+}
+
+/* Walk the tree, making sure the interior nodes' counts add up, and
+ * returning how many objects were stored above the leaves.
+ */
+size_t check_counts(Octree *node, bool& counts_ok)
+{
+    size_t here = node->residents.load()->size(), total = here, interior = 0;
+    bool leaf = true;
+
+    for (int i = 0; i < 8; ++i)
+        if (node->octants[i] != NULL)
+        {
+            interior += check_counts(node->octants[i], counts_ok);
+            total += node->octants[i].load()->count;
+            leaf = false;
+        }
+    if (total != node->count)
+        counts_ok = false;
+    return interior + (leaf ? 0 : here);
+}
+
+void test_leaf_storage(void)
+{
+    std::string test = "leaf storage: ";
+    std::list<GameObject *> objs;
+    std::vector<GameObject *> go;
+    glm::dvec3 min = {0.0, 0.0, 0.0}, max = {100.0, 100.0, 100.0};
+    Octree *tree = new Octree(NULL, min, max, 0);
+    bool counts_ok = true;
+    int i;
+
+    for (i = 0; i < 64; ++i)
+    {
+        go.push_back(new GameObject(NULL, NULL, 800LL + i));
+        go.back()->set_position(glm::dvec3(5.0 + 12.5 * (i & 7),
+                                           5.0 + 12.5 * (i >> 3),
+                                           50.0 + (i & 3)));
+        if (i < 32)
+            objs.push_back(go.back());
+    }
+    tree->build(objs);
+    for (i = 32; i < 64; ++i)
+        tree->insert(go[i]);
+
+    is(tree->count, 64, test + "expected count");
+    is(check_counts(tree, counts_ok), 0, test + "only leaves hold objects");
+    is(counts_ok, true, test + "interior counts match");
+    is(tree->get_objects().size(), 64, test + "expected objects");
+
+    for (i = 0; i < 64; i += 2)
+        tree->remove(go[i]);
+    counts_ok = true;
+    check_counts(tree, counts_ok);
+    is(counts_ok, true, test + "counts match after removal");
+    is(tree->remove(go[0]), false, test + "can't remove twice");
+
+    delete tree;
+    for (auto g : go)
+        delete g;
+}
+
+void test_pool(void)
+{
+    std::string test = "pool: ";
+    std::vector<GameObject *> go;
+    glm::dvec3 min = {0.0, 0.0, 0.0}, max = {100.0, 100.0, 100.0}, old_pos;
+    Octree *tree = new Octree(NULL, min, max, 0);
+    uint64_t created, handed_out;
+    int i;
+
+    /* All in one minimum-sized cell, so it has to split */
+    for (i = 0; i < 8; ++i)
+    {
+        go.push_back(new GameObject(NULL, NULL, 900LL + i));
+        go.back()->set_position(glm::dvec3(0.1 + 0.3 * i, 0.1, 0.1));
+        tree->insert(go.back());
+    }
+    created = tree->pool->created;
+    ok(created > 0, test + "created nodes");
+
+    for (auto g : go)
+        tree->remove(g);
+    ok(tree->pool->released > 0, test + "released nodes");
+    is(tree->pool->spare.size() + tree->pool->limbo.size(),
+       tree->pool->released, test + "released nodes kept");
+
+    for (auto g : go)
+        tree->insert(g);
+    is(tree->pool->created, created, test + "no new nodes created");
+    ok(tree->pool->reused > 0, test + "reused nodes");
+
+    /* Back and forth across an octant boundary; the first trip might
+     * split a node, but after that nothing should split or merge.
+     */
+    for (i = 0; i < 10; ++i)
+    {
+        if (i == 2)
+            handed_out = tree->pool->created + tree->pool->reused;
+        old_pos = go[0]->get_position();
+        go[0]->set_position(glm::dvec3(i & 1 ? 0.1 : 3.0, 0.1, 0.1));
+        tree->move(go[0], old_pos);
+    }
+    is(tree->pool->created + tree->pool->reused, handed_out,
+       test + "no churn when moving back and forth");
+    ok(tree->pool->allocation_rate() > 0.0, test + "allocation rate");
+
+    delete tree;
+    for (auto g : go)
+        delete g;
+}
+
+void test_queries(void)
+{
+    std::string test = "queries: ";
+    std::list<GameObject *> objs;
+    GameObject *go[5];
+    glm::dvec3 min = {0.0, 0.0, 0.0}, max = {100.0, 100.0, 100.0};
+    Octree *tree = new Octree(NULL, min, max, 0);
+    Octree::object_list_t result;
+    Octree::neighbor_list_t best;
+    int i;
+
+    for (i = 0; i < 5; ++i)
+    {
+        go[i] = new GameObject(NULL, NULL, 1000LL + i);
+        go[i]->set_position(glm::dvec3(10.0 + i * i, 10.0, 10.0));
+        objs.push_back(go[i]);
+    }
+    tree->build(objs);
+
+    tree->range(glm::dvec3(10.0, 10.0, 10.0), 4.5, result);
+    is(result.size(), 3, test + "expected range size");
+
+    tree->nearest(glm::dvec3(30.0, 10.0, 10.0), 2, 100.0, best);
+    std::sort_heap(best.begin(), best.end());
+    is(best.size() == 2 && best[0].second == go[4] && best[1].second == go[3],
+       true, test + "expected nearest objects");
+
+    best.clear();
+    tree->nearest(glm::dvec3(30.0, 10.0, 10.0), 2, 1.0, best);
+    is(best.size(), 0, test + "nothing near enough");
+
+    i = 0;
+    is(tree->for_each_object([&](GameObject *g) { ++i; return true; }),
+       true, test + "visited everything");
+    is(i, 5, test + "expected visit count");
+
+    i = 0;
+    is(tree->for_each_object([&](GameObject *g) { return ++i < 2; }),
+       false, test + "visitor stopped early");
+    is(i, 2, test + "expected early stop count");
+
+    i = 0;
+    tree->for_each_in_sphere(glm::dvec3(90.0, 90.0, 90.0), 1.0,
+                             [&](GameObject *g) { ++i; return true; });
+    is(i, 0, test + "far sphere visits nothing");
+
+    delete tree;
+    for (i = 0; i < 5; ++i)
+        delete go[i];
+}
+
+/* A far-off cluster pulls just about the same as a single body, and
+ * costs a lot less to work out.
+ */
+void test_gravity(void)
+{
+    std::string test = "gravity: ";
+    std::list<GameObject *> objs;
+    std::vector<GameObject *> go;
+    glm::dvec3 min = {0.0, 0.0, 0.0}, max = {100.0, 100.0, 100.0};
+    glm::dvec3 probe_pos(5.0, 5.0, 5.0), moment(0.0, 0.0, 0.0);
+    glm::dvec3 exact(0.0, 0.0, 0.0), approx;
+    Octree *tree = new Octree(NULL, min, max, 0);
+    GameObject *probe = new GameObject(NULL, NULL, 3000LL);
+    Octree::query_cost exact_cost, approx_cost;
+    int i;
+
+    probe->set_position(probe_pos);
+    objs.push_back(probe);
+    for (i = 0; i < 20; ++i)
+    {
+        glm::dvec3 pos(80.0 + i % 3, 80.0 + i % 5, 80.0 + i % 7);
+
+        go.push_back(new GameObject(NULL, NULL, 3001LL + i));
+        go.back()->set_position(pos);
+        objs.push_back(go.back());
+        moment += pos;
+        glm::dvec3 d = pos - probe_pos;
+        exact += d / pow(glm::length(d), 3.0);
+    }
+    tree->build(objs);
+
+    tree->weigh();
+    is(tree->mass == 21.0, true, test + "expected mass");
+    is(glm::length(tree->center_of_mass - (moment + probe_pos) / 21.0) < 1e-9,
+       true, test + "expected center of mass");
+
+    approx = tree->pull(probe, probe_pos, 0.0, exact_cost);
+    is(glm::length(approx - exact) < 1e-12 * glm::length(exact), true,
+       test + "opening everything is exact");
+
+    approx = tree->pull(probe, probe_pos, 0.5, approx_cost);
+    is(glm::length(approx - exact) < 0.01 * glm::length(exact), true,
+       test + "close enough from far away");
+    ok(approx_cost.objects < exact_cost.objects,
+       test + "cheaper from far away");
+
+    delete tree;
+    delete probe;
+    for (auto g : go)
+        delete g;
+}
+
+GameObject *sized_object(uint64_t id, double radius, const glm::dvec3& pos)
+{
+    Geometry *geom = new Geometry();
+    GameObject *go;
+
+    geom->radius = radius;
+    go = new GameObject(geom, NULL, id);
+    go->set_position(pos);
+    return go;
+}
+
+void test_loose(void)
+{
+    std::string test = "loose: ";
+    glm::dvec3 min = {0.0, 0.0, 0.0}, max = {100.0, 100.0, 100.0}, old_pos;
+    Octree *tree = new Octree(NULL, min, max, 0, 2.0);
+    GameObject *big = sized_object(700LL, 30.0, glm::dvec3(10.0, 10.0, 10.0));
+    GameObject *medium = sized_object(701LL, 10.0,
+                                      glm::dvec3(10.0, 10.0, 10.0));
+    GameObject *left = sized_object(702LL, 2.0, glm::dvec3(74.9, 60.0, 60.0));
+    GameObject *right = sized_object(703LL, 2.0,
+                                     glm::dvec3(75.1, 60.0, 60.0));
+    Octree::object_set_t result;
+
+    tree->insert(big);
+    tree->insert(medium);
+    tree->insert(left);
+    tree->insert(right);
+
+    is(tree->find(big) == tree, true, test + "big object stays at the root");
+    is(tree->find(medium) != tree, true, test + "medium object descends");
+    is(tree->find(medium)->depth, 2, test + "medium object at expected depth");
+
+    result = tree->get_objects(glm::dvec3(90.0, 90.0, 90.0), 1.0);
+    is(result.find(medium) == result.end(), true,
+       test + "far query misses medium object");
+    result = tree->get_objects(glm::dvec3(19.0, 10.0, 10.0), 1.0);
+    is(result.find(medium) != result.end(), true,
+       test + "near query finds medium object");
+    result = tree->get_objects(left->get_position(), 2.0);
+    is(result.find(right) != result.end(), true,
+       test + "query finds straddling neighbor");
+
+    old_pos = medium->get_position();
+    medium->set_position(glm::dvec3(80.0, 80.0, 80.0));
+    is(tree->move(medium, old_pos), true, test + "moved medium object");
+    result = tree->get_objects(glm::dvec3(85.0, 80.0, 80.0), 1.0);
+    is(result.find(medium) != result.end(), true,
+       test + "query finds moved object");
+
+    tree->remove(medium);
+    is(tree->find(medium) == NULL, true, test + "removed medium object");
+
+    delete tree;
+    delete right;
+    delete left;
+    delete medium;
+    delete big;
+}
+
+void test_shape(void)
+{
+    std::string test = "shape: ";
+    std::vector<GameObject *> go;
+    glm::dvec3 min = {0.0, 0.0, 0.0}, max = {100.0, 100.0, 100.0};
+    Octree *tree = new Octree(NULL, min, max, 0);
+    SpatialIndex::shape_stats stats;
+    Octree::object_list_t result;
+    size_t objects = 0, leaves = 0;
+    int i;
+
+    tree->set_shape(2, 4, 2, false);
+    for (i = 0; i < 20; ++i)
+    {
+        go.push_back(new GameObject(NULL, NULL, 1000LL + i));
+        go.back()->set_position(glm::dvec3(0.1 + 0.1 * i, 0.1, 0.1));
+        tree->insert(go.back());
+    }
+    tree->describe(stats);
+    is(stats.min_depth, 2, test + "expected min depth");
+    is(stats.max_depth, 4, test + "expected max depth");
+    is(stats.nodes.size(), 5, test + "no deeper than max depth");
+    is(stats.nodes[0], 1, test + "one root");
+    for (auto n : stats.objects)
+        objects += n;
+    is(objects, 20, test + "every object counted");
+    for (auto& n : stats.occupancy)
+        leaves += n.second;
+    ok(leaves > 0 && stats.occupancy.rbegin()->first > 2,
+       test + "crowded leaf at max depth");
+
+    /* A handful of objects doesn't need five levels */
+    tree->set_shape(5, 10, 3, true);
+    tree->range(glm::dvec3(50.0, 50.0, 50.0), 10.0, result);
+    tree->describe(stats);
+    is(stats.queries, 1, test + "query counted");
+    ok(stats.nodes_visited > 0, test + "query nodes counted");
+    tree->retune();
+    tree->describe(stats);
+    is(stats.min_depth, 1, test + "adaptive min depth");
+    ok(stats.max_depth >= 2 && stats.max_depth <= 10,
+       test + "adaptive max depth within limits");
+    is(stats.queries, 0, test + "query counts reset");
+
+    delete tree;
+    for (auto g : go)
+        delete g;
+}
+
+/* Readers don't lock anything, so while other threads are moving
+ * things around, the readers must still always find the things which
+ * are standing still.
+ */
+void test_concurrent(void)
+{
+    std::string test = "concurrent: ";
+    std::vector<GameObject *> still, moving;
+    glm::dvec3 min = {0.0, 0.0, 0.0}, max = {100.0, 100.0, 100.0};
+    Octree *tree = new Octree(NULL, min, max, 0);
+    std::vector<std::thread> threads;
+    std::atomic<bool> done(false);
+    std::atomic<int> missed(0), passes(0);
+    int i;
+
+    for (i = 0; i < 200; ++i)
+    {
+        GameObject *go = new GameObject(NULL, NULL, 1100LL + i);
+
+        go->set_position(glm::dvec3((i * 37) % 100 + 0.5,
+                                    (i * 53) % 100 + 0.5,
+                                    (i * 71) % 100 + 0.5));
+        (i & 1 ? moving : still).push_back(go);
+        tree->insert(go);
+    }
+
+    for (i = 0; i < 4; ++i)
+        threads.push_back(std::thread([&]() {
+            while (!done)
+            {
+                for (auto go : still)
+                {
+                    Octree::object_list_t found;
+
+                    tree->range(go->get_position(), 0.1, found);
+                    if (std::find(found.begin(), found.end(), go)
+                        == found.end())
+                        ++missed;
+                }
+                ++passes;
+            }
+        }));
+    for (i = 0; i < 2; ++i)
+        threads.push_back(std::thread([&, i]() {
+            for (int j = 0; j < 200; ++j)
+                for (size_t k = i; k < moving.size(); k += 2)
+                {
+                    glm::dvec3 old_pos = moving[k]->get_position();
+
+                    moving[k]->set_position(glm::dvec3(
+                        fmod(old_pos.x + 13.7, 100.0), old_pos.y,
+                        fmod(old_pos.z + 7.3, 100.0)));
+                    tree->move(moving[k], old_pos);
+                }
+        }));
+    threads[4].join();
+    threads[5].join();
+    while (passes < 4)
+        std::this_thread::yield();
+    done = true;
+    for (i = 0; i < 4; ++i)
+        threads[i].join();
+
+    is(missed, 0, test + "nothing missed");
+    is(tree->count, 200, test + "expected count");
+
+    delete tree;
+    for (auto go : still)
+        delete go;
+    for (auto go : moving)
+        delete go;
+}
+
 int main(int argc, char **argv)
 {
-    plan(15);
+    plan(73);
 
     test_create_delete();
     test_build_empty_list();
     test_build();
+    test_move();
+    test_leaf_storage();
+    test_pool();
+    test_queries();
+    test_gravity();
+    test_loose();
+    test_shape();
+    test_concurrent();
     return exit_status();
 }
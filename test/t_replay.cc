@@ -0,0 +1,393 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <unistd.h>
+#include <string.h>
+
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "../server/classes/recorder.h"
+#include "../server/classes/replay.h"
+#include "../server/classes/log.h"
+
+#include "mock_db.h"
+#include "mock_library.h"
+#include "mock_listensock.h"
+#include "mock_server_globals.h"
+
+#define OBJECTS  20
+#define TICKS    60
+#define PUSHES   4
+
+void register_actions(actions_map&);
+int push_action(GameObject *, int, GameObject *, glm::dvec3&);
+
+typedef std::map<uint64_t, std::pair<glm::dvec3, glm::dvec3> > results_t;
+
+std::string fname = "./t_replay.rec";
+
+void register_actions(actions_map& a)
+{
+    a[123].valid = true;
+    a[123].upper = 10;
+    a[123].action = &push_action;
+}
+
+/* Sets the actor off in the given direction */
+int push_action(GameObject *actor, int power, GameObject *target,
+                glm::dvec3& dest)
+{
+    actor->set_movement(dest * (double)power);
+    return 0;
+}
+
+void find_libraries(const std::string& a, std::vector<Library *>& b)
+{
+    b.push_back(new fake_Library("whatever"));
+}
+
+/* Everything in the zone, and where it ended up */
+results_t results(void)
+{
+    results_t r;
+
+    for (auto& i : zone->game_objects)
+        r[i.first] = std::make_pair(i.second->get_position(),
+                                    i.second->get_movement());
+    return r;
+}
+
+void setup_pools(unsigned int rate, bool paced = false)
+{
+    motion_pool = new MotionPool("t_replay", 2, rate);
+    motion_pool->paced = paced;
+    motion_pool->gravity = config.gravity;
+    motion_pool->opening_angle = config.gravity_theta;
+    MotionState::set_sleep(config.sleep_speed, config.sleep_spin,
+                           config.sleep_after);
+    update_pool = new UpdatePool("t_replay", 1);
+    action_pool = new ActionPool(1, zone->game_objects, NULL);
+    motion_pool->start();
+}
+
+void cleanup_pools(void)
+{
+    delete action_pool;
+    delete motion_pool;
+    delete update_pool;
+    delete zone;
+    action_pool = NULL;
+    motion_pool = NULL;
+    update_pool = NULL;
+    zone = NULL;
+}
+
+/* A row of objects, every other one running into the next */
+void setup_zone(void)
+{
+    SpatialIndex::object_list_t objs;
+
+    zone = new Zone(1000, 1, NULL);
+    for (int i = 0; i < OBJECTS; ++i)
+    {
+        GameObject *go = new GameObject(NULL, NULL, 1000LL + i);
+
+        go->set_position(glm::dvec3(500.0 + i * 1.5, 500.0, 500.0));
+        if (i % 2 == 0)
+            go->set_movement(glm::dvec3(10.0, 0.0, 0.0));
+        zone->game_objects[go->get_object_id()] = go;
+        objs.push_back(go);
+    }
+    zone->hand_off(objs);
+}
+
+results_t record(void)
+{
+    std::string test = "record: ";
+    action_request req;
+    results_t r;
+
+    setup_zone();
+    setup_pools(100);
+
+    recorder = new Recorder(fname, 100, zone->game_objects);
+    memset(&req, 0, sizeof(action_request));
+    req.object_id = 1005LL;
+    req.action_id = 123;
+    req.power_level = 2;
+    req.x_pos_dest = -3 * ACTREQ_POS_SCALE;
+    req.y_pos_dest = 1 * ACTREQ_POS_SCALE;
+    for (int i = 0; i < TICKS; ++i)
+    {
+        if (i == 10 || i == 30)
+        {
+            recorder->action(req);
+            action_pool->perform(zone->game_objects[req.object_id], req);
+        }
+        motion_pool->tick();
+    }
+    is(recorder->ticks, TICKS, test + "expected ticks");
+    is(recorder->actions, 2, test + "expected actions");
+    delete recorder;
+    recorder = NULL;
+
+    r = results();
+    cleanup_pools();
+    return r;
+}
+
+void test_replay(void)
+{
+    std::string test = "replay: ";
+    std::streambuf *orig_rdbuf = std::clog.rdbuf(new Log("blah", LOG_DAEMON));
+    symbol_result = (void *)register_actions;
+    results_t live = record();
+
+    for (int n = 0; n < 2; ++n)
+    {
+        Replay *replay = new Replay(fname);
+
+        is(replay->tick_rate, 100, test + "expected tick rate");
+        config.gravity = 5.0;
+        config.broadphase = "sap";
+        replay->configure(config);
+        is(config.gravity == config_data::GRAVITY
+           && config.broadphase == config_data::BROADPHASE, true,
+           test + "recording's config used");
+        zone = new Zone(1000, 1, NULL);
+        is(replay->load(zone), OBJECTS, test + "expected objects");
+        setup_pools(replay->tick_rate);
+        is(replay->run(action_pool, motion_pool), TICKS,
+           test + "expected ticks");
+        is(replay->actions, 2, test + "expected actions");
+        is(SimClock::ticks(), replay->first_tick + TICKS,
+           test + "clock started where the recording did");
+        ok(motion_pool->contacts > 0, test + "expected contacts");
+        is(results() == live, true, test + "same as the recording");
+        delete replay;
+        cleanup_pools();
+    }
+    unlink(fname.c_str());
+    delete std::clog.rdbuf(orig_rdbuf);
+}
+
+/* With the ticker running on its own, and the actions coming in
+ * through the action pool's worker, whenever they happen to land.
+ */
+void test_live_replay(void)
+{
+    std::string test = "live replay: ";
+    std::streambuf *orig_rdbuf = std::clog.rdbuf(new Log("blah", LOG_DAEMON));
+    fake_listen_socket *listensock = new fake_listen_socket(NULL);
+    base_user *bu;
+    packet_list pl;
+    uint64_t ticks;
+    results_t live;
+
+    symbol_result = (void *)register_actions;
+    database = new fake_DB("a", 0, "b", "c", "d");
+    check_authorization_result = ACCESS_MOVE;
+    get_character_objectid_result = 1005LL;
+
+    setup_zone();
+    recorder = new Recorder(fname, 100, zone->game_objects);
+    setup_pools(100, true);
+    bu = new base_user(123LL, "a", "b", listensock);
+    bu->actions[123] = {123, 5, 0, 0};
+    action_pool->start();
+
+    memset(&pl.buf, 0, sizeof(action_request));
+    pl.buf.act.type = TYPE_ACTREQ;
+    pl.buf.act.version = R9_PROTO_VER;
+    pl.buf.act.object_id = 1005LL;
+    pl.buf.act.action_id = 123;
+    pl.who = bu;
+    for (int i = 0; i < PUSHES; ++i)
+    {
+        usleep(25000);
+        pl.buf.act.power_level = 2 + i;
+        pl.buf.act.x_pos_dest = (i % 2 ? 3 : -3) * ACTREQ_POS_SCALE;
+        pl.buf.act.y_pos_dest = i * ACTREQ_POS_SCALE;
+        action_pool->push(pl);
+    }
+    while (recorder->actions < PUSHES)
+        usleep(1000);
+    usleep(25000);
+    motion_pool->stop();
+    action_pool->stop();
+    ticks = recorder->ticks;
+    delete recorder;
+    recorder = NULL;
+
+    live = results();
+    zone->game_objects[1005LL]->disconnect(bu);
+    delete bu;
+    cleanup_pools();
+    ok(ticks > 0, test + "ticker ran");
+
+    Replay *replay = new Replay(fname);
+
+    zone = new Zone(1000, 1, NULL);
+    is(replay->load(zone), OBJECTS, test + "expected objects");
+    setup_pools(replay->tick_rate);
+    is(replay->run(action_pool, motion_pool), ticks, test + "expected ticks");
+    is(replay->actions, PUSHES, test + "expected actions");
+    is(results() == live, true, test + "same as the recording");
+    delete replay;
+    cleanup_pools();
+
+    unlink(fname.c_str());
+    delete listensock;
+    delete (fake_DB *)database;
+    database = NULL;
+    delete std::clog.rdbuf(orig_rdbuf);
+}
+
+/* With gravity on, one object already asleep and one partway to it
+ * when the recording starts.  The pulls are all too gentle to wake
+ * anything, and the second one falls asleep partway through.
+ */
+void test_sleep_replay(void)
+{
+    std::string test = "sleep replay: ";
+    std::streambuf *orig_rdbuf = std::clog.rdbuf(new Log("blah", LOG_DAEMON));
+    SpatialIndex::object_list_t objs;
+    GameObject *sleeper, *settler;
+    results_t live;
+    bool settled;
+
+    symbol_result = (void *)register_actions;
+    config.gravity = 1.0;
+    config.sleep_after = 0.5;
+
+    zone = new Zone(1000, 1, NULL);
+    for (int i = 0; i < 3; ++i)
+    {
+        GameObject *go = new GameObject(NULL, NULL, 3000LL + i);
+
+        go->set_position(glm::dvec3(500.0 + i * 10.0, 500.0, 500.0));
+        zone->game_objects[go->get_object_id()] = go;
+        objs.push_back(go);
+    }
+    zone->hand_off(objs);
+    sleeper = objs[0];
+    settler = objs[1];
+    setup_pools(100);
+
+    sleeper->set_movement(glm::dvec3(0.0, 0.001, 0.0));
+    for (int i = 0; i < 60; ++i)
+        motion_pool->tick();
+    settler->set_movement(glm::dvec3(0.0, 0.0, 0.001));
+    for (int i = 0; i < 20; ++i)
+        motion_pool->tick();
+    is(sleeper->asleep(), true, test + "asleep before recording");
+    is(settler->asleep() == false && settler->calm() > 0.0, true,
+       test + "settling before recording");
+
+    recorder = new Recorder(fname, 100, zone->game_objects);
+    for (int i = 0; i < TICKS; ++i)
+        motion_pool->tick();
+    delete recorder;
+    recorder = NULL;
+    settled = settler->asleep();
+    live = results();
+    cleanup_pools();
+    is(settled, true, test + "fell asleep while recording");
+
+    config.gravity = 0.0;
+    config.sleep_after = 1.0;
+    Replay *replay = new Replay(fname);
+
+    replay->configure(config);
+    zone = new Zone(1000, 1, NULL);
+    is(replay->load(zone), 3, test + "expected objects");
+    is(zone->game_objects[3000LL]->asleep(), true,
+       test + "still asleep when loaded");
+    setup_pools(replay->tick_rate);
+    is(replay->run(action_pool, motion_pool), TICKS,
+       test + "expected ticks");
+    is(results() == live, true, test + "same as the recording");
+    delete replay;
+    cleanup_pools();
+
+    config.gravity = config_data::GRAVITY;
+    config.sleep_after = config_data::SLEEP_AFTER;
+    MotionState::set_sleep(config.sleep_speed, config.sleep_spin,
+                           config.sleep_after);
+    unlink(fname.c_str());
+    delete std::clog.rdbuf(orig_rdbuf);
+}
+
+void test_bad_file(void)
+{
+    std::string test = "bad file: ";
+    std::ofstream ofs(fname);
+
+    ofs << "R9RX" << std::endl;
+    ofs.close();
+
+    try
+    {
+        Replay replay("./no_such_recording");
+        fail(test + "missing file");
+    }
+    catch (std::system_error& e)
+    {
+        pass(test + "missing file");
+    }
+    try
+    {
+        Replay replay(fname);
+        fail(test + "not a recording");
+    }
+    catch (std::runtime_error& e)
+    {
+        pass(test + "not a recording");
+    }
+    unlink(fname.c_str());
+}
+
+void test_numbers(void)
+{
+    std::string test = "numbers: ";
+    std::stringstream s;
+
+    Recorder::write_number(s, 127);
+    Recorder::write_number(s, 0xffffffffffffffffULL);
+    Recorder::write_signed(s, -1);
+    Recorder::write_signed(s, -123456789012LL);
+    Recorder::write_double(s, -0.1);
+    Recorder::write_string(s, "octree");
+    is(s.str().size(), 1 + 10 + 1 + 6 + 8 + 7, test + "expected size");
+    is(Recorder::read_number(s), 127, test + "expected small");
+    is(Recorder::read_number(s) == 0xffffffffffffffffULL, true,
+       test + "expected big");
+    is(Recorder::read_signed(s), -1, test + "expected small signed");
+    is(Recorder::read_signed(s), -123456789012LL, test + "expected signed");
+    is(Recorder::read_double(s) == -0.1, true, test + "expected double");
+    is(Recorder::read_string(s), "octree", test + "expected string");
+    try
+    {
+        Recorder::read_number(s);
+        fail(test + "read past the end");
+    }
+    catch (std::runtime_error& e)
+    {
+        pass(test + "read past the end");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    plan(40);
+
+    test_numbers();
+    test_bad_file();
+    test_replay();
+    test_live_replay();
+    test_sleep_replay();
+    return exit_status();
+}
@@ -0,0 +1,94 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <unistd.h>
+
+#include "../server/classes/sim_clock.h"
+#include "../server/classes/game_obj.h"
+
+void test_free(void)
+{
+    std::string test = "free: ";
+    uint64_t before, after;
+
+    SimClock::set_rate(0);
+    before = SimClock::now();
+    usleep(10000);
+    after = SimClock::now();
+    is(after - before >= 10000000ULL, true, test + "follows real time");
+    is(SimClock::seconds(1500000000ULL) == 1.5, true,
+       test + "expected seconds");
+}
+
+void test_ticks(void)
+{
+    std::string test = "ticks: ";
+    uint64_t before, tick;
+
+    SimClock::set_rate(100);
+    before = SimClock::now();
+    tick = SimClock::ticks();
+    usleep(10000);
+    is(SimClock::now(), before, test + "stands still between ticks");
+    is(SimClock::tick(), tick + 1, test + "expected tick number");
+    is(SimClock::ticks(), tick + 1, test + "expected ticks");
+    is(SimClock::now() - before, 10000000ULL, test + "one timestep per tick");
+
+    SimClock::set_rate(0);
+    is(SimClock::now() >= before + 10000000ULL, true,
+       test + "doesn't go backwards when running freely again");
+}
+
+/* Starting from a given tick and time, like a replay does */
+void test_start_at(void)
+{
+    std::string test = "start at: ";
+
+    SimClock::set_rate(100);
+    SimClock::start_at(500, 7000000000ULL);
+    is(SimClock::ticks(), 500, test + "expected ticks");
+    is(SimClock::now(), 7000000000ULL, test + "expected time");
+    SimClock::tick();
+    is(SimClock::now(), 7010000000ULL, test + "one timestep on");
+
+    SimClock::set_rate(0);
+}
+
+/* The same ticks move an object by exactly the same amount, however
+ * long they really take.
+ */
+void test_object(void)
+{
+    std::string test = "object: ";
+    GameObject *go = new GameObject(NULL, NULL);
+
+    SimClock::set_rate(50);
+    go->set_movement(glm::dvec3(1.0, 0.0, 0.0));
+    SimClock::tick();
+    usleep(5000);
+    go->move_and_rotate();
+    is(go->get_position().x == 0.02, true, test + "expected position");
+    SimClock::tick();
+    SimClock::tick();
+    go->move_and_rotate();
+    is(go->get_position().x == 0.02 + 0.04, true,
+       test + "expected position after two ticks");
+    go->move_and_rotate();
+    is(go->get_position().x == 0.02 + 0.04, true,
+       test + "no tick, no move");
+
+    SimClock::set_rate(0);
+    delete go;
+}
+
+int main(int argc, char **argv)
+{
+    plan(13);
+
+    test_free();
+    test_ticks();
+    test_start_at();
+    test_object();
+    return exit_status();
+}
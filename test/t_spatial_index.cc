@@ -0,0 +1,198 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <algorithm>
+#include <random>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include "../server/classes/octree.h"
+#include "../server/classes/linear_octree.h"
+
+#include "mock_server_globals.h"
+
+#define OBJECTS  2000
+#define QUERIES  20
+#define RAYS     500
+#define SIZE     100.0
+
+/* Every index gets exactly the same objects, queries and moves */
+std::mt19937_64 rng;
+std::vector<GameObject *> objects;
+
+glm::dvec3 random_point(double lo, double hi)
+{
+    std::uniform_real_distribution<double> dist(lo, hi);
+
+    return glm::dvec3(dist(rng), dist(rng), dist(rng));
+}
+
+void create_objects(void)
+{
+    rng.seed(0x5239);
+    for (int i = 0; i < OBJECTS; ++i)
+    {
+        GameObject *go = new GameObject(NULL, NULL, i + 1);
+
+        go->set_position(random_point(0.0, SIZE));
+        objects.push_back(go);
+    }
+}
+
+bool all_found(SpatialIndex *index)
+{
+    for (auto go : objects)
+        if (index->find(go) == NULL)
+            return false;
+    return true;
+}
+
+/* Compare range and nearest queries with looking at everything */
+bool queries_match(SpatialIndex *index)
+{
+    for (int i = 0; i < QUERIES; ++i)
+    {
+        glm::dvec3 pt = random_point(-10.0, SIZE + 10.0);
+        SpatialIndex::object_list_t found, expected;
+        SpatialIndex::neighbor_list_t best;
+        std::vector<double> dists;
+
+        index->range(pt, 10.0, found);
+        for (auto go : objects)
+        {
+            glm::dvec3 d = go->get_position() - pt;
+            double dist2 = glm::dot(d, d);
+
+            if (dist2 <= 100.0)
+                expected.push_back(go);
+            if (dist2 <= 400.0)
+                dists.push_back(dist2);
+        }
+        std::sort(found.begin(), found.end());
+        std::sort(expected.begin(), expected.end());
+        if (found != expected)
+            return false;
+
+        index->nearest(pt, 5, 20.0, best);
+        std::sort_heap(best.begin(), best.end());
+        std::sort(dists.begin(), dists.end());
+        dists.resize(std::min(dists.size(), (size_t)5));
+        if (best.size() != dists.size())
+            return false;
+        for (size_t j = 0; j < best.size(); ++j)
+            if (best[j].first != dists[j])
+                return false;
+    }
+    return true;
+}
+
+/* Compare casting rays with trying every object */
+bool rays_match(SpatialIndex *index)
+{
+    for (int i = 0; i < RAYS; ++i)
+    {
+        SpatialIndex::ray r(random_point(-10.0, SIZE + 10.0),
+                            random_point(-1.0, 1.0), 100.0);
+        SpatialIndex::ray expected = r;
+
+        index->raycast(r);
+        for (auto go : objects)
+            expected.hits(go);
+        if (r.hit != expected.hit || r.max_dist != expected.max_dist)
+            return false;
+    }
+    return true;
+}
+
+void test_index(const std::string& name, SpatialIndex *index)
+{
+    std::string test = name + ": ";
+    SpatialIndex::object_list_t objs(objects.begin(), objects.end());
+    glm::dvec3 pt(50.0, 50.0, 50.0), old_pos;
+    size_t visited = 0, inside = 0;
+    bool moved = true;
+
+    rng.seed(0x9253);
+
+    index->build(objs);
+    is(index->count, OBJECTS, test + "expected count");
+    is(all_found(index), true, test + "everything found");
+    is(queries_match(index), true, test + "queries match");
+    is(rays_match(index), true, test + "rays match");
+
+    /* The sphere visitor may give us more than what's in the sphere,
+     * but never less.
+     */
+    index->for_each_in_sphere(
+        pt, 10.0,
+        [&](GameObject *go) {
+            if (glm::length(go->get_position() - pt) <= 10.0)
+                ++inside;
+            ++visited;
+            return true;
+        }
+    );
+    for (auto go : objects)
+        if (glm::length(go->get_position() - pt) <= 10.0)
+            --inside;
+    is(inside, 0, test + "sphere visitor sees everything in range");
+    visited = 0;
+    index->for_each_object(
+        [&](GameObject *go) {
+            return ++visited < 10;
+        }
+    );
+    is(visited, 10, test + "visitor stops early");
+
+    for (auto go : objects)
+    {
+        old_pos = go->get_position();
+        go->set_position(glm::clamp(old_pos + random_point(-2.0, 2.0),
+                                    glm::dvec3(0.0, 0.0, 0.0),
+                                    glm::dvec3(99.9, 99.9, 99.9)));
+        if (!index->move(go, old_pos))
+            moved = false;
+    }
+    is(moved, true, test + "everything moved");
+    is(all_found(index), true, test + "everything found after moving");
+    is(queries_match(index), true, test + "queries match after moving");
+    is(rays_match(index), true, test + "rays match after moving");
+
+    old_pos = objects[0]->get_position();
+    objects[0]->set_position(glm::dvec3(150.0, 50.0, 50.0));
+    is(index->move(objects[0], old_pos), false,
+       test + "can't move out of bounds");
+    is(index->remove(objects[0], old_pos), true, test + "removed");
+    is(index->count, OBJECTS - 1, test + "expected count after remove");
+    objects[0]->set_position(old_pos);
+    index->insert(objects[0]);
+    is(index->find(objects[0]) != NULL, true, test + "inserted");
+
+    for (auto go : objects)
+        index->remove(go, go->get_position());
+    is(index->empty(), true, test + "empty after removing everything");
+
+    delete index;
+}
+
+int main(int argc, char **argv)
+{
+    glm::dvec3 min(0.0, 0.0, 0.0), max(SIZE, SIZE, SIZE);
+
+    plan(30);
+
+    create_objects();
+    test_index("octree", new Octree(NULL, min, max, 0));
+    for (auto go : objects)
+        delete go;
+    objects.clear();
+
+    /* Same objects, in the same places, for the linear octree */
+    create_objects();
+    test_index("linear octree", new LinearOctree(min, max));
+    for (auto go : objects)
+        delete go;
+    return exit_status();
+}
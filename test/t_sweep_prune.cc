@@ -0,0 +1,229 @@
+#include <tap++.h>
+
+using namespace TAP;
+
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "../server/classes/sweep_prune.h"
+#include "../server/classes/octree.h"
+
+#include "mock_server_globals.h"
+
+GameObject *make_object(uint64_t id, const glm::dvec3& pos, double radius)
+{
+    Geometry *geom = new Geometry();
+    GameObject *go;
+
+    geom->radius = radius;
+    go = new GameObject(geom, NULL, id);
+    go->set_position(pos);
+    return go;
+}
+
+void test_pairs(void)
+{
+    std::string test = "pairs: ";
+    SweepAndPrune *sap = new SweepAndPrune();
+    SweepAndPrune::object_list_t objs;
+    SweepAndPrune::pair_list_t pairs;
+
+    objs.push_back(make_object(1, glm::dvec3(10.0, 10.0, 10.0), 1.0));
+    objs.push_back(make_object(2, glm::dvec3(11.5, 10.0, 10.0), 1.0));
+    objs.push_back(make_object(3, glm::dvec3(11.5, 20.0, 10.0), 1.0));
+    objs.push_back(make_object(4, glm::dvec3(50.0, 50.0, 50.0), 1.0));
+
+    sap->build(objs);
+    is(sap->size(), 4, test + "expected size");
+
+    sap->pairs(pairs);
+    is(pairs.size(), 1, test + "expected pair count");
+    is((pairs[0].first == objs[0] && pairs[0].second == objs[1])
+       || (pairs[0].first == objs[1] && pairs[0].second == objs[0]),
+       true, test + "expected pair");
+
+    delete sap;
+    for (auto go : objs)
+        delete go;
+}
+
+void test_candidates(void)
+{
+    std::string test = "candidates: ";
+    SweepAndPrune *sap = new SweepAndPrune();
+    SweepAndPrune::object_list_t objs, found;
+    int visits = 0;
+
+    /* One big object, so the candidates have to start well before
+     * the small one's own interval.
+     */
+    objs.push_back(make_object(1, glm::dvec3(0.0, 10.0, 10.0), 20.0));
+    objs.push_back(make_object(2, glm::dvec3(15.0, 10.0, 10.0), 1.0));
+    objs.push_back(make_object(3, glm::dvec3(16.0, 10.0, 10.0), 1.0));
+    objs.push_back(make_object(4, glm::dvec3(16.0, 40.0, 10.0), 1.0));
+    for (auto go : objs)
+        sap->insert(go);
+
+    sap->for_each_candidate(
+        objs[1],
+        [&](GameObject *go) {
+            found.push_back(go);
+            return true;
+        }
+    );
+    std::sort(found.begin(), found.end());
+    is(found.size(), 2, test + "expected candidate count");
+    is(std::find(found.begin(), found.end(), objs[0]) != found.end(), true,
+       test + "expected big object");
+    is(std::find(found.begin(), found.end(), objs[1]) == found.end(), true,
+       test + "not a candidate of itself");
+
+    sap->for_each_candidate(
+        objs[1],
+        [&](GameObject *go) {
+            ++visits;
+            return false;
+        }
+    );
+    is(visits, 1, test + "expected early stop");
+
+    /* A fast mover's candidates are along its whole path */
+    found.clear();
+    objs.push_back(make_object(5, glm::dvec3(16.0, 25.0, 10.0), 1.0));
+    objs[4]->set_movement(glm::dvec3(0.0, 100000.0, 0.0));
+    usleep(1000);
+    objs[4]->move_and_rotate();
+    sap->insert(objs[4]);
+    sap->for_each_candidate(
+        objs[4],
+        [&](GameObject *go) {
+            found.push_back(go);
+            return true;
+        }
+    );
+    is(std::find(found.begin(), found.end(), objs[3]) != found.end(), true,
+       test + "expected object along the path");
+
+    delete sap;
+    for (auto go : objs)
+        delete go;
+}
+
+void test_move_remove(void)
+{
+    std::string test = "move/remove: ";
+    SweepAndPrune *sap = new SweepAndPrune();
+    SweepAndPrune::object_list_t objs;
+    SweepAndPrune::pair_list_t pairs;
+    glm::dvec3 old_pos;
+
+    objs.push_back(make_object(1, glm::dvec3(10.0, 10.0, 10.0), 1.0));
+    objs.push_back(make_object(2, glm::dvec3(20.0, 10.0, 10.0), 1.0));
+    objs.push_back(make_object(3, glm::dvec3(30.0, 10.0, 10.0), 1.0));
+    sap->build(objs);
+
+    /* Move the last one past the others, so it has to be reordered */
+    old_pos = objs[2]->get_position();
+    objs[2]->set_position(glm::dvec3(10.5, 10.0, 10.0));
+    is(sap->move(objs[2], old_pos), true, test + "expected move");
+    sap->pairs(pairs);
+    is(pairs.size(), 1, test + "expected pair count after move");
+
+    is(sap->remove(objs[0], objs[0]->get_position()), true,
+       test + "expected remove");
+    is(sap->remove(objs[0], objs[0]->get_position()), false,
+       test + "expected second remove to fail");
+    is(sap->size(), 2, test + "expected size");
+    pairs.clear();
+    sap->pairs(pairs);
+    is(pairs.size(), 0, test + "expected no pairs after remove");
+
+    delete sap;
+    for (auto go : objs)
+        delete go;
+}
+
+void test_octree(void)
+{
+    std::string test = "octree: ";
+    glm::dvec3 min = {0.0, 0.0, 0.0}, max = {100.0, 100.0, 100.0};
+    Octree *tree = new Octree(NULL, min, max, 0);
+    Octree::object_list_t objs;
+    SweepAndPrune::pair_list_t pairs;
+    glm::dvec3 old_pos;
+
+    tree->broadphase = new SweepAndPrune();
+    objs.push_back(make_object(1, glm::dvec3(10.0, 10.0, 10.0), 1.0));
+    objs.push_back(make_object(2, glm::dvec3(20.0, 10.0, 10.0), 1.0));
+    tree->build(objs);
+    is(tree->broadphase->size(), 2, test + "expected build");
+
+    objs.push_back(make_object(3, glm::dvec3(90.0, 90.0, 90.0), 1.0));
+    tree->insert(objs[2]);
+    is(tree->broadphase->size(), 3, test + "expected insert");
+
+    old_pos = objs[1]->get_position();
+    objs[1]->set_position(glm::dvec3(11.0, 10.0, 10.0));
+    tree->move(objs[1], old_pos);
+    tree->broadphase->pairs(pairs);
+    is(pairs.size(), 1, test + "expected move");
+
+    /* Moving out of the tree leaves both alone, for the caller to
+     * remove the object the same way the motion pool does.
+     */
+    old_pos = objs[2]->get_position();
+    objs[2]->set_position(glm::dvec3(110.0, 90.0, 90.0));
+    is(tree->move(objs[2], old_pos), false, test + "expected failed move");
+    is(tree->remove(objs[2], old_pos), true, test + "expected remove");
+    is(tree->broadphase->size(), 2, test + "expected broadphase remove");
+
+    delete tree;
+    for (auto go : objs)
+        delete go;
+}
+
+/* Only pairs with a mover in them, and movers see their whole path */
+void test_swept_pairs(void)
+{
+    std::string test = "swept pairs: ";
+    SweepAndPrune *sap = new SweepAndPrune();
+    SweepAndPrune::object_list_t objs, moved;
+    SweepAndPrune::pair_list_t pairs;
+    glm::dvec3 old_pos;
+
+    objs.push_back(make_object(1, glm::dvec3(10.0, 10.0, 10.0), 1.0));
+    objs.push_back(make_object(2, glm::dvec3(11.5, 10.0, 10.0), 1.0));
+    objs.push_back(make_object(3, glm::dvec3(30.0, 40.0, 10.0), 1.0));
+    objs.push_back(make_object(4, glm::dvec3(30.0, 60.0, 10.0), 1.0));
+    sap->build(objs);
+
+    old_pos = objs[2]->get_position();
+    objs[2]->set_movement(glm::dvec3(0.0, 100000.0, 0.0));
+    usleep(1000);
+    objs[2]->move_and_rotate();
+    is(objs[2]->get_position().y > 62.0, true, test + "went right past");
+    sap->move(objs[2], old_pos);
+
+    moved.push_back(objs[2]);
+    sap->swept_pairs(moved, pairs);
+    is(pairs.size(), 1, test + "expected pair count");
+    is(pairs[0].first == objs[2] && pairs[0].second == objs[3], true,
+       test + "expected pair, mover first");
+
+    delete sap;
+    for (auto go : objs)
+        delete go;
+}
+
+int main(int argc, char **argv)
+{
+    plan(23);
+
+    test_pairs();
+    test_candidates();
+    test_move_remove();
+    test_swept_pairs();
+    test_octree();
+    return exit_status();
+}
@@ -2,7 +2,12 @@
 
 using namespace TAP;
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 #include "../server/classes/zone.h"
+#include "../server/classes/config_data.h"
 
 #include "mock_db.h"
 #include "mock_server_globals.h"
@@ -32,6 +37,29 @@ class object_DB : public fake_DB
         };
 };
 
+class spread_DB : public fake_DB
+{
+  public:
+    spread_DB(const std::string& a, int b, const std::string& c,
+              const std::string& d, const std::string& e)
+        : fake_DB(a, b, c, d, e)
+        {};
+    virtual ~spread_DB() {};
+
+    virtual int get_server_objects(GameObject::objects_map& a)
+        {
+            double x[4] = { 100.0, 900.0, 1100.0, 1500.0 };
+
+            for (int i = 0; i < 4; ++i)
+            {
+                a[2000LL + i] = new GameObject(NULL, NULL, 2000LL + i);
+                a[2000LL + i]->set_position(glm::dvec3(x[i], 500.0, 500.0));
+            }
+            ++get_server_objects_count;
+            return 4;
+        };
+};
+
 void test_create_simple(void)
 {
     std::string test = "create simple: ";
@@ -88,10 +116,19 @@ void test_sector_methods(void)
 
     glm::dvec3 where1(500.0, 500.0, 500.0);
     glm::dvec3 where2(500.0, 500.0, 1500.0);
-    Octree *o1 = zone->sector_contains(where1);
-    Octree *o2 = zone->sector_contains(where2);
+    SpatialIndex *o1 = zone->sector_contains(where1);
+    SpatialIndex *o2 = zone->sector_contains(where2);
     is(o1 == o2, false, test + "sectors not equal");
 
+    /* Looking without creating */
+    glm::dvec3 where3(500.0, 500.0, 2500.0);
+    size_t before = zone->sector_count();
+    is(zone->sector_at(where1) == o1, true, test + "existing sector found");
+    is(zone->sector_at(where3) == NULL, true, test + "missing sector not made");
+    is(zone->sector_count(), before, test + "no new sectors");
+    is(zone->sector_at(glm::dvec3(-1.0, 0.0, 0.0)) == NULL, true,
+       test + "outside the zone");
+
     glm::ivec3 which1 = zone->which_sector(where1);
     glm::ivec3 expected1(0, 0, 0);
     is(which1 == expected1, true, test + "sectors equal");
@@ -136,13 +173,354 @@ void test_send_objects(void)
     delete (object_DB *)database;
 }
 
+void test_queries(const std::string& index)
+{
+    std::string test = "queries (" + index + "): ";
+    glm::dvec3 boundary(1000.0, 500.0, 500.0);
+    SpatialIndex::object_list_t result;
+
+    config.spatial_index = index;
+    database = new spread_DB("a", 0, "b", "c", "d");
+
+    zone = new Zone(1000, 1000, 1000, 2, 1, 1, database);
+
+    zone->objects_in_range(boundary, 150.0, result);
+    is(result.size(), 2, test + "range crosses sectors");
+
+    result.clear();
+    zone->objects_in_range(glm::dvec3(-500.0, 500.0, 500.0), 700.0, result);
+    is(result.size(), 1, test + "range from outside the zone");
+
+    result.clear();
+    zone->nearest_objects(boundary, 3, 10000.0, result);
+    is(result.size(), 3, test + "expected nearest count");
+    is(result.size() == 3 && result[2] == zone->game_objects[2003LL], true,
+       test + "expected third nearest");
+
+    result.clear();
+    zone->nearest_objects(boundary, 4, 200.0, result);
+    is(result.size(), 2, test + "nearest limited by distance");
+
+    result.clear();
+    zone->nearest_objects(glm::dvec3(50.0, 500.0, 500.0), 1, 10000.0, result);
+    is(result.size() == 1 && result[0] == zone->game_objects[2000LL], true,
+       test + "expected nearest");
+
+    glm::dvec3 east(1.0, 0.0, 0.0), west(-1.0, 0.0, 0.0);
+    GameObject *go = zone->game_objects[2001LL];
+
+    is(zone->raycast(glm::dvec3(950.0, 500.0, 500.0), east, 10000.0),
+       zone->game_objects[2002LL], test + "ray into the next sector");
+    is(zone->raycast(glm::dvec3(950.0, 500.0, 500.0), west, 10000.0), go,
+       test + "ray back the other way");
+    is(zone->raycast(go->get_position(), east, 10000.0, go),
+       zone->game_objects[2002LL], test + "ray ignores its caster");
+    is(zone->raycast(glm::dvec3(950.0, 500.0, 500.0), east, 100.0),
+       (GameObject *)NULL, test + "ray limited by distance");
+
+    SpatialIndex::ray_list_t rays;
+
+    rays.push_back(SpatialIndex::ray(glm::dvec3(0.0, 500.0, 500.0),
+                                     east, 10000.0));
+    rays.push_back(SpatialIndex::ray(glm::dvec3(2000.0, 500.0, 500.0),
+                                     west, 10000.0));
+    rays.push_back(SpatialIndex::ray(glm::dvec3(0.0, 510.0, 500.0),
+                                     east, 10000.0));
+    zone->raycast(rays);
+    is(rays[0].hit == zone->game_objects[2000LL]
+       && rays[1].hit == zone->game_objects[2003LL]
+       && rays[2].hit == NULL
+       && rays[1].max_dist == 499.5, true,
+       test + "batch of rays");
+
+    delete zone;
+    delete (spread_DB *)database;
+    config.spatial_index = config_data::SPATIAL_INDEX;
+}
+
+/* Everything's pulled toward everything else, across the sectors */
+void test_gravity(const std::string& index)
+{
+    std::string test = "gravity (" + index + "): ";
+    double expected = 1.0 / (800.0 * 800.0) + 1.0 / (1000.0 * 1000.0)
+        + 1.0 / (1400.0 * 1400.0);
+
+    config.spatial_index = index;
+    database = new spread_DB("a", 0, "b", "c", "d");
+
+    zone = new Zone(1000, 1000, 1000, 2, 1, 1, database);
+    {
+        std::shared_lock lock(zone->sector_lock);
+
+        is(zone->gravitate(1.0, 0.0, 1.0), 4,
+           test + "everything pulled");
+    }
+    is(zone->game_objects[2000LL]->get_movement().x > 0.0
+       && zone->game_objects[2003LL]->get_movement().x < 0.0, true,
+       test + "pulled toward the rest");
+    is(fabs(zone->game_objects[2000LL]->get_movement().x - expected)
+       < 1e-15, true, test + "expected pull");
+
+    /* Pulling again doesn't start a new path... */
+    GameObject *go = zone->game_objects[2000LL];
+    glm::dvec3 from, to;
+
+    MotionState::integrate(1.0, [](GameObject *, const glm::dvec3&) {});
+    {
+        std::shared_lock lock(zone->sector_lock);
+
+        zone->gravitate(1.0, 0.0, 1.0);
+    }
+    go->get_path(from, to);
+    is(from.x < to.x, true, test + "path kept");
+
+    /* ...and too gentle a pull doesn't wake anything up */
+    MotionState::set_sleep(0.01, 0.01, 0.0);
+    MotionState::integrate(1.0, [](GameObject *, const glm::dvec3&) {});
+    MotionState::set_sleep(0.01, 0.01, 1.0);
+    is(go->asleep(), true, test + "fell asleep");
+    {
+        std::shared_lock lock(zone->sector_lock);
+
+        is(zone->gravitate(1.0, 0.0, 1.0), 0, test + "nothing pulled");
+    }
+    is(go->asleep(), true, test + "still asleep");
+
+    delete zone;
+    delete (spread_DB *)database;
+    config.spatial_index = config_data::SPATIAL_INDEX;
+}
+
+/* The same objects get exactly the same pulls, whichever order the
+ * sectors were made in, and however the blocks get spread out.
+ */
+std::map<uint64_t, glm::dvec3> pull_all(bool backward)
+{
+    SpatialIndex::object_list_t objs;
+    std::map<uint64_t, glm::dvec3> result;
+
+    zone = new Zone(1000, 2, NULL);
+    for (int i = 0; i < 8; ++i)
+    {
+        int n = (backward ? 7 - i : i);
+        GameObject *go = new GameObject(NULL, NULL, 4000LL + n);
+
+        go->set_position(glm::dvec3(100.0 + (n & 1) * 1000.0 + n * 7.3,
+                                    300.0 + ((n >> 1) & 1) * 1000.0 - n * 3.1,
+                                    700.0 + ((n >> 2) & 1) * 1000.0 + n));
+        go->geometry->mass = 1.0 + n * 0.37;
+        zone->game_objects[go->get_object_id()] = go;
+        zone->sector_contains(go->get_position());
+        objs.push_back(go);
+    }
+    {
+        std::shared_lock lock(zone->sector_lock);
+
+        zone->hand_off(objs);
+        zone->gravitate(
+            1.0, 0.0, 1.0,
+            [&](size_t count, const std::function<void(size_t)>& f) {
+                if (backward)
+                    for (size_t i = count; i > 0; --i)
+                        f(i - 1);
+                else
+                    for (size_t i = 0; i < count; ++i)
+                        f(i);
+            }
+        );
+    }
+    for (auto& i : zone->game_objects)
+        result[i.first] = i.second->get_movement();
+    delete zone;
+    zone = NULL;
+    return result;
+}
+
+void test_gravity_order(void)
+{
+    std::string test = "gravity order: ";
+    std::map<uint64_t, glm::dvec3> forward = pull_all(false);
+
+    is(forward.size(), 8, test + "expected objects");
+    is(pull_all(true) == forward, true, test + "same pulls either way");
+}
+
+/* Queries that run while things are moving never see anything twice */
+void test_moving_queries(void)
+{
+    std::string test = "moving queries: ";
+    SpatialIndex::object_list_t objs, result;
+    glm::dvec3 center(500.0, 500.0, 500.0);
+    std::atomic<bool> stop(false);
+    int dups = 0;
+
+    zone = new Zone(1000, 1, NULL);
+    for (int i = 0; i < 64; ++i)
+    {
+        GameObject *go = new GameObject(NULL, NULL, 5000LL + i);
+
+        go->set_position(glm::dvec3(50.0 + (i & 3) * 100.0,
+                                    50.0 + ((i >> 2) & 3) * 100.0,
+                                    50.0 + (i >> 4) * 100.0));
+        zone->game_objects[go->get_object_id()] = go;
+        zone->sector_contains(go->get_position());
+        objs.push_back(go);
+    }
+    {
+        std::shared_lock lock(zone->sector_lock);
+
+        zone->hand_off(objs);
+    }
+
+    /* Flip everything back and forth across the middle of the zone */
+    std::thread mover([&](void) {
+        while (!stop)
+            for (auto go : objs)
+            {
+                glm::dvec3 old_pos = go->get_position();
+                std::shared_lock lock(zone->sector_lock);
+
+                go->set_position(glm::dvec3(1000.0, 1000.0, 1000.0)
+                                 - old_pos);
+                zone->sector_at(old_pos)->move(go, old_pos);
+            }
+    });
+
+    for (int i = 0; i < 500; ++i)
+    {
+        result.clear();
+        if (i & 1)
+            zone->nearest_objects(center, 64, 10000.0, result);
+        else
+            zone->objects_in_range(center, 1000.0, result);
+        std::sort(result.begin(), result.end());
+        if (std::adjacent_find(result.begin(), result.end()) != result.end())
+            ++dups;
+        std::this_thread::yield();
+    }
+    stop = true;
+    mover.join();
+
+    is(dups, 0, test + "no repeats");
+
+    delete zone;
+    zone = NULL;
+}
+
+void test_lazy_sectors(void)
+{
+    std::string test = "lazy sectors: ";
+    glm::dvec3 where(500.0, 500.0, 2500.0);
+    SpatialIndex *sector;
+
+    database = new spread_DB("a", 0, "b", "c", "d");
+
+    zone = new Zone(1000, 1000, 1000, 2, 1, 3, database);
+    is(zone->sector_count(), 2, test + "only occupied sectors created");
+
+    sector = zone->sector_contains(where);
+    is(sector != NULL, true, test + "sector created on demand");
+    is(sector == zone->sector_contains(where), true,
+       test + "same sector next time");
+    is(zone->sector_count(), 3, test + "expected sector count");
+    is(sector->min_point.z, 2000.0, test + "expected sector bounds");
+    is(zone->sector_contains(glm::dvec3(500.0, 1500.0, 500.0)) == NULL, true,
+       test + "no sector outside the zone");
+
+    is(zone->release_empty_sectors(), 1, test + "released empty sector");
+    is(zone->sector_count(), 2, test + "occupied sectors kept");
+
+    delete zone;
+    delete (spread_DB *)database;
+}
+
+void test_bulk_load(void)
+{
+    std::string test = "bulk load: ";
+    bool placed = true;
+
+    database = new spread_DB("a", 0, "b", "c", "d");
+
+    zone = new Zone(500, 500, 500, 4, 2, 2, database);
+    is(zone->sector_count(), 4, test + "expected sector count");
+    for (auto& go : zone->game_objects)
+    {
+        const glm::dvec3& pos = go.second->get_position();
+        SpatialIndex *sector = zone->sector_contains(pos);
+
+        if (sector->find(go.second) == NULL
+            || sector->count != 1
+            || sector->min_point.x != floor(pos.x / 500.0) * 500.0
+            || sector->min_point.y != 500.0
+            || sector->min_point.z != 500.0)
+            placed = false;
+    }
+    is(placed, true, test + "objects in the expected sectors");
+    delete zone;
+
+    /* Anything outside the zone gets left out */
+    zone = new Zone(1000, 1, database);
+    is(zone->sector_count(), 1, test + "expected sector count");
+    is(zone->sector_contains(glm::dvec3(0.0, 0.0, 0.0))->count, 2,
+       test + "expected object count");
+    delete zone;
+
+    delete (spread_DB *)database;
+}
+
+void test_sector_report(void)
+{
+    std::string test = "sector report: ", report;
+
+    database = new spread_DB("a", 0, "b", "c", "d");
+    config.octree_adaptive = true;
+
+    zone = new Zone(1000, 1000, 1000, 2, 1, 3, database);
+    zone->tune_sectors();
+    report = zone->sector_report();
+    is(report.substr(0, 9), "2 sectors", test + "expected sector count");
+    ok(report.find("sector 1,0,0: ") != std::string::npos,
+       test + "expected sector");
+    ok(report.find("occupancy: ") != std::string::npos,
+       test + "expected occupancy");
+    ok(report.find(" awake, ") != std::string::npos,
+       test + "expected awake and sleeping");
+    ok(report.find(" nodes/s") != std::string::npos,
+       test + "expected node rate");
+
+    /* Only what the motion state put to sleep counts as sleeping */
+    ok(report.find(" 0 sleeping, ") != std::string::npos,
+       test + "expected nothing sleeping");
+    GameObject *go = zone->game_objects.begin()->second;
+    go->set_movement(glm::dvec3(0.001, 0.0, 0.0));
+    MotionState::set_sleep(0.01, 0.01, 0.0);
+    MotionState::integrate(0.1, [](GameObject *, const glm::dvec3&) {});
+    MotionState::set_sleep(0.01, 0.01, 1.0);
+    report = zone->sector_report();
+    ok(report.find(" 1 sleeping, ") != std::string::npos,
+       test + "expected sleeping object");
+
+    delete zone;
+    delete (spread_DB *)database;
+    config.octree_adaptive = false;
+}
+
 int main(int argc, char **argv)
 {
-    plan(12);
+    plan(74);
 
     test_create_simple();
     test_create_complex();
     test_sector_methods();
     test_send_objects();
+    test_queries("octree");
+    test_queries("linear");
+    test_gravity("octree");
+    test_gravity("linear");
+    test_gravity_order();
+    test_moving_queries();
+    test_lazy_sectors();
+    test_bulk_load();
+    test_sector_report();
     return exit_status();
 }